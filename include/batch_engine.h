@@ -0,0 +1,151 @@
+#ifndef _BATCH_ENGINE_H_
+#define _BATCH_ENGINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "book.h"
+#include "card_array.h"
+#include "card_location.h"
+#include "engine.h"
+#include "hand_matrix.h"
+#include "packed_hand.h"
+#include "rng.h"
+#include "rules.h"
+
+typedef struct batch_engine batch_engine;
+typedef struct batch_obs batch_obs;
+
+/**
+ * What every game of a batch_engine looks like after a step, one element
+ * per game unless stated otherwise.
+ *
+ * The arrays belong to the batch_engine and are overwritten by every
+ * step, so nothing is allocated while stepping.
+ */
+struct batch_obs {
+  /* The seat whose turn is next */
+  uint8_t* seats;
+
+  /* The hand of that seat */
+  packed_hand* hands;
+
+  /* Trade sizes other seats have offers resting at, with bit i set for
+     offers of i + OFFER_INDEX_OFFSET cards */
+  uint32_t* offer_levels;
+
+  /* Trade sizes the seat itself has offers resting at */
+  uint32_t* own_levels;
+
+  /* The reason the last action of the game failed, or 0 */
+  int* errors;
+
+  /* Points scored this step by each seat, num_seats elements per game.
+     Only nonzero when a round has ended */
+  int* rewards;
+
+  /* Whether the game was won this step, in which case it has been
+     started again */
+  bool* dones;
+};
+
+/**
+ * Many independent games of Billionaire, advanced one turn each at a
+ * time.
+ *
+ * Each game's state is spread over arrays indexed by game, or by game
+ * and then seat, rather than kept in a struct of its own. Books and
+ * hands are the exception: they are arrays of book and card_location
+ * structs, so that the rules shared with an engine work on them
+ * unchanged. Each book keeps its own offer pool, so ending a round
+ * frees all of its game's offers at once without touching other games.
+ *
+ * A step takes an action for every game from the seat whose turn it
+ * is, carrying it out and scoring rounds with the same
+ * engine_apply_offer(), engine_apply_cancel() and engine_score_round()
+ * as an engine, without handing out events.
+ *
+ * Every game shuffles from its own stream of the seed, starting from
+ * the same ordered deck, so a game's cards depend only on the seed, its
+ * index and the actions it is given.
+ */
+struct batch_engine {
+  /* Number of games, and seats at each */
+  size_t num_games;
+  size_t num_seats;
+
+  /* Per game: the seat whose turn is next, and seats in a row that have
+     passed */
+  uint8_t* next_seats;
+  uint8_t* num_passes;
+
+  /* Per game: trade book containing active offers, owned by seat, laid
+     out one after another */
+  book* books;
+
+  /* Per game: the generator used for every shuffle of its deck */
+  rng* shufflers;
+
+  /* Per seat of every game: its hand and score */
+  card_location* hands;
+  int* scores;
+
+  /* The deck in the order it was created, and the copy of it shuffled
+     for each deal */
+  card_array* deck;
+  card_array* shuffled;
+
+  /* The hands of the game whose round is ending, scored together */
+  hand_matrix* seat_hands;
+
+  /* Games won and rounds played over the batch's lifetime */
+  size_t num_games_won;
+  size_t num_rounds;
+
+  batch_obs obs;
+};
+
+/**
+ * Create num_games games of num_seats seats, of which there must be at
+ * least 2, each shuffling from the stream of the seed given by its
+ * index, and deal every game's first round.
+ */
+batch_engine* batch_engine_new(size_t num_games, size_t num_seats,
+                               bool has_billionaire, bool has_taxman,
+                               uint64_t seed);
+
+/**
+ * Restart every game, resetting scores and dealing a new round.
+ */
+void batch_engine_reset(batch_engine* batch);
+
+/**
+ * Carry out one action in every game for the seat whose turn it is.
+ *
+ * actions must have num_games elements. A failed action sets the
+ * game's error, and as with engine_step() does not count as a pass. A
+ * round in which every seat passes in a row ends without a winner, and
+ * a game that is won is started again straight away. Returns the
+ * observations of the new state.
+ */
+const batch_obs* batch_engine_step(batch_engine* batch,
+                                   const engine_action actions[]);
+
+/**
+ * Return the hand of a seat of a game.
+ */
+const card_location* get_batch_hand(const batch_engine* batch, size_t game,
+                                    size_t seat);
+
+/**
+ * Return the score of a seat of a game.
+ */
+int get_batch_score(const batch_engine* batch, size_t game, size_t seat);
+
+/**
+ * Free a batch_engine.
+ */
+void free_batch_engine(batch_engine* batch);
+
+#endif
@@ -2,21 +2,33 @@
 #define _BILLIONAIRE_H_
 
 #include "client.h"
+#include "room.h"
 
 /**
- * Start a game of Billionaire.
+ * Start a game of Billionaire in a room.
+ *
+ * Each client is seated at the game's table in the order they joined,
+ * and the table's events are queued for them as commands from then on.
  */
-void start_billionaire_game();
+void start_billionaire_game(room* this_room);
 
 /**
- * Stop a currently-running game of Billionaire.
+ * Stop a currently-running game of Billionaire in a room.
  */
-void stop_billionaire_game();
+void stop_billionaire_game(room* this_room);
 
 /**
- * Processes the raw JSON string sent by a client.
+ * Processes a command packet sent by a client in a room.
+ *
+ * Each command is read into an action and carried out by the room's
+ * table, which follows the rules of the game. Takes ownership of
+ * packet. If the packet could not be parsed it is NULL, and res holds
+ * the reason. res is used to report each failed command back to the
+ * client, and is left in a successful state. Resulting commands are
+ * queued, and are only sent once the caller flushes them with
+ * send_commands_to_clients().
  */
-void process_client_command(client* this_client, char json_str[],
-                            size_t str_size);
+void process_client_command(room* this_room, client* this_client,
+                            json_object* packet, cmd_result* res);
 
 #endif
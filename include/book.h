@@ -3,48 +3,131 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <json-c/json.h>
 
 #include "card_location.h"
+#include "command_error.h"
+#include "slab.h"
 #include "utils.h"
 
 #define OFFER_INDEX_OFFSET 2
 #define MAX_PARTICIPANTS 2
 
+/* Number of trade sizes, each with its own queue of offers */
+#define BOOK_NUM_LEVELS ((TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET)
+
+/* Offers allocated at a time by a book's offer pool */
+#define OFFER_SLAB_CHUNK 32
+
 typedef struct book book;
 typedef struct offer offer;
+typedef struct offer_queue offer_queue;
+typedef struct book_owner book_owner;
+
+/* Each trade size an owner has offers at is a bit of a uint32_t */
+_Static_assert(BOOK_NUM_LEVELS <= 32,
+               "trade sizes do not fit in a book_owner level mask");
+
+/**
+ * Queue of the offers resting in the book for a single trade size.
+ *
+ * Any offer of the same size from a different owner trades with the
+ * oldest one straight away, so every offer in a queue always has the
+ * same owner.
+ */
+struct offer_queue {
+  /**
+   * The oldest offer, the next to trade.
+   */
+  offer* head;
+
+  /**
+   * The newest offer.
+   */
+  offer* tail;
+
+  /**
+   * Number of offers in the queue.
+   */
+  size_t length;
+};
+
+/**
+ * Index of the trade sizes a single owner has offers resting at.
+ */
+struct book_owner {
+  /**
+   * ID of the owner.
+   */
+  uint32_t owner_id;
+
+  /**
+   * Bit i is set while the queue at index i holds the owner's offers.
+   */
+  uint32_t levels;
+};
 
 /**
  * Struct storing current offers.
  */
 struct book {
   /**
-   * Zero-indexed array containing offers.
+   * Zero-indexed array of queues of offers, one per trade size.
+   */
+  offer_queue levels[BOOK_NUM_LEVELS];
+
+  /**
+   * Every owner with offers in the book. A queue only ever holds one
+   * owner's offers, so there are never more owners than queues.
+   */
+  book_owner owners[BOOK_NUM_LEVELS];
+
+  /**
+   * Number of owners with offers in the book.
    */
-  offer* offers[(TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET];
+  size_t num_owners;
+
+  /**
+   * Pool every offer made for the book is allocated from.
+   */
+  slab* offer_pool;
 };
 
 /**
  * Struct storing offers.
  */
 struct offer {
+  /**
+   * Cards involved in offer.
+   */
+  card_location cards;
+
   /**
    * ID of the owner of this offer.
    */
-  char owner_id[HASH_LENGTH];
+  uint32_t owner_id;
 
   /**
-   * Cards involved in offer.
+   * Neighbouring offers in the queue the offer is resting in.
    */
-  card_location* cards;
+  offer* prev;
+  offer* next;
 };
 
 /**
- * Create a new empty book.
+ * Create a new empty book, with room in its offer pool for
+ * OFFER_SLAB_CHUNK offers.
  */
 book* book_new();
 
+/**
+ * Set up an empty book in memory owned by the caller, as book_new()
+ * does. The book's offers must be freed with free_book_offers().
+ */
+void book_init(book* book_obj);
+
 /**
  * Check if there is an offer already in the book at some index.
  */
@@ -56,43 +139,86 @@ bool offer_at(book* book_obj, int offer_ind);
 bool no_offer_at(book* book_obj, int offer_ind);
 
 /**
- * Set an offer in the book at a given index to a given offer.
+ * Return the number of offers in the book at some index.
  */
-void set_offer_at(book* book_obj, int offer_ind, offer* offer_obj);
+size_t get_num_offers_at(book* book_obj, int offer_ind);
 
 /**
- * Get an offer from a book at a given index.
+ * Add an offer to the back of the queue at a given index.
+ */
+void push_offer_at(book* book_obj, int offer_ind, offer* offer_obj);
+
+/**
+ * Get the oldest offer from a book at a given index.
  */
 offer* get_offer_at(book* book_obj, int offer_ind);
 
 /**
- * Remove an offer from the book.
+ * Remove the oldest offer from the book at a given index and return it.
+ *
+ * NOTE: this method does not free the removed offer from memory.
+ */
+offer* remove_offer_at(book* book_obj, int offer_ind);
+
+/**
+ * Remove an offer resting in the book, wherever it is in its queue.
  *
  * NOTE: this method does not free the removed offer from memory.
  */
-void remove_offer_at(book* book_obj, int offer_ind);
+void withdraw_offer(book* book_obj, offer* offer_obj);
 
 /**
  * Add an offer to the book, or return one that is ready to complete.
  *
- * Sets cmd_errno to EOFFEROVER, on failure returns NULL.
+ * The returned offer is the oldest of its size from another owner. If
+ * there is none, the offer is queued behind any others of its owner.
  */
 offer* fill_offer(book* book_obj, offer* offer_obj);
 
 /**
- * Remove an offer from the book if it exists and belongs to the client.
+ * Remove the oldest offer of a size from the book if it exists and
+ * belongs to the client.
+ *
+ * Sets res to ECANEMPTY or ECANPERM, on failure returns NULL.
+ */
+offer* cancel_offer(book* book_obj, size_t card_amt, uint32_t client_id,
+                    cmd_result* res);
+
+/**
+ * Remove every offer a client has resting in the book, returning their
+ * cards to the client's hand, and free them. Returns the number of
+ * offers removed.
  *
- * Sets cmd_errno to ECANEMPTY or ECANPERM, on failure returns NULL.
+ * Only the queues the client owns are visited, so this takes time
+ * proportional to the client's own offers. hand may be NULL if the
+ * cards are not wanted back.
  */
-offer* cancel_offer(book* book_obj, size_t card_amt, const char* client_id);
+size_t cancel_owner_offers(book* book_obj, uint32_t client_id,
+                           card_location* hand);
+
+/**
+ * Return the levels a client has offers resting at, as a bitmask where
+ * bit i is set for the queue at index i. Returns 0 for a client with no
+ * offers in the book.
+ */
+uint32_t get_owner_levels(const book* book_obj, uint32_t client_id);
 
 /**
  * Removes all current offers in book and frees associated memory.
+ *
+ * Every offer allocated from the book is released at once, including
+ * any that are not in the book.
  */
 void clear_book(book* book_obj);
 
 /**
- * Free a book.
+ * Free every offer allocated from a book set up by book_init(), leaving
+ * the memory of the book itself to its owner.
+ */
+void free_book_offers(book* book_obj);
+
+/**
+ * Free a book, along with every offer allocated from it.
  */
 void free_book(book* book_obj);
 
@@ -105,21 +231,24 @@ void free_book(book* book_obj);
 json_object* JSON_from_offer(offer* offer_obj);
 
 /**
- * Create a new empty offer.
+ * Create a new empty offer from a book's offer pool.
  */
-offer* offer_new();
+offer* offer_new(book* book_obj);
 
 /**
- * Initialise an offer struct with cards and the offer owner's ID.
+ * Initialise an offer struct with a copy of some cards and the offer
+ * owner's ID.
  */
-offer* offer_init(card_location* cards, const char* owner_id);
+offer* offer_init(book* book_obj, const card_location* cards,
+                  uint32_t owner_id);
 
 /**
  * Initialise an offer struct with a number of cards.
  *
  * Used for testing purposes only.
  */
-offer* offer_init_cards(card_id card, size_t amount, const char* owner_id);
+offer* offer_init_cards(book* book_obj, card_id card, size_t amount,
+                        uint32_t owner_id);
 
 /**
  * Get the index of an offer corresponding to its place in a book.
@@ -134,7 +263,7 @@ int offset_index(size_t card_amt);
 /**
  * Check if a prospective owner actually owns the offer in question.
  */
-bool is_owner(offer* offer_obj, const char* prospective_owner_id);
+bool is_owner(offer* offer_obj, uint32_t prospective_owner_id);
 
 /**
  * Check if two offers have the same owner.
@@ -142,8 +271,8 @@ bool is_owner(offer* offer_obj, const char* prospective_owner_id);
 bool have_same_owner(offer* offer1, offer* offer2);
 
 /**
- * Free an offer.
+ * Return an offer to the pool of the book it was allocated from.
  */
-void free_offer(offer* offer_obj);
+void free_offer(book* book_obj, offer* offer_obj);
 
 #endif
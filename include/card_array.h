@@ -4,6 +4,7 @@
 typedef struct card_array card_array;
 
 #include "card_location.h"
+#include "rng.h"
 
 /**
  * Struct preserving the order of cards.
@@ -26,15 +27,26 @@ card_array* card_array_new(size_t num_cards);
 card_array* flatten_card_location(card_location* card_loc);
 
 /**
- * Shuffle an ordered array of cards.
+ * Shuffle an ordered array of cards in place, drawing from a given
+ * generator.
  */
-void shuffle_card_array(card_array* card_arr);
+void shuffle_card_array(card_array* card_arr, rng* rng_obj);
 
 /**
  * Deal cards to players.
  */
 card_location** deal_cards(size_t num_players, card_array* ordered_deck);
 
+/**
+ * Deal cards to players' existing hands.
+ *
+ * player_hands must have num_players elements, whose previous contents
+ * are replaced by the cards dealt to them. Nothing is allocated, so
+ * this can be used to deal every round of a game.
+ */
+void deal_cards_to_hands(size_t num_players, const card_array* ordered_deck,
+                         card_location* player_hands[]);
+
 /**
  * Free a card_array.
  */
@@ -2,14 +2,27 @@
 #define _CARD_LOCATION_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <json-c/json.h>
 
+#include "command_error.h"
+#include "packed_hand.h"
+
 #define OFFER_MIN_CARDS 2
+#define OFFER_MAX_CARDS TOTAL_COMMODITY_AMOUNT
 #define OFFER_MAX_UNIQ_COMMS 1
 #define OFFER_MAX_UNIQ_WILDS 1
 
+/* Most cards of a single type in any deck, so at any card_location */
+#define CARD_MAX_AMOUNT (TOTAL_COMMODITY_AMOUNT + 1)
+
+/* Upper bound on the length of a card_location encoded as JSON, based on
+ * the longest possible cards object and its separating comma */
+#define CARD_JSON_MAX_LEN 64
+#define CARD_LOCATION_JSON_MAX_LEN (2 + TOTAL_UNIQUE_CARDS*CARD_JSON_MAX_LEN)
+
 typedef enum card_id card_id;
 typedef struct card_location card_location;
 
@@ -37,13 +50,24 @@ enum card_id {
   TOTAL_UNIQUE_CARDS
 };
 
+_Static_assert(TOTAL_UNIQUE_CARDS == PACKED_NUM_CARDS &&
+               TOTAL_COMMODITY_AMOUNT == PACKED_NUM_COMMODITIES,
+               "packed_hand does not match the card types");
+_Static_assert(CARD_MAX_AMOUNT <= PACKED_CARD_MAX,
+               "packed_hand counts are too narrow");
+
 /**
- * Struct storing an array of cards and the number of cards present in that
- * array.
+ * Struct storing the amount of each type of card and the number of cards
+ * present.
+ *
+ * The counts are stored inline as a packed_hand, so a card_location can be
+ * declared on the stack, copied by assignment and embedded in other
+ * structs without any allocation. A card_location must be cleared before
+ * it is first used.
  */
 struct card_location {
-  size_t* card_counts;
-  size_t num_cards;
+  packed_hand card_counts;
+  uint8_t num_cards;
 };
 
 /**
@@ -57,16 +81,34 @@ extern const int card_values[];
 json_object* JSON_from_card_location(card_location* card_loc);
 
 /**
- * Convert a JSON array of cards objects to a card_location struct.
+ * Encode a card_location struct as a JSON array of cards objects.
+ *
+ * The encoding is identical to the output of JSON_from_card_location(),
+ * but is written straight into dest, which must have room for at least
+ * CARD_LOCATION_JSON_MAX_LEN characters. Returns the encoded length.
+ */
+size_t encode_card_location(char* dest, const card_location* card_loc);
+
+/**
+ * Read a JSON array of cards objects into a card_location struct.
  *
- * Sets cmd_errno to EJSONTYPE.
- * Checks cmd_errno, on failure returns NULL.
+ * card_loc is cleared first.
+ * Sets res to EJSONTYPE, EJSONVAL or EBADCARD.
  * Note that the card's value does not need to be sent by the client.
  */
-card_location* card_location_from_JSON(json_object* card_loc_json);
+void read_card_location_JSON(card_location* card_loc,
+                             json_object* card_loc_json, cmd_result* res);
 
 /**
- * Create a new card_location struct that is empty and ready for card
+ * Convert a JSON array of cards objects to a new card_location struct.
+ *
+ * Sets res to EJSONTYPE, EJSONVAL or EBADCARD, on failure returns NULL.
+ */
+card_location* card_location_from_JSON(json_object* card_loc_json,
+                                       cmd_result* res);
+
+/**
+ * Allocate a new card_location struct that is empty and ready for card
  * insertion.
  */
 card_location* card_location_new();
@@ -97,9 +139,10 @@ void add_cards_to_location(card_location* card_loc, card_id card, size_t amount)
 /**
  * Remove an amount of cards from a card_location struct.
  *
- * Sets cmd_errno to ECARDRM.
+ * Sets res to ECARDRM.
  */
-void remove_cards_from_location(card_location* card_loc, card_id card, size_t amount);
+void remove_cards_from_location(card_location* card_loc, card_id card,
+                                size_t amount, cmd_result* res);
 
 /**
  * Merge one card location into another.
@@ -112,12 +155,12 @@ void merge_card_location(card_location* dest_loc, const card_location* src_loc);
  * Subtract one card location's cards from another.
  *
  * Here, src_loc's cards are removed from dest_loc, src_loc is unchanged.
- * This method assumes src_loc is a subset of dest_loc, and does not
- * check for any possible overflow due to src_loc containing more cards.
+ * If src_loc is not a subset of dest_loc, dest_loc is left unchanged.
  *
- * Sets cmd_errno to ECARDRM.
+ * Sets res to ECARDRM.
  */
-void subtract_card_location(card_location* dest_loc, const card_location* src_loc);
+void subtract_card_location(card_location* dest_loc,
+                            const card_location* src_loc, cmd_result* res);
 
 /**
  * Validate an offer given by a client.
@@ -125,8 +168,10 @@ void subtract_card_location(card_location* dest_loc, const card_location* src_lo
  * This cross-checks against the client's hand to confirm the offer is a
  * subset, and also checks the offer contains at most one commodity type
  * and one wildcard type.
+ * Sets res to the reason the offer is invalid.
  */
-void validate_offer(card_location* offer, const card_location* hand);
+void validate_offer(const card_location* offer, const card_location* hand,
+                    cmd_result* res);
 
 /**
  * Checks if a hand is a winning hand.
@@ -155,11 +200,14 @@ bool has_enough_cards(const card_location* card_loc, card_id card, size_t amount
 
 /**
  * Remove all cards within a card_location struct.
+ *
+ * This also initialises a card_location that was not created by
+ * card_location_new().
  */
 void clear_card_location(card_location* card_loc);
 
 /**
- * Free a card_location struct, and all cards within it.
+ * Free a card_location struct created by card_location_new().
  */
 void free_card_location(card_location* card_loc);
 
@@ -2,6 +2,7 @@
 #define _CLIENT_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/queue.h>
 
 /* Libevent */
@@ -11,10 +12,18 @@
 #include <json-c/json.h>
 
 #include "card_location.h"
+#include "command.h"
+#include "command_ring.h"
+#include "frame.h"
+
+/* Most bytes that may be waiting to be written to a client's socket */
+#define CLIENT_OUTPUT_LIMIT (1 << 20)
 
 typedef struct client client;
 typedef struct client_head client_head;
 
+struct room;
+
 /**
  * A struct for client specific data.
  *
@@ -25,66 +34,84 @@ struct client {
   /* The clients socket. */
   int fd;
 
-  /* The client ID. */
-  char* id;
+  /* The client ID, keying the client in hash tables. */
+  uint32_t id;
 
-  /* The client's hand */
-  card_location* hand;
+  /* The client's seat at its room's table, while a game is running.
+     Its hand and score are kept by the table */
+  size_t seat;
 
-  /* The client's score */
-  int score;
+  /* The room the client is seated in. */
+  struct room* room;
 
   /* The bufferevent for this client. */
   struct bufferevent* buf_ev;
 
-  /* The next client in the hash table. */
-  struct client* next_hash;
+  /* The reassembly state of frames received from this client. */
+  frame_reader reader;
 
   /* The pointers to the next and previous entries in the tail queue. */
   TAILQ_ENTRY(client) entries;
 
-  /* The head of the single tail queue for commands. */
-  STAILQ_HEAD(, command) command_stailq_head;
-};
+  /* The commands waiting to be sent to the client. */
+  command_ring commands;
 
-/**
- * The head of our tailq of all connected clients.  This is what will
- * be iterated to send a received message to all connected clients.
- */
-TAILQ_HEAD(client_head, client) client_tailq_head;
+  /* Whether the client has fallen too far behind and must be dropped. */
+  bool overflowed;
+};
 
 /**
- * Command structure used as a queue entry.
+ * The head of a tailq of connected clients.  This is what will be
+ * iterated to send a received message to all clients in a room.
  */
-struct command {
-  json_object* cmd_json;
-
-  STAILQ_ENTRY(command) cmds;
-};
+TAILQ_HEAD(client_head, client);
 
 /**
  * Create a new empty client.
  *
  * A client by definition must contain an open socket allowing command
  * communication, so it only makes sense that all new clients must be
- * registered to the event_base struct.
+ * registered to the event_base struct. The framing used to delimit
+ * command packets is fixed for the lifetime of the client, and is
+ * FRAMING_UNKNOWN for a client that picks it with its first byte.
  */
-client* client_new(struct event_base* evbase, int fd,
+client* client_new(struct event_base* evbase, int fd, framing mode,
                    bufferevent_data_cb readcb, bufferevent_event_cb eventcb);
 
 /**
  * Add a Billionaire command to the client's command queue.
+ *
+ * The client takes ownership of the command. If the queue is full, the
+ * command is released, the client is marked as overflowed and false is
+ * returned.
  */
-void enqueue_command(client* client_obj, json_object* cmd);
+bool enqueue_command(client* client_obj, command* cmd);
+
+/**
+ * Add a Billionaire command to the command queue of each client in a
+ * list.
+ *
+ * The command is encoded only once, and each client queues a reference
+ * to the same encoding. Clients in excluded are skipped;
+ * excluded may be NULL, and unused elements must be set to NULL.
+ * The list of clients takes ownership of the command.
+ */
+void broadcast_command(client_head* client_head_obj, command* cmd,
+                       client* excluded[MAX_PARTICIPANTS]);
 
 /**
  * Send a series of Billionaire commands to each client.
  *
- * Runs through the command STAILQ head, popping command structures off
- * and creating a json_object that is then sent to the corresponding
- * client.
+ * Runs through the command ring, popping commands off and writing them
+ * as a single command packet frame straight into the client's output
+ * buffer. Each frame is written into space reserved once in the output,
+ * with every encoded command copied into it a single time.
+ *
+ * A client whose output buffer holds more than CLIENT_OUTPUT_LIMIT
+ * bytes, or whose frame cannot be given space in its output buffer, is
+ * marked as overflowed, and an overflowed client is sent nothing more.
  *
- * Memory allocated to the JSON objects is (hopefully) freed here.
+ * Memory allocated to the commands is freed here.
  */
 void send_commands_to_clients(client_head* client_head_obj);
 
@@ -96,13 +123,6 @@ void send_commands_to_clients(client_head* client_head_obj);
  */
 bool client_eq(client* client1, client* client2);
 
-/**
- * Update the score of a client.
- *
- * This happens only after a BILLIONAIRE event.
- */
-void update_score(client* client_obj);
-
 /**
  * Free a client.
  */
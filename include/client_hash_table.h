@@ -1,53 +1,96 @@
 #ifndef _CLIENT_HASH_TABLE_H_
 #define _CLIENT_HASH_TABLE_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "client.h"
 
+/* Fewest slots a table is created with */
+#define CLIENT_TABLE_MIN_CAPACITY 8
+
+/* A table grows once more than this fraction of its slots are used */
+#define CLIENT_TABLE_LOAD_NUM 3
+#define CLIENT_TABLE_LOAD_DEN 4
+
+/* Slots of the previous array moved across by each insert or removal */
+#define CLIENT_TABLE_MIGRATE_STEP 4
+
 typedef struct client_hash_table client_hash_table;
+typedef struct client_slot client_slot;
+
+/**
+ * A slot of a client hash table.
+ */
+struct client_slot {
+  /* The client held in the slot */
+  client* client_obj;
+
+  /* The client's key */
+  uint32_t key;
+
+  /* One more than the distance of the slot from the key's home slot,
+     or 0 if the slot is empty */
+  uint32_t dist;
+};
 
 /**
  * A struct to use as a hash table for constant-time client access.
  *
- * It uses the xxHash algorithm to allocate buckets.
- *
- * It assumes that identical keys correspond to identical clients. This
- * may not be the case when the xxHash has a collision in generating two
- * client IDs. Be warned.
+ * Clients are keyed by their 32-bit ID, a hash that is already evenly
+ * distributed, so its low bits are used directly as the home slot.
+ * Collisions are resolved by Robin Hood open addressing: an insert
+ * takes the slot of any client that is closer to its home slot, which
+ * keeps every probe sequence short. A removal shifts the clients after
+ * it back by one slot rather than leaving a tombstone.
  *
- * This hash table has a fixed size.
+ * Once the table is more than CLIENT_TABLE_LOAD_NUM/CLIENT_TABLE_LOAD_DEN
+ * full it doubles in size. Clients are moved into the new array a few
+ * slots at a time by later inserts and removals, so no single call has
+ * to rehash the whole table. Until then, lookups search both arrays.
  */
 struct client_hash_table {
-  /* The number of buckets in the table */
-  size_t size;
+  /* The slots, a power of two of them */
+  client_slot* slots;
 
-  /* The buckets containing client pointers. */
-  client** buckets;
-};
+  /* The number of slots */
+  size_t capacity;
 
-/**
- * The global hash table containing all hashed clients.
- */
-extern client_hash_table* hashed_clients;
+  /* The slots of the array being moved out of, or NULL */
+  client_slot* old_slots;
+
+  /* The number of slots of the array being moved out of */
+  size_t old_capacity;
+
+  /* Every old slot before this one has been moved across */
+  size_t old_next;
+
+  /* The number of clients in the table */
+  size_t num_clients;
+};
 
 /**
- * Create an empty client hash table with defined size.
+ * Create an empty client hash table with room for at least capacity
+ * clients before it first grows.
  */
-client_hash_table* client_hash_table_new(size_t size);
+client_hash_table* client_hash_table_new(size_t capacity);
 
 /**
  * Insert a client into the hash table.
  *
  * The client's ID is used as the key, and the value is the client
- * itself.
+ * itself. Returns false, leaving the table unchanged, if a client with
+ * the same key is already in the table.
  */
-void put_client(client_hash_table* table_obj, client* client_obj);
+bool put_client(client_hash_table* table_obj, client* client_obj);
 
 /**
- * Return a client struct in constant time given its unique id.
+ * Return a client struct in constant time given its ID, or NULL if
+ * there is no such client.
  *
  * This method does not remove the client from the table.
  */
-client* get_client(const client_hash_table* table_obj, const char* client_id);
+client* get_client(const client_hash_table* table_obj, uint32_t client_id);
 
 /**
  * Remove a client from the table.
@@ -56,20 +99,11 @@ client* get_client(const client_hash_table* table_obj, const char* client_id);
  */
 void del_client(client_hash_table* table_obj, client* client_obj);
 
-/**
- * Get the bucket index by computing a modulo on the hash.
- */
-size_t get_bucket_idx(const client_hash_table* table_obj, const char* client_id);
-
 /**
  * Free memory allocated to the hash table.
  *
- * The hash table exists for the duration of a game to keep track of
- * all players.
- *
- * The hash table must be already cleaned of all clients before being
- * freed, as otherwise freeing the table will free client objects that
- * may still have pointers elsewhere in the code.
+ * The hash table exists for the lifetime of a room to keep track of
+ * all of its players. The clients still in the table are not freed.
  */
 void free_client_hash_table(client_hash_table* table_obj);
 
@@ -3,14 +3,28 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
+/* JSON */
 #include <json-c/json.h>
 
 #include "book.h"
 #include "card_location.h"
+#include "rules.h"
+#include "slab.h"
 
-#define MAX_PLAYERS 8
-#define INITIAL_SCORE 0
+/* Commands allocated at a time by each thread's command pool */
+#define COMMAND_SLAB_CHUNK 256
+
+/* Upper bound on the length of an encoded command, set by START and its
+   hand, the longest of them */
+#define COMMAND_JSON_MAX_LEN (128 + CARD_LOCATION_JSON_MAX_LEN)
+
+/* Opening and closing of a command packet */
+#define PACKET_OPEN "{\"commands\":["
+#define PACKET_CLOSE "]}"
+
+typedef struct command command;
 
 struct commands {
   const char* JOIN;
@@ -31,87 +45,165 @@ struct commands {
  */
 extern const struct commands Command;
 
+/**
+ * An outgoing command, already encoded as a JSON object.
+ *
+ * Commands are encoded as soon as they are created, so they capture the
+ * game state at that moment rather than when they are eventually sent.
+ * The encoding is held inside the command itself, so making a command
+ * takes nothing more than a slot of the command pool. A command is
+ * reference counted so a single encoding can be queued for many clients.
+ */
+struct command {
+  /* The command's type, for logging */
+  const char* name;
+
+  /* Number of references held to the command */
+  int refcnt;
+
+  /* The JSON encoding of the command */
+  size_t json_len;
+  char json[COMMAND_JSON_MAX_LEN];
+};
+
 /**
  * Basic constructor for command objects that instantiates the "command"
  * field to whatever type is requested.
+ *
+ * The command's JSON object is left open for further fields to be added,
+ * and must be closed by end_command().
  */
-json_object* make_command(const char* cmd);
+command* make_command(const char* cmd_name);
+
+/**
+ * Close the JSON object of a command created by make_command().
+ */
+command* end_command(command* cmd);
 
 /**
  * Create a JOIN command (JSON object) containing an id to identify the
  * client with.
  */
-json_object* command_join(char* id);
+command* command_join(uint32_t id);
 
 /**
- * Create a START command containing the client's hand.
+ * Create a START command containing the client's hand and their score
+ * going into the round.
  */
-json_object* command_start(card_location* player_hand);
+command* command_start(const card_location* player_hand, int score);
 
 /**
  * Create a SUCCESSFUL_TRADE command containing new cards and the previous
  * owner's ID.
  */
-json_object* command_successful_trade(offer* traded_offer);
+command* command_successful_trade(const card_location* cards,
+                                  uint32_t owner_id);
 
 /**
- * Create a CANCELLED_OFFER command containing a cancelled offer.
+ * Create a CANCELLED_OFFER command containing the cards of a cancelled
+ * offer.
  */
-json_object* command_cancelled_offer(offer* cancelled_offer);
+command* command_cancelled_offer(const card_location* cards);
 
 /**
  * Create a BOOK_EVENT command containing the book event.
  *
- * The participants array must have MAX_PARTICIPANTS elements in it. If
- * there is less than MAX_PARTICIPANTS participants in the event, the
- * other elements must be set to NULL.
+ * The IDs of the first num_participants elements of participants are
+ * listed, where num_participants is at most MAX_PARTICIPANTS.
  */
-json_object* command_book_event(const char* event, size_t card_amt,
-                                    const char* participants[MAX_PARTICIPANTS]);
+command* command_book_event(const char* event, size_t card_amt,
+                            const uint32_t participants[MAX_PARTICIPANTS],
+                            size_t num_participants);
 
 /**
  * Create a BILLIONAIRE command containing ID of winner.
  */
-json_object* command_billionaire(const char* winner_id);
+command* command_billionaire(uint32_t winner_id);
 
 /**
  * Create an END_ROUND command containing the client's update score.
  */
-json_object* command_end_round(int score);
+command* command_end_round(int score);
 
 /**
  * Create an END_GAME command.
  */
-json_object* command_end_game();
+command* command_end_game();
 
 /**
- * Create an ERROR command containing the latest error.
+ * Create an ERROR command containing the error held by a result.
  *
- * Resets cmd_errno to CMD_SUCCESS.
+ * Resets res to CMD_SUCCESS.
+ */
+command* command_error(cmd_result* res);
+
+/**
+ * Return the length of a command's JSON encoding.
+ */
+size_t get_command_length(const command* cmd);
+
+/**
+ * Take another reference to a command.
  */
-json_object* command_error();
+command* ref_command(command* cmd);
+
+/**
+ * Copy a command's JSON encoding to dest, returning its length.
+ *
+ * dest must have room for at least get_command_length(cmd) characters.
+ */
+size_t copy_command(char* dest, const command* cmd);
+
+/**
+ * Release a reference to a command, freeing it once none remain.
+ */
+void free_command(command* cmd);
+
+/**
+ * Return the usage counters of the calling thread's command pool.
+ *
+ * Commands are allocated from a pool belonging to the thread that makes
+ * them, and must be freed by the same thread.
+ */
+const slab_stats* get_command_pool_stats();
+
+/**
+ * Free the calling thread's command pool.
+ *
+ * Every command made by the thread must already have been freed.
+ */
+void free_command_pool();
 
 /**
  * Get the name of a command.
  *
- * Checks cmd_errno, on failure returns NULL and sets str_len to 0.
+ * Sets res to EJSONVAL, on failure returns NULL and sets str_len to 0.
  */
-const char* get_command_name(json_object* cmd, size_t* str_len);
+const char* get_command_name(json_object* cmd, size_t* str_len,
+                             cmd_result* res);
 
 /**
  * Parse a string representing a JSON command list object.
  *
  * Returns a JSON array where each element is a command object.
- * Sets cmd_errno to EJSONTYPE.
- * Checks cmd_errno, on failure returns NULL.
+ * Sets res to jerr, EJSONVAL or EJSONTYPE, on failure returns NULL.
+ */
+json_object* parse_command_list_string(const char* json_str, size_t str_len,
+                                       cmd_result* res);
+
+/**
+ * Extract the JSON array of command objects from a parsed command packet.
+ *
+ * Takes ownership of packet, which is NULL if it failed to parse, in
+ * which case res already holds the reason.
+ * Sets res to EJSONVAL or EJSONTYPE, on failure returns NULL.
  */
-json_object* parse_command_list_string(char* json_str, size_t str_len);
+json_object* parse_command_list(json_object* packet, cmd_result* res);
 
 /**
  * Check the type of command.
  *
- * Does not check cmd_errno. This is done by buffered_on_read() in the
- * server.
+ * The command object must already be known to have a command field.
  */
 bool command_is(json_object* cmd, const char* cmd_name);
 
@@ -1,11 +1,16 @@
 #ifndef _COMMAND_ERROR_H_
 #define _COMMAND_ERROR_H_
 
+#include <stdbool.h>
+
 #include <json-c/json.h>
 
 #define MAX_ERROR_LENGTH 64
 #define CMD_SUCCESS 0
 
+/* Initialiser for a cmd_result that has not failed */
+#define CMD_RESULT_INIT { .err = CMD_SUCCESS }
+
 /* TODO: distinguish between fatal errors and non-fatal errors */
 
 enum errorno {
@@ -16,17 +21,37 @@ enum errorno {
   EBADCMDOBJ, /* Command object does not contain 'command' field */
   ECANEMPTY, /* Offer to cancel is empty */
   ECANPERM, /* Offer could not be cancelled due to permission error */
-  EOFFEROVER, /* New offer overrides previously declared offer */
+  EOFFEROVER, /* New offer overrides previously declared offer (unused) */
   ENOOFFER, /* Offer does not contain any cards */
   ESMALLOFFER, /* Offer does not contain enough cards */
   EHANDSUBSET, /* Cards in offer do not exist in hand */
   EUNIQCOMMS, /* Offer contains too many unique commodities */
   EUNIQWILDS, /* Offer contains too many unique wildcards */
-  ECARDRM /* Not enough cards to remove from card_location */
+  ECARDRM, /* Not enough cards to remove from card_location */
+  EFRAMESIZE, /* Command packet exceeds the maximum frame size */
+  ELARGEOFFER, /* Offer contains too many cards */
+  EBADCARD /* Cards object does not describe valid cards */
 };
 
-extern int cmd_errno;
+typedef struct cmd_result cmd_result;
+
+/**
+ * The result of processing a command.
+ *
+ * Every call that can fail while processing a command is given a
+ * cmd_result to report failure in, so commands from different clients
+ * can be processed independently of one another.
+ */
+struct cmd_result {
+  /* CMD_SUCCESS, or the reason the command failed */
+  int err;
+};
 
 extern const char* error_what[];
 
+/**
+ * Check whether a cmd_result holds a failure.
+ */
+bool cmd_failed(const cmd_result* res);
+
 #endif
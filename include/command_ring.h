@@ -0,0 +1,86 @@
+#ifndef _COMMAND_RING_H_
+#define _COMMAND_RING_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "command.h"
+
+/* Commands a ring can hold before it first has to grow */
+#define COMMAND_RING_INIT_CAPACITY 16
+
+/* Most commands a ring can hold between two flushes */
+#define COMMAND_RING_MAX_CAPACITY 4096
+
+typedef struct command_ring command_ring;
+
+/**
+ * A queue of encoded commands waiting to be sent to a client.
+ *
+ * The commands are held in a circular array that doubles in size when
+ * it fills up. As the array is kept between flushes, it only grows
+ * while a client's queue reaches a new high, after which queueing a
+ * command never allocates.
+ *
+ * The array never grows past COMMAND_RING_MAX_CAPACITY, so a client
+ * that is sent commands faster than they can be flushed is refused
+ * rather than queueing without bound.
+ */
+struct command_ring {
+  /* The queued commands, starting at head and wrapping around */
+  command** cmds;
+
+  /* Number of commands the array can hold, always a power of two */
+  size_t capacity;
+
+  /* Index of the oldest queued command */
+  size_t head;
+
+  /* Number of queued commands */
+  size_t length;
+};
+
+/**
+ * Initialise an empty command ring.
+ */
+void command_ring_init(command_ring* ring);
+
+/**
+ * Add a command to the back of a ring.
+ *
+ * The ring takes ownership of the command. If the ring is already
+ * holding COMMAND_RING_MAX_CAPACITY commands, the command is released
+ * instead and false is returned.
+ */
+bool command_ring_push(command_ring* ring, command* cmd);
+
+/**
+ * Remove and return the command at the front of a ring.
+ *
+ * The caller takes ownership of the command. Returns NULL if the ring
+ * is empty.
+ */
+command* command_ring_pop(command_ring* ring);
+
+/**
+ * Return the command a number of places from the front of a ring,
+ * without removing it.
+ */
+command* get_command_ring_at(const command_ring* ring, size_t index);
+
+/**
+ * Return whether a ring holds no commands.
+ */
+bool command_ring_is_empty(const command_ring* ring);
+
+/**
+ * Release every command held by a ring, keeping its array.
+ */
+void clear_command_ring(command_ring* ring);
+
+/**
+ * Release every command held by a ring, along with its array.
+ */
+void free_command_ring(command_ring* ring);
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "book.h"
+#include "card_array.h"
+#include "card_location.h"
+#include "hand_matrix.h"
+#include "rng.h"
+#include "rules.h"
+
+/* Most seats at a single engine's table */
+#define ENGINE_MAX_SEATS MAX_PLAYERS
+
+typedef struct engine engine;
+typedef struct engine_agent engine_agent;
+typedef struct engine_broadcaster engine_broadcaster;
+typedef struct engine_trade engine_trade;
+typedef struct engine_action engine_action;
+typedef struct engine_event engine_event;
+typedef enum engine_action_type engine_action_type;
+typedef enum engine_event_type engine_event_type;
+typedef enum engine_book_event engine_book_event;
+
+/**
+ * Enumeration of the actions a seat can take on its turn.
+ */
+enum engine_action_type {
+  /* Do nothing this turn */
+  ENGINE_PASS = 0,
+  /* Put some cards on offer, as NEW_OFFER does */
+  ENGINE_NEW_OFFER,
+  /* Take back the oldest offer of a size, as CANCEL_OFFER does */
+  ENGINE_CANCEL_OFFER
+};
+
+/**
+ * An action taken by a seat, in place of a command sent by a client.
+ */
+struct engine_action {
+  /* What the seat does */
+  engine_action_type type;
+
+  /* The cards offered by ENGINE_NEW_OFFER */
+  card_location cards;
+
+  /* The size of offer cancelled by ENGINE_CANCEL_OFFER */
+  size_t card_amt;
+};
+
+/**
+ * Enumeration of the events sent to seats, each matching the command a
+ * client would be sent.
+ */
+enum engine_event_type {
+  ENGINE_START = 0,
+  ENGINE_SUCCESSFUL_TRADE,
+  ENGINE_CANCELLED_OFFER,
+  ENGINE_BOOK_EVENT,
+  ENGINE_BILLIONAIRE,
+  ENGINE_END_ROUND,
+  ENGINE_END_GAME,
+  ENGINE_ERROR
+};
+
+/**
+ * Enumeration of the changes to the book announced by ENGINE_BOOK_EVENT.
+ */
+enum engine_book_event {
+  ENGINE_BOOK_NEW_OFFER = 0,
+  ENGINE_BOOK_CANCELLED_OFFER,
+  ENGINE_BOOK_SUCCESSFUL_TRADE
+};
+
+/**
+ * An event sent to a seat. Only the fields of the event's type are set.
+ */
+struct engine_event {
+  /* The kind of event */
+  engine_event_type type;
+
+  /* The hand dealt by ENGINE_START, the cards received by
+     ENGINE_SUCCESSFUL_TRADE, or the cancelled or rejected offer
+     returned by ENGINE_CANCELLED_OFFER */
+  card_location cards;
+
+  /* The seat traded with by ENGINE_SUCCESSFUL_TRADE, or the winner
+     announced by ENGINE_BILLIONAIRE */
+  size_t seat;
+
+  /* The change to the book of ENGINE_BOOK_EVENT */
+  engine_book_event book_event;
+
+  /* The size of the offer of ENGINE_BOOK_EVENT */
+  size_t card_amt;
+
+  /* The seats that took part in ENGINE_BOOK_EVENT */
+  size_t participants[MAX_PARTICIPANTS];
+  size_t num_participants;
+
+  /* The score going into the round of ENGINE_START, or after the round
+     of ENGINE_END_ROUND */
+  int score;
+
+  /* The reason an action failed for ENGINE_ERROR */
+  int err;
+};
+
+/**
+ * A player seated at an engine, driven by callbacks instead of a
+ * socket.
+ */
+struct engine_agent {
+  /**
+   * Choose the seat's action for its turn. action is cleared to
+   * ENGINE_PASS beforehand. If NULL, the seat always passes.
+   */
+  void (*act)(const engine* engine_obj, size_t seat, engine_action* action,
+              void* data);
+
+  /**
+   * Receive an event sent to the seat. May be NULL.
+   */
+  void (*on_event)(const engine* engine_obj, size_t seat,
+                   const engine_event* event, void* data);
+
+  /* Passed to each callback */
+  void* data;
+};
+
+/**
+ * A receiver of the events sent to a whole table at once, in place of
+ * each seat's agent, so such an event need only be handled once however
+ * many seats it reaches.
+ */
+struct engine_broadcaster {
+  /**
+   * Receive an event sent to every seat except the num_excluded seats
+   * of excluded. If NULL, each seat's agent receives the event instead.
+   */
+  void (*on_broadcast)(const engine* engine_obj, const engine_event* event,
+                       const size_t excluded[], size_t num_excluded,
+                       void* data);
+
+  /* Passed to on_broadcast */
+  void* data;
+};
+
+/**
+ * What became of an offer carried out by engine_apply_offer().
+ */
+struct engine_trade {
+  /* Whether the offer traded, rather than coming to rest on the book */
+  bool traded;
+
+  /* The seat traded with */
+  size_t other_seat;
+
+  /* The cards the offering seat gave up, and those it received */
+  card_location given;
+  card_location received;
+
+  /* Whether each side of the trade now holds a winning hand */
+  bool seat_won;
+  bool other_seat_won;
+};
+
+/**
+ * A game of Billionaire played in process, without any clients.
+ *
+ * The engine is where the rules of a table live. A room of the server
+ * seats its clients at an engine and translates their commands into
+ * actions, and the engine's events back into commands. The engine
+ * takes actions and hands out events as structs. Nothing is allocated
+ * once the engine has been created, so an engine can be reused for any
+ * number of games.
+ *
+ * An engine is not thread safe, but separate engines can be run on
+ * separate threads.
+ */
+struct engine {
+  /* Number of seats at the table */
+  size_t num_seats;
+
+  /* The agent playing each seat */
+  engine_agent agents[ENGINE_MAX_SEATS];
+
+  /* Receives events sent to the whole table, if set */
+  engine_broadcaster broadcaster;
+
+  /* Each seat's hand */
+  card_location hands[ENGINE_MAX_SEATS];
+
+  /* Each seat's score */
+  int scores[ENGINE_MAX_SEATS];
+
+  /* Whether a game is being played */
+  bool running;
+
+  /* The seat whose turn is next */
+  size_t next_seat;
+
+  /* Seats in a row that have passed, ending the round once every seat
+     has */
+  size_t num_passes;
+
+  /* Deck of cards, reshuffled every round */
+  card_array* deck;
+
+  /* Trade book containing active offers, owned by seat number */
+  book* current_trades;
+
+  /* Every seat's hand, gathered to be scored together */
+  hand_matrix* seat_hands;
+
+  /* The engine's generator, used for every shuffle of the deck */
+  rng shuffler;
+
+  /* The reason the last action carried out failed, or CMD_SUCCESS.
+     Also sent to the seat as ENGINE_ERROR */
+  int last_err;
+
+  /* Turns, trades and rounds played over the engine's lifetime */
+  size_t num_turns;
+  size_t num_trades;
+  size_t num_rounds;
+};
+
+/**
+ * Put cards from a seat's hand on offer in a book of offers owned by
+ * seat number, trading them straight away with the oldest offer of the
+ * same size. hands holds the hand of every seat, and trade is filled in
+ * with what became of the offer.
+ *
+ * This is the rule of an offer shared by every kind of table, which
+ * each follows with its own events. Returns the reason the offer
+ * failed, or CMD_SUCCESS.
+ */
+int engine_apply_offer(book* book_obj, card_location hands[], size_t seat,
+                       const card_location* cards, engine_trade* trade);
+
+/**
+ * Take back a seat's oldest offer of a size from a book of offers owned
+ * by seat number, returning its cards to the seat's hand in hands and
+ * copying them to returned.
+ *
+ * Returns the reason the cancel failed, or CMD_SUCCESS.
+ */
+int engine_apply_cancel(book* book_obj, card_location hands[], size_t seat,
+                        size_t card_amt, card_location* returned);
+
+/**
+ * Score a round, counting cards still on offer towards their owner's
+ * hand and clearing the book. Every hand is scored together through
+ * seat_hands, and the points of each seat are added to scores and
+ * written to points.
+ *
+ * Returns whether a seat has reached WINNING_SCORE.
+ */
+bool engine_score_round(book* book_obj, card_location hands[], int scores[],
+                        size_t num_seats, hand_matrix* seat_hands,
+                        int points[]);
+
+/**
+ * Create an engine with a number of seats, of which there must be at
+ * least 2, each of which passes until it is given an agent.
+ *
+ * Shuffles are drawn from the given stream of the seed, as they are for
+ * a game_state.
+ */
+engine* engine_new(size_t num_seats, bool has_billionaire, bool has_taxman,
+                   uint64_t seed, uint64_t stream);
+
+/**
+ * Seat an agent at an engine. The agent is copied.
+ */
+void set_engine_agent(engine* engine_obj, size_t seat,
+                      const engine_agent* agent);
+
+/**
+ * Have an engine's events to the whole table go to a broadcaster. The
+ * broadcaster is copied.
+ */
+void set_engine_broadcaster(engine* engine_obj,
+                            const engine_broadcaster* broadcaster);
+
+/**
+ * Return the hand of a seat.
+ */
+const card_location* get_engine_hand(const engine* engine_obj, size_t seat);
+
+/**
+ * Return the score of a seat.
+ */
+int get_engine_score(const engine* engine_obj, size_t seat);
+
+/**
+ * Reseed an engine's shuffles with a stream of a seed, putting the deck
+ * back in order so the next game depends on nothing else.
+ *
+ * This lets a reused engine play the same game as a new engine created
+ * with the same seed and stream.
+ */
+void seed_engine(engine* engine_obj, uint64_t seed, uint64_t stream);
+
+/**
+ * Start a game, resetting every score and dealing the first round.
+ */
+void engine_start_game(engine* engine_obj);
+
+/**
+ * Stop a game before anyone has won, sending ENGINE_END_GAME to every
+ * seat.
+ */
+void engine_stop_game(engine* engine_obj);
+
+/**
+ * Take a seat that is leaving the table out of play, withdrawing its
+ * offers into its hand and announcing each size of offer withdrawn to
+ * the other seats.
+ */
+void engine_withdraw_seat(engine* engine_obj, size_t seat);
+
+/**
+ * Carry out an action for a seat, whether or not it is the seat's turn.
+ *
+ * This is how the server plays, where there are no turns, so an
+ * ENGINE_PASS does nothing here and a round only ends once it is won.
+ * A failed action sends ENGINE_ERROR to the seat and returns false,
+ * after returning the cards of a rejected offer by
+ * ENGINE_CANCELLED_OFFER.
+ */
+bool engine_submit(engine* engine_obj, size_t seat,
+                   const engine_action* action);
+
+/**
+ * Ask the seat whose turn it is for an action and carry it out.
+ *
+ * A round in which every seat passes in a row ends without a winner.
+ * Returns whether the game is still running.
+ */
+bool engine_step(engine* engine_obj);
+
+/**
+ * Carry out an action for the seat whose turn it is, in place of asking
+ * its agent, and move on to the next seat.
+ *
+ * This lets a caller outside the engine play a seat turn by turn.
+ * Returns whether the game is still running.
+ */
+bool engine_take_turn(engine* engine_obj, const engine_action* action);
+
+/**
+ * Play a whole game, taking at most max_turns turns.
+ *
+ * Returns true if a seat reached WINNING_SCORE, or false if the game
+ * was stopped after max_turns.
+ */
+bool engine_play_game(engine* engine_obj, size_t max_turns);
+
+/**
+ * Free an engine.
+ */
+void free_engine(engine* engine_obj);
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Libevent */
+#include <event2/buffer.h>
+
+/* JSON */
+#include <json-c/json.h>
+
+#include "command_error.h"
+
+/* Largest command packet accepted from a client, in bytes */
+#define MAX_FRAME_SIZE 65536
+
+/* Size of the big-endian length header of a length-prefixed frame */
+#define FRAME_HEADER_SIZE 4
+
+/* Delimiter terminating a newline-delimited frame */
+#define FRAME_DELIMITER '\n'
+
+/* Most buffer chains a frame is parsed across before it is linearised */
+#define MAX_FRAME_EXTENTS 8
+
+typedef enum framing framing;
+typedef enum frame_status frame_status;
+typedef struct frame_reader frame_reader;
+
+/* First byte of a command packet, which starts a newline-delimited
+   connection */
+#define FRAME_PACKET_OPEN '{'
+
+/**
+ * Enumeration of the ways command packets are delimited on the wire.
+ *
+ * The framing of a connection is fixed by the first byte its client
+ * sends, and applies to both directions.
+ */
+enum framing {
+  /* Each packet is terminated by FRAME_DELIMITER */
+  FRAMING_NEWLINE = 0,
+  /* Each packet is preceded by a FRAME_HEADER_SIZE byte length */
+  FRAMING_LENGTH,
+  /* Not known until the first byte from the peer arrives */
+  FRAMING_UNKNOWN
+};
+
+/**
+ * Result of looking for the next frame in an input buffer.
+ */
+enum frame_status {
+  /* A complete frame is at the front of the input buffer */
+  FRAME_READY,
+  /* More data is needed before the next frame is complete */
+  FRAME_INCOMPLETE,
+  /* The next frame is larger than MAX_FRAME_SIZE and is being discarded */
+  FRAME_TOO_LARGE
+};
+
+/**
+ * Per-connection reassembly state for incoming frames.
+ *
+ * Incoming bytes are never copied out of the input buffer, so the
+ * reader only needs to remember how far it has progressed through the
+ * frame at the front of the buffer.
+ */
+struct frame_reader {
+  /* The framing used by the connection */
+  framing mode;
+
+  /* Length of the frame at the front of the buffer, if known */
+  size_t frame_len;
+
+  /* Whether frame_len has been determined yet */
+  bool have_len;
+
+  /* Bytes already searched for a delimiter without finding one */
+  size_t scanned;
+
+  /* Whether an oversized frame is being discarded */
+  bool discarding;
+
+  /* Bytes of an oversized length-prefixed frame left to discard */
+  size_t discard_len;
+
+  /* JSON tokener reused for every frame from the connection */
+  json_tokener* tok;
+};
+
+/**
+ * Parse the name of a framing mode.
+ *
+ * Returns false if the name does not correspond to a framing mode.
+ */
+bool framing_from_str(const char* name, framing* mode);
+
+/**
+ * Initialise a frame_reader for a connection using a given framing.
+ *
+ * A reader given FRAMING_UNKNOWN picks the framing from the first byte
+ * to arrive: FRAME_PACKET_OPEN or FRAME_DELIMITER select newline
+ * framing, and any other byte is the start of a length header.
+ */
+void frame_reader_init(frame_reader* reader, framing mode);
+
+/**
+ * Look for the next complete frame at the front of an input buffer.
+ *
+ * On FRAME_READY, frame_len is set to the length of the frame payload,
+ * which can then be taken out of the buffer using parse_frame().
+ * FRAME_TOO_LARGE is returned once per oversized frame, whose bytes are
+ * then silently drained as they arrive. Empty frames carry no packet and
+ * are skipped, so a client can open a connection with one to set its
+ * framing.
+ */
+frame_status next_frame(frame_reader* reader, struct evbuffer* input,
+                        size_t* frame_len);
+
+/**
+ * Parse the frame found by next_frame() and drain it from the input
+ * buffer.
+ *
+ * The payload is parsed where it lies in the buffer's chains, and is
+ * only linearised if it is spread over more than MAX_FRAME_EXTENTS
+ * chains.
+ * Sets res to jerr, on failure returns NULL.
+ */
+json_object* parse_frame(frame_reader* reader, struct evbuffer* input,
+                         size_t frame_len, cmd_result* res);
+
+/**
+ * Encode what precedes a frame's payload on the wire.
+ *
+ * dest must have room for at least FRAME_HEADER_SIZE characters.
+ * Returns the encoded length.
+ */
+size_t encode_frame_header(char* dest, framing mode, size_t payload_len);
+
+/**
+ * Encode what follows a frame's payload on the wire.
+ *
+ * dest must have room for at least one character. Returns the encoded
+ * length.
+ */
+size_t encode_frame_trailer(char* dest, framing mode);
+
+/**
+ * Free memory held by a frame_reader.
+ */
+void free_frame_reader(frame_reader* reader);
+
+#endif
@@ -4,8 +4,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-#include "card_array.h"
-#include "book.h"
+#include "engine.h"
 
 typedef struct game_state game_state;
 
@@ -16,26 +15,20 @@ struct game_state {
   /* Number of players needed to start the game */
   int player_limit;
 
-  /* Whether the game is currently running */
-  bool running;
-
-  /* Deck of cards used for the game */
-  card_array* deck;
-
-  /* Trade book containing active offers */
-  book* current_trades;
+  /* The table the game is played at, holding the deck, the book and
+     every player's hand and score. The table's owner IDs are seats */
+  engine* table;
 };
 
-/**
- * Global game state structure.
- */
-extern game_state* billionaire_game;
-
 /**
  * Initialise and allocate memory to the game_state structure.
+ *
+ * The game's shuffles are drawn from the given stream of the seed, so
+ * they do not depend on any other game. There must be at least 2
+ * players.
  */
 game_state* game_state_new(int player_limit, bool has_billionaire,
-                           bool has_taxman);
+                           bool has_taxman, uint64_t seed, uint64_t stream);
 
 /**
  * Check whether a game_state has reached the player limit.
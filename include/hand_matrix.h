@@ -0,0 +1,98 @@
+#ifndef _HAND_MATRIX_H_
+#define _HAND_MATRIX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "card_location.h"
+
+/* Seats evaluated together by the widest kernel, which every row of a
+ * hand_matrix is padded to */
+#define HAND_MATRIX_ALIGN 32
+
+typedef struct hand_matrix hand_matrix;
+typedef enum hand_kernel hand_kernel;
+
+/**
+ * The hands of every seat at a table, stored card type by card type.
+ *
+ * Row card holds the count of that card type for each seat in turn, so
+ * the same card type of many seats can be loaded into one vector
+ * register and every seat scored in a single pass.
+ */
+struct hand_matrix {
+  /* Number of seats in the matrix */
+  size_t num_seats;
+
+  /* Distance between rows, num_seats rounded up to HAND_MATRIX_ALIGN */
+  size_t stride;
+
+  /* TOTAL_UNIQUE_CARDS rows of stride counts */
+  uint8_t* counts;
+};
+
+/**
+ * Enumeration of the implementations of evaluate_hand_matrix().
+ */
+enum hand_kernel {
+  /* Use the widest kernel supported by the CPU */
+  HAND_KERNEL_AUTO = 0,
+  /* One seat at a time */
+  HAND_KERNEL_SCALAR,
+  /* 16 seats at a time */
+  HAND_KERNEL_SSE2,
+  /* 32 seats at a time */
+  HAND_KERNEL_AVX2
+};
+
+/**
+ * Create an empty hand_matrix with a number of seats.
+ */
+hand_matrix* hand_matrix_new(size_t num_seats);
+
+/**
+ * Copy a card_location into the column of a seat.
+ */
+void set_hand_matrix_seat(hand_matrix* matrix, size_t seat,
+                          const card_location* hand);
+
+/**
+ * Return the count of a card type held by a seat.
+ */
+uint8_t get_hand_matrix_count(const hand_matrix* matrix, size_t seat,
+                              card_id card);
+
+/**
+ * Remove every card from a hand_matrix.
+ */
+void clear_hand_matrix(hand_matrix* matrix);
+
+/**
+ * Check whether a kernel can be run by this CPU.
+ */
+bool hand_kernel_supported(hand_kernel kernel);
+
+/**
+ * Evaluate the hand of every seat at once.
+ *
+ * For each seat, won is set to whether has_won() holds for its hand and
+ * scores to evaluate_hand_score() of its hand. Either output may be
+ * NULL. Both must otherwise have room for num_seats values.
+ */
+void evaluate_hand_matrix(const hand_matrix* matrix, bool* won, int* scores);
+
+/**
+ * Evaluate the hand of every seat at once using a specific kernel.
+ *
+ * The kernel must be supported by the CPU.
+ */
+void evaluate_hand_matrix_with(const hand_matrix* matrix, hand_kernel kernel,
+                               bool* won, int* scores);
+
+/**
+ * Free a hand_matrix.
+ */
+void free_hand_matrix(hand_matrix* matrix);
+
+#endif
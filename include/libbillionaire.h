@@ -0,0 +1,26 @@
+#ifndef _LIBBILLIONAIRE_H_
+#define _LIBBILLIONAIRE_H_
+
+/**
+ * Public header of libbillionaire, the game core of the server built as
+ * a library of its own.
+ *
+ * The library holds the same book, card_location, card_array,
+ * hand_matrix and rng code the server enforces the rules with, along
+ * with the engine that plays whole games in process and the batch_engine
+ * that steps many games at once. Nothing in it uses
+ * libevent or any global state, so separate engines can be driven from
+ * separate threads. Programs link with -lbillionaire -ljson-c -lxxhash.
+ */
+
+#include "batch_engine.h"
+#include "book.h"
+#include "card_array.h"
+#include "card_location.h"
+#include "engine.h"
+#include "hand_matrix.h"
+#include "packed_hand.h"
+#include "rng.h"
+#include "rules.h"
+
+#endif
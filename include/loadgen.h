@@ -0,0 +1,275 @@
+#ifndef _LOADGEN_H_
+#define _LOADGEN_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <netinet/in.h>
+
+/* Libevent */
+#include <event2/event.h>
+#include <event2/bufferevent.h>
+
+/* JSON */
+#include <json-c/json.h>
+
+#include "card_location.h"
+#include "frame.h"
+#include "rng.h"
+
+/* Most connections a load generator can open */
+#define LOADGEN_MAX_CONNS 65536
+
+/* Latencies under 2^LOADGEN_HIST_SUB_BITS ns are counted exactly, and
+   larger ones in LOADGEN_HIST_SUB buckets per power of two, so a
+   percentile is reported to within 1/LOADGEN_HIST_SUB of its value */
+#define LOADGEN_HIST_SUB_BITS 4
+#define LOADGEN_HIST_SUB (1 << LOADGEN_HIST_SUB_BITS)
+#define LOADGEN_HIST_BUCKETS ((64 - LOADGEN_HIST_SUB_BITS + 1)*LOADGEN_HIST_SUB)
+
+/* Largest command packet a connection sends, without framing */
+#define LOADGEN_PACKET_MAX_LEN (64 + CARD_LOCATION_JSON_MAX_LEN)
+
+/* Seconds before a connection closed by the server is opened again */
+#define LOADGEN_RETRY_SECS 1
+
+typedef enum loadgen_format loadgen_format;
+typedef struct loadgen_options loadgen_options;
+typedef struct loadgen_strategy loadgen_strategy;
+typedef struct loadgen_hist loadgen_hist;
+typedef struct loadgen_stats loadgen_stats;
+typedef struct loadgen_conn loadgen_conn;
+typedef struct loadgen_slot loadgen_slot;
+typedef struct loadgen loadgen;
+
+/**
+ * Formats a run's results can be written in.
+ */
+enum loadgen_format {
+  LOADGEN_JSON = 0,
+  /* One row per run, appended below a header to a new or empty file */
+  LOADGEN_CSV
+};
+
+/**
+ * How a run is set up, from the command line.
+ */
+struct loadgen_options {
+  /* Server to connect to, an IPv4 address */
+  const char* host;
+  int port;
+
+  /* Framing every connection picks with its first packet */
+  framing mode;
+
+  /* Tables to fill, and the player limit the server was started with */
+  size_t num_tables;
+  size_t num_players;
+
+  /* Milliseconds between a connection's chances to act */
+  int think_ms;
+
+  /* Seconds to run for */
+  int duration;
+
+  uint64_t seed;
+
+  const loadgen_strategy* strategy;
+
+  /* File results are written to, or NULL */
+  const char* output;
+  loadgen_format format;
+};
+
+/**
+ * A built-in way of choosing offers, selected by name on the command
+ * line.
+ */
+struct loadgen_strategy {
+  const char* name;
+
+  /* Fill in an offer from the hand. Returns false to offer nothing */
+  bool (*choose)(const card_location* hand, rng* rng_obj,
+                 card_location* offer);
+};
+
+/**
+ * A log-linear histogram of latencies in nanoseconds.
+ */
+struct loadgen_hist {
+  uint64_t counts[LOADGEN_HIST_BUCKETS];
+
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+};
+
+/**
+ * Everything measured over a run.
+ */
+struct loadgen_stats {
+  /* Connections made, refused and closed by the server */
+  size_t connects;
+  size_t connect_failures;
+  size_t disconnects;
+
+  /* Commands sent and received, and their bytes on the wire */
+  size_t offers_sent;
+  size_t cancels_sent;
+  size_t commands_received;
+  size_t bytes_sent;
+  size_t bytes_received;
+
+  /* SUCCESSFUL_TRADE commands received, two for every trade */
+  size_t fills;
+
+  /* END_ROUND and END_GAME commands received, one per player */
+  size_t round_ends;
+  size_t game_ends;
+
+  /* ERROR commands received, and packets that could not be parsed */
+  size_t errors;
+  size_t bad_packets;
+
+  /* Connecting until the first START */
+  loadgen_hist connect_start;
+
+  /* Sending NEW_OFFER until the offer is seen to trade straight away,
+     by SUCCESSFUL_TRADE to its owner or BOOK_EVENT to a tablemate */
+  loadgen_hist offer_trade;
+
+  /* Sending NEW_OFFER until a tablemate is told it is on the book */
+  loadgen_hist offer_book;
+};
+
+/**
+ * A single connection to the server, playing one seat of a table.
+ *
+ * A connection has at most one offer on the book, and waits for each
+ * offer or cancel it sends to be answered before sending another, so
+ * every latency sample belongs to exactly one request.
+ */
+struct loadgen_conn {
+  loadgen* owner;
+
+  /* Index among the generator's connections, also its rng stream */
+  size_t index;
+
+  struct bufferevent* bev;
+  frame_reader reader;
+
+  /* Timer giving the connection a chance to act every think_ms */
+  struct event* act_ev;
+
+  /* ID given by the server in JOIN */
+  uint32_t id;
+  bool joined;
+
+  /* Whether a round is being played, and the hand it holds */
+  bool playing;
+  card_location hand;
+
+  /* Size of the connection's offer on the book, or 0 */
+  size_t resting_amt;
+
+  /* Whether the first START since connecting is still to come */
+  bool awaiting_start;
+  uint64_t connect_ns;
+
+  /* The offer or cancel waiting for an answer */
+  bool offer_pending;
+  bool cancel_pending;
+  uint64_t offer_ns;
+
+  rng rng_obj;
+};
+
+/**
+ * A slot of the table finding connections by server ID.
+ */
+struct loadgen_slot {
+  uint32_t id;
+
+  /* The connection, or NULL if the slot is empty */
+  loadgen_conn* conn;
+};
+
+/**
+ * A single-threaded load generator, driving every connection from one
+ * event loop.
+ */
+struct loadgen {
+  const loadgen_options* options;
+
+  struct event_base* evbase;
+  struct sockaddr_in addr;
+
+  /* Timeout shared by every connection's act timer */
+  const struct timeval* think_tv;
+
+  loadgen_conn* conns;
+  size_t num_conns;
+
+  /* Connections by server ID, a power of two of slots kept at most half
+     full with linear probing, so a BOOK_EVENT can be matched to the
+     offer that caused it */
+  loadgen_slot* slots;
+  size_t slot_mask;
+
+  /* Whether connections closed by the server are opened again */
+  bool running;
+
+  loadgen_stats stats;
+};
+
+/**
+ * Return the built-in strategy with the given name, or NULL.
+ */
+const loadgen_strategy* find_loadgen_strategy(const char* name);
+
+/**
+ * Count a latency in a histogram.
+ */
+void hist_record(loadgen_hist* hist, uint64_t value_ns);
+
+/**
+ * Return the smallest latency at least the given fraction of samples
+ * are no greater than, to the precision of the histogram's buckets.
+ * Returns 0 for an empty histogram.
+ */
+uint64_t hist_percentile(const loadgen_hist* hist, double fraction);
+
+/**
+ * Create a load generator for a run, without connecting yet.
+ */
+loadgen* loadgen_new(const loadgen_options* options);
+
+/**
+ * Open every connection and play until the run's duration is up or the
+ * loop is broken.
+ */
+void run_loadgen(loadgen* lg);
+
+/**
+ * Print a summary of a run's results.
+ */
+void print_loadgen_stats(const loadgen* lg, double elapsed);
+
+/**
+ * Write a run's results to a file in the requested format.
+ */
+void write_loadgen_results(const loadgen* lg, double elapsed, FILE* out);
+
+/**
+ * Close every connection and free a load generator.
+ */
+void free_loadgen(loadgen* lg);
+
+/**
+ * Handle command line options using getopt_long.
+ */
+void parse_loadgen_options(int argc, char** argv, loadgen_options* options);
+
+#endif
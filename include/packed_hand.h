@@ -0,0 +1,179 @@
+#ifndef _PACKED_HAND_H_
+#define _PACKED_HAND_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Bits holding the count of one card type */
+#define PACKED_CARD_BITS 4
+
+/* Largest count of one card type a packed_hand can hold */
+#define PACKED_CARD_MAX 15
+
+/* Number of card types held in a packed_hand, commodities first */
+#define PACKED_NUM_CARDS 10
+#define PACKED_NUM_COMMODITIES 8
+
+/* Low bit of every count, of the commodity counts and of the wildcard
+ * counts */
+#define PACKED_LOW_BITS 0x1111111111ULL
+#define PACKED_COMMODITY_BITS 0x0011111111ULL
+#define PACKED_WILDCARD_BITS 0x1100000000ULL
+
+/* High bit of every count */
+#define PACKED_HIGH_BITS 0x8888888888ULL
+
+/* Every count, for splitting a hand into alternating counts */
+#define PACKED_EVEN_COUNTS 0x0F0F0F0F0FULL
+
+/**
+ * A set of cards packed into one word, one 4-bit count per card type.
+ *
+ * The count of card type i lives in bits 4i to 4i+3, so whole hands can
+ * be added, compared and searched a word at a time instead of a card
+ * type at a time.
+ */
+typedef uint64_t packed_hand;
+
+/**
+ * Return the count of one card type in a packed_hand.
+ */
+static inline uint64_t
+packed_get(packed_hand hand, int card)
+{
+  return (hand >> (card*PACKED_CARD_BITS)) & PACKED_CARD_MAX;
+}
+
+/**
+ * Return a packed_hand holding amount cards of a single type.
+ */
+static inline packed_hand
+packed_card(int card, uint64_t amount)
+{
+  return amount << (card*PACKED_CARD_BITS);
+}
+
+/**
+ * Add two packed_hands.
+ *
+ * No count of the sum may exceed PACKED_CARD_MAX.
+ */
+static inline packed_hand
+packed_add(packed_hand hand, packed_hand cards)
+{
+  return hand + cards;
+}
+
+/**
+ * Return the high bit of every count of hand that is smaller than the
+ * same count of cards.
+ *
+ * The lowest bit set is exact. A borrow out of it may also set bits
+ * above it, so only whether the result is zero and its lowest bit are
+ * meaningful.
+ */
+static inline uint64_t
+packed_borrows(packed_hand hand, packed_hand cards)
+{
+  packed_hand diff = hand - cards;
+
+  /* Borrow out of every bit of the subtraction */
+  uint64_t borrows = (~hand & cards) | (~(hand ^ cards) & diff);
+
+  return borrows & PACKED_HIGH_BITS;
+}
+
+/**
+ * Check whether every count of cards is at most the same count of hand.
+ */
+static inline bool
+packed_is_subset(packed_hand cards, packed_hand hand)
+{
+  return packed_borrows(hand, cards) == 0;
+}
+
+/**
+ * Subtract cards from hand, if cards is a subset of hand.
+ *
+ * Returns false and leaves hand unchanged otherwise.
+ */
+static inline bool
+packed_subtract(packed_hand* hand, packed_hand cards)
+{
+  if (packed_borrows(*hand, cards) != 0) {
+    return false;
+  }
+
+  *hand -= cards;
+
+  return true;
+}
+
+/**
+ * Return the low bit of every non-zero count of a packed_hand.
+ */
+static inline uint64_t
+packed_nonzero(packed_hand hand)
+{
+  return (hand | (hand >> 1) | (hand >> 2) | (hand >> 3)) & PACKED_LOW_BITS;
+}
+
+/**
+ * Return the number of distinct commodities in a packed_hand.
+ */
+static inline int
+packed_count_commodities(packed_hand hand)
+{
+  return __builtin_popcountll(packed_nonzero(hand) & PACKED_COMMODITY_BITS);
+}
+
+/**
+ * Return the number of distinct wildcards in a packed_hand.
+ */
+static inline int
+packed_count_wildcards(packed_hand hand)
+{
+  return __builtin_popcountll(packed_nonzero(hand) & PACKED_WILDCARD_BITS);
+}
+
+/**
+ * Return the total number of cards in a packed_hand.
+ */
+static inline uint64_t
+packed_total(packed_hand hand)
+{
+  /* Sum neighbouring counts into bytes, then every byte into the top one */
+  uint64_t pairs = (hand & PACKED_EVEN_COUNTS) +
+                   ((hand >> PACKED_CARD_BITS) & PACKED_EVEN_COUNTS);
+
+  return (pairs*0x0101010101010101ULL) >> 56;
+}
+
+/**
+ * Return a bitmask of the commodities that make a winning set with the
+ * wildcards of a packed_hand.
+ *
+ * Bit i is set when the count of commodity i plus the number of
+ * wildcards is at least win_amount, which must be at most 0x80.
+ */
+static inline unsigned
+packed_winning_commodities(packed_hand hand, unsigned win_amount)
+{
+  uint64_t wildcards = packed_get(hand, PACKED_NUM_COMMODITIES) +
+                       packed_get(hand, PACKED_NUM_COMMODITIES + 1);
+
+  /* Spread the commodity counts out to one per byte */
+  uint64_t lanes = hand & 0xFFFFFFFFULL;
+  lanes = (lanes | (lanes << 16)) & 0x0000FFFF0000FFFFULL;
+  lanes = (lanes | (lanes << 8)) & 0x00FF00FF00FF00FFULL;
+  lanes = (lanes | (lanes << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+
+  /* Bias every byte so its high bit is set once it reaches win_amount */
+  uint64_t bias = 0x80 + wildcards - win_amount;
+  uint64_t hits = (lanes + bias*0x0101010101010101ULL) & 0x8080808080808080ULL;
+
+  /* Gather the high bit of byte i into bit i */
+  return (unsigned) (((hits >> 7)*0x0102040810204080ULL) >> 56);
+}
+
+#endif
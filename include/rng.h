@@ -0,0 +1,41 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stdint.h>
+
+typedef struct rng rng;
+
+/**
+ * A xoshiro256** pseudorandom number generator.
+ *
+ * Each game holds its own generator, so games on different threads never
+ * share state and every game's shuffles can be replayed from its seed
+ * and stream alone. A generator is 32 bytes and is embedded by value.
+ */
+struct rng {
+  uint64_t state[4];
+};
+
+/**
+ * Seed a generator with one of many independent streams of a seed.
+ *
+ * The same seed and stream always give the same sequence, and different
+ * streams of a seed give unrelated sequences.
+ */
+void rng_init(rng* rng_obj, uint64_t seed, uint64_t stream);
+
+/**
+ * Return the next 64 random bits from a generator.
+ */
+uint64_t rng_next(rng* rng_obj);
+
+/**
+ * Return a uniformly distributed integer in [0, bound).
+ *
+ * Uses Lemire's multiply-and-reject method, which has no modulo bias
+ * and only needs a division in the rare case a sample is rejected.
+ * bound must be greater than 0.
+ */
+uint32_t rng_bounded(rng* rng_obj, uint32_t bound);
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef _ROOM_H_
+#define _ROOM_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/queue.h>
+
+#include "client.h"
+#include "client_hash_table.h"
+#include "game_state.h"
+
+/* Client hash table size of each room */
+#define ROOM_HASH_TABLE_SIZE 16
+
+typedef struct room room;
+typedef struct room_head room_head;
+typedef struct lobby lobby;
+
+/**
+ * A single table of Billionaire.
+ *
+ * Each room plays its own game with its own clients, so any number of
+ * games can be hosted by the same server.
+ */
+struct room {
+  /* The room number, for logging */
+  size_t id;
+
+  /* The game being played in the room */
+  game_state* game;
+
+  /* The clients in the room, keyed by ID */
+  client_hash_table* hashed_clients;
+
+  /* The clients in the room, in the order they joined */
+  client_head clients;
+
+  /* The client playing each seat of the game's table, or NULL once it
+     has left, and the ID it played under */
+  client* seats[MAX_PLAYERS];
+  uint32_t seat_ids[MAX_PLAYERS];
+
+  /* The lobby the room belongs to */
+  lobby* owner;
+
+  /* The pointers to the next and previous rooms in the lobby. */
+  TAILQ_ENTRY(room) entries;
+};
+
+TAILQ_HEAD(room_head, room);
+
+/**
+ * The collection of all rooms hosted by a server.
+ *
+ * Rooms waiting for players are kept at the front of the list of rooms,
+ * and running rooms at the back, so an open room is found in constant
+ * time.
+ */
+struct lobby {
+  /* All rooms, waiting rooms first */
+  room_head rooms;
+
+  /* Number of rooms in the lobby */
+  size_t num_rooms;
+
+  /* The number given to the next room created */
+  size_t next_room_id;
+
+  /* Number of players needed to start each game */
+  int player_limit;
+
+  /* Whether the billionaire is dealt in each game */
+  bool has_billionaire;
+
+  /* Whether the taxman is dealt in each game */
+  bool has_taxman;
+
+  /* Seed of every game in the lobby, each game using the stream given
+     by its room number */
+  uint64_t seed;
+};
+
+/**
+ * Create an empty room with a fresh game.
+ *
+ * The game shuffles with the stream of the seed given by the room's id.
+ */
+room* room_new(size_t id, int player_limit, bool has_billionaire,
+               bool has_taxman, uint64_t seed);
+
+/**
+ * Seat a client in a room.
+ *
+ * Returns false, leaving the client unseated, if a client with the same
+ * ID is already seated in the room.
+ */
+bool room_add_client(room* room_obj, client* client_obj);
+
+/**
+ * Remove a client from a room.
+ *
+ * Any offers the client has in the room's book are cancelled and their
+ * cards returned to the client's hand, and the rest of the room is sent
+ * a BOOK_EVENT for each size of offer cancelled. This method does not
+ * deallocate memory associated with the client.
+ */
+void room_remove_client(room* room_obj, client* client_obj);
+
+/**
+ * Check whether a room has no clients left in it.
+ */
+bool room_is_empty(const room* room_obj);
+
+/**
+ * Free a room, along with any clients still in it.
+ */
+void free_room(room* room_obj);
+
+/**
+ * Create an empty lobby, whose rooms use the given game options.
+ */
+lobby* lobby_new(int player_limit, bool has_billionaire, bool has_taxman,
+                 uint64_t seed);
+
+/**
+ * Return a room that is waiting for players.
+ *
+ * A new room is opened if every existing room is running.
+ */
+room* get_open_room(lobby* lobby_obj);
+
+/**
+ * Update the position of a room in its lobby after its game has started,
+ * stopped or ended.
+ */
+void update_room(room* room_obj);
+
+/**
+ * Remove a room from its lobby and free it.
+ */
+void close_room(room* room_obj);
+
+/**
+ * Free a lobby, along with all of its rooms.
+ */
+void free_lobby(lobby* lobby_obj);
+
+#endif
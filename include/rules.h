@@ -0,0 +1,13 @@
+#ifndef _RULES_H_
+#define _RULES_H_
+
+/* Most players at a table */
+#define MAX_PLAYERS 8
+
+/* Score every player starts a game with */
+#define INITIAL_SCORE 0
+
+/* A game ends with the round that takes a player to this score */
+#define WINNING_SCORE 5000
+
+#endif
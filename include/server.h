@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include <pthread.h>
 #include <sys/queue.h>
 
 /* Libevent. */
@@ -15,41 +16,116 @@
 #include <event2/bufferevent.h>
 #include <event2/buffer.h>
 
+#include "frame.h"
+#include "room.h"
+
 /* Port to listen on. */
 #define SERVER_PORT 5555
 
 /* Maximum size of address string used for hashing */
 #define ADDR_STR_SIZE 23
 
-/* Client hash table size */
-#define CLIENT_HASH_TABLE_SIZE 64
+/* Most worker threads the server can be started with */
+#define MAX_THREADS 256
+
+typedef struct server_ctx server_ctx;
+
+/**
+ * Everything served by one worker's event loop.
+ *
+ * This is passed to each listener callback in place of global state.
+ * Clients and rooms never move between workers, so the game logic of
+ * each worker runs on a single thread without any locking.
+ */
+struct server_ctx {
+  /* The worker number, for logging */
+  size_t id;
+
+  /* The libevent event base.  In libevent 1 you didn't need to worry
+   * about this for simple programs, but its used more in the libevent 2
+   * API. */
+  struct event_base* evbase;
+
+  /* The rooms games are played in */
+  lobby* rooms;
 
-/* The libevent event base.  In libevent 1 you didn't need to worry
- * about this for simple programs, but its used more in the libevent 2
- * API. */
-static struct event_base* evbase;
+  /* The worker's own listening socket */
+  int listen_fd;
+
+  /* The event notified when a connection is ready to be accepted */
+  struct event* ev_accept;
+
+  /* The thread running the event loop, unless it is the main thread */
+  pthread_t thread;
+};
 
 /**
  * Set a socket to non-blocking mode.
  */
 int setnonblock(int fd);
 
+/**
+ * Create a non-blocking socket listening on SERVER_PORT.
+ *
+ * With reuse_port set, any number of sockets may listen on the port at
+ * once, with the kernel spreading new connections between them.
+ */
+int open_listener(bool reuse_port);
+
+/**
+ * Run a worker's event loop until it is broken.
+ *
+ * This is the start routine of each worker thread.
+ */
+void* run_worker(void* arg);
+
+/**
+ * Free a worker's rooms along with the pools of the calling thread,
+ * reporting how much the pools were used.
+ *
+ * This must be called by the thread that ran the worker's event loop.
+ */
+void close_worker(server_ctx* ctx);
+
+/**
+ * Remove a client from its room and free it.
+ *
+ * The room is closed once empty, in which case true is returned, and a
+ * running game that no longer has enough players is stopped.
+ */
+bool drop_client(room* this_room, client* this_client);
+
+/**
+ * Send the commands queued for every client in a room.
+ *
+ * Any client that has overflowed, by being queued more commands than it
+ * can hold or by not reading what it has been sent, is dropped.
+ */
+void flush_room(room* this_room);
+
 /**
  * Called by libevent when there is data to read.
  *
  * This is where all of the server logic should go.
- * Responds to changes in cmd_errno by sending ERROR commands.
+ * Every complete frame in the input buffer is processed before queued
+ * commands are flushed, so clients can pipeline command packets.
+ * Responds to failed commands by sending ERROR commands.
  */
 void buffered_on_read(struct bufferevent* bev, void* arg);
 
 /**
  * Called by libevent when there is an error on the underlying socket
  * descriptor.
+ *
+ * The client leaves its room, which is closed once empty.
  */
 void buffered_on_error(struct bufferevent* bev, short what, void* arg);
 
 /**
  * Called by libevent when there is a connection ready to be accepted.
+ *
+ * The new client is seated in a room waiting for players, and that
+ * room's game is started once it is full.
  */
 void on_accept(int fd, short ev, void* arg);
 
@@ -58,7 +134,7 @@ void on_accept(int fd, short ev, void* arg);
  *
  * This breaks the base loop and allows cleanup code to execute.
  */
-void on_exit(int sig, short ev, void *arg);
+void on_signal(int sig, short ev, void *arg);
 
 /**
  * Handle command line options using getopt_long.
@@ -67,6 +143,7 @@ void parse_command_line_options(int argc, char** argv,
                                 int* player_limit,
                                 bool* has_billionaire,
                                 bool* has_taxman,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                int* num_threads);
 
 #endif
@@ -0,0 +1,192 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "engine.h"
+#include "rng.h"
+
+/* Most threads the simulator can be started with */
+#define SIM_MAX_THREADS 1024
+
+/* Size of a cache line, which separately written data is aligned to */
+#define SIM_CACHE_LINE 64
+
+/* Games claimed from a queue at once */
+#define SIM_BATCH_GAMES 16
+
+/* Turns after which a game is stopped without a winner */
+#define SIM_MAX_TURNS 1000000
+
+/* Rounds counted exactly in the game length histogram. Longer games
+   share the last bucket */
+#define SIM_MAX_ROUNDS 256
+
+/* Final scores are counted in buckets of SIM_SCORE_STEP points, from
+   SIM_SCORE_MIN up. Scores outside the buckets share the first or last */
+#define SIM_SCORE_STEP 1000
+#define SIM_SCORE_MIN (-5000)
+#define SIM_SCORE_BUCKETS 20
+
+typedef struct sim_options sim_options;
+typedef struct sim_strategy sim_strategy;
+typedef struct sim_slot_stats sim_slot_stats;
+typedef struct sim_stats sim_stats;
+typedef struct sim_queue sim_queue;
+typedef struct sim_worker sim_worker;
+typedef struct sim_seat sim_seat;
+
+/**
+ * Everything that decides the outcome of a run, which is the same for
+ * any number of threads.
+ */
+struct sim_options {
+  size_t num_seats;
+  bool has_billionaire;
+  bool has_taxman;
+  uint64_t seed;
+
+  /* Games to play, and the turns after which a game is stopped */
+  size_t num_games;
+  size_t max_turns;
+
+  /* The strategy of each slot of the lineup. Seats are assigned slots
+     in a different rotation every game */
+  const sim_strategy* lineup[ENGINE_MAX_SEATS];
+};
+
+/**
+ * A built-in way of playing, selected by name on the command line.
+ */
+struct sim_strategy {
+  const char* name;
+
+  void (*act)(const engine* engine_obj, size_t seat, engine_action* action,
+              void* data);
+};
+
+/**
+ * Results of the games played by one slot of the lineup.
+ */
+struct sim_slot_stats {
+  /* Games won, with a tie for the highest score counting for each seat
+     in it */
+  size_t wins;
+
+  /* Rounds won by going billionaire */
+  size_t billionaires;
+
+  /* Final scores of finished games */
+  int64_t score_sum;
+  double score_sq_sum;
+  int min_score;
+  int max_score;
+  size_t score_hist[SIM_SCORE_BUCKETS];
+};
+
+/**
+ * Results of a set of games, kept by each thread and merged at the end.
+ */
+struct sim_stats {
+  /* Games played, and those stopped after max_turns */
+  size_t num_games;
+  size_t num_unfinished;
+
+  /* Length of finished games */
+  size_t total_turns;
+  size_t total_trades;
+  size_t total_rounds;
+  size_t max_game_turns;
+  size_t round_hist[SIM_MAX_ROUNDS + 1];
+
+  sim_slot_stats slots[ENGINE_MAX_SEATS];
+};
+
+/**
+ * A range of game indices owned by a thread. The owner and thieves both
+ * claim games with an atomic add on next, so a queue is only contended
+ * once its owner has run out of games of its own.
+ */
+struct sim_queue {
+  _Alignas(SIM_CACHE_LINE) atomic_size_t next;
+  size_t end;
+};
+
+/**
+ * The seat of an engine being played by a slot of the lineup, handed to
+ * the slot's strategy as its data.
+ */
+struct sim_seat {
+  /* The generator of the game, shared by every seat */
+  rng* rng_obj;
+
+  sim_slot_stats* stats;
+};
+
+/**
+ * A thread of the simulator, with its own engine and stats.
+ * Workers are cache line aligned so no two threads write to the same
+ * line while games are being played.
+ */
+struct sim_worker {
+  _Alignas(SIM_CACHE_LINE) size_t id;
+
+  pthread_t thread;
+
+  const sim_options* options;
+
+  /* Every worker's queue, of which this worker owns queues[id] */
+  sim_queue* queues;
+  size_t num_workers;
+
+  /* Games taken from other workers' queues */
+  size_t num_stolen;
+
+  sim_stats stats;
+};
+
+/**
+ * Return the built-in strategy with the given name, or NULL.
+ */
+const sim_strategy* find_strategy(const char* name);
+
+/**
+ * Play a single game on an engine, adding its results to stats.
+ *
+ * The deck is shuffled with stream 2*game of the seed and the seats act
+ * on stream 2*game + 1, so a game's result does not depend on which
+ * thread plays it.
+ */
+void play_sim_game(engine* engine_obj, const sim_options* options,
+                   size_t game, sim_stats* stats);
+
+/**
+ * Play games from the worker's own queue, then from other workers'
+ * queues until every queue is empty.
+ *
+ * This is the start routine of each worker thread.
+ */
+void* run_sim_worker(void* arg);
+
+/**
+ * Add the results of one set of games to another.
+ */
+void merge_sim_stats(sim_stats* total, const sim_stats* stats);
+
+/**
+ * Print a summary of a run's results.
+ */
+void print_sim_stats(const sim_options* options, const sim_stats* stats);
+
+/**
+ * Handle command line options using getopt_long.
+ */
+void parse_sim_options(int argc, char** argv, sim_options* options,
+                       int* num_threads);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <stdlib.h>
+
+typedef struct slab slab;
+typedef struct slab_chunk slab_chunk;
+typedef struct slab_stats slab_stats;
+
+/**
+ * Counters describing the use of a slab.
+ */
+struct slab_stats {
+  /* Objects handed out by slab_alloc() */
+  size_t num_allocs;
+
+  /* Objects given back by slab_free() */
+  size_t num_frees;
+
+  /* Objects currently handed out */
+  size_t num_live;
+
+  /* Most objects handed out at once */
+  size_t peak_live;
+
+  /* Chunks requested from the system allocator */
+  size_t num_chunks;
+
+  /* Times every object was released at once by slab_reset() */
+  size_t num_resets;
+};
+
+/**
+ * A pool of equally sized objects carved out of large chunks.
+ *
+ * Freed objects are kept on a free list and handed out again, so once a
+ * slab has grown to its working size, allocating and freeing an object
+ * never reaches the system allocator. Chunks are only returned to the
+ * system when the slab itself is freed.
+ *
+ * A slab is not thread safe, so each one must only be used by a single
+ * thread at a time.
+ */
+struct slab {
+  /* Size of each object, rounded up to keep objects aligned */
+  size_t obj_size;
+
+  /* Number of objects in each chunk */
+  size_t chunk_objs;
+
+  /* Objects that have been freed, linked through their first bytes */
+  void* free_list;
+
+  /* Every chunk, oldest first */
+  slab_chunk* chunks;
+
+  /* The chunk objects are currently being carved from */
+  slab_chunk* current;
+
+  /* Objects carved from the current chunk so far */
+  size_t current_used;
+
+  /* Usage counters */
+  slab_stats stats;
+};
+
+/**
+ * Create an empty slab of objects of a given size.
+ *
+ * Memory is requested chunk_objs objects at a time.
+ */
+slab* slab_new(size_t obj_size, size_t chunk_objs);
+
+/**
+ * Request chunks from the system up front, until the slab holds room
+ * for at least num_objs objects in total.
+ *
+ * Chunks are otherwise only requested once every object is in use.
+ */
+void slab_reserve(slab* slab_obj, size_t num_objs);
+
+/**
+ * Take an uninitialised object from a slab.
+ */
+void* slab_alloc(slab* slab_obj);
+
+/**
+ * Return an object to the slab it was taken from.
+ */
+void slab_free(slab* slab_obj, void* obj);
+
+/**
+ * Release every object taken from a slab at once.
+ *
+ * Any object still in use from the slab becomes invalid. The slab's
+ * chunks are kept to be reused.
+ */
+void slab_reset(slab* slab_obj);
+
+/**
+ * Return the usage counters of a slab.
+ */
+const slab_stats* get_slab_stats(const slab* slab_obj);
+
+/**
+ * Free a slab, along with every object taken from it.
+ */
+void free_slab(slab* slab_obj);
+
+#endif
@@ -1,12 +1,23 @@
 #ifndef _UTILS_H_
 #define _UTILS_H_
 
+#include <inttypes.h> /* PRIx32 */
 #include <stdint.h> /* uint32_t */
 #include <stdlib.h>
 
 #include <json-c/json.h>
 
-#define HASH_LENGTH 9
+#include "command_error.h"
+
+/* Number of hex digits a client ID is written with */
+#define CLIENT_ID_DIGITS 8
+
+/* printf format of a client ID, as it is written to clients */
+#define CLIENT_ID_FMT "%08" PRIx32
+
+/* Upper bound on the length of a string of length n encoded as JSON,
+ * where every character is escaped as \u00XX */
+#define JSON_STR_MAX_LEN(n) (6*(n) + 2)
 
 #define JSON_ARRAY_FOREACH(obj, json_array)                     \
   size_t i, array_len = json_object_array_length((json_array)); \
@@ -29,12 +40,18 @@ uint32_t hash_xxhash(const char* key);
 uint32_t mix(uint32_t a, uint32_t b, uint32_t c);
 
 /**
- * Return a 8-digit hex string of a 32-bit hash based on the client
- * address.
+ * Return a 32-bit hash of a client address.
  *
  * Used to uniquely identify clients based on their address.
  */
-char* hash_addr(const char* addr);
+uint32_t hash_addr(const char* addr);
+
+/**
+ * Write a client ID as CLIENT_ID_DIGITS lowercase hex digits.
+ *
+ * No null terminator is written. Returns CLIENT_ID_DIGITS.
+ */
+size_t encode_client_id(char* dest, uint32_t id);
 
 /**
  * Convert a JSON object to a C string.
@@ -43,18 +60,28 @@ char* hash_addr(const char* addr);
  */
 const char* JSON_to_str(json_object* json_obj, size_t* str_len);
 
+/**
+ * Encode a C string as a quoted JSON string.
+ *
+ * dest must have room for at least JSON_STR_MAX_LEN(str_len) characters.
+ * Returns the encoded length.
+ */
+size_t encode_JSON_string(char* dest, const char* str, size_t str_len);
+
 /**
  * Convert a C string to a JSON object.
  *
- * Sets cmd_errno to jerr, on failure returns NULL.
+ * Sets res to jerr, on failure returns NULL.
  */
-json_object* str_to_JSON(const char* json_str, size_t json_str_len);
+json_object* str_to_JSON(const char* json_str, size_t json_str_len,
+                         cmd_result* res);
 
 /**
  * Extract a value from a JSON object given its key.
  *
- * Sets cmd_errno to EJSONVAL, on failure returns NULL.
+ * Sets res to EJSONVAL, on failure returns NULL.
  */
-json_object* get_JSON_value(json_object* json_obj, const char* key);
+json_object* get_JSON_value(json_object* json_obj, const char* key,
+                            cmd_result* res);
 
 #endif
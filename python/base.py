@@ -7,6 +7,9 @@ import signal
 from card import CardLocation
 from command import Command, CommandList
 
+# Terminates each newline-framed command packet
+PACKET_DELIMITER = b'\n'
+
 
 class BotMeta(abc.ABCMeta):
     """Metaclass to decorate issue_command with"""
@@ -79,6 +82,7 @@ class BaseBillionaireBot(asyncio.Protocol, metaclass=BotMeta):
 
         # Billionaire bot variables
         self.received_cmds = CommandList()
+        self.read_buffer = b''
         self.id = ''
         self.hand = CardLocation()
 
@@ -98,7 +102,7 @@ class BaseBillionaireBot(asyncio.Protocol, metaclass=BotMeta):
         while True:
             command = await self.queue.get()
             data = command.to_json().encode('utf-8')
-            self.transport.write(data)
+            self.transport.write(data + PACKET_DELIMITER)
             print(f'SENT {command!r}')
 
     async def send_command(self, command):
@@ -111,7 +115,21 @@ class BaseBillionaireBot(asyncio.Protocol, metaclass=BotMeta):
         self.transport = transport
         print('Connected to server')
 
+        # An empty packet picks newline framing before the server replies
+        self.transport.write(PACKET_DELIMITER)
+
     def data_received(self, data):
+        """Split received data into command packets
+
+        A partial packet is kept until the rest of it is received.
+        """
+        self.read_buffer += data
+        *packets, self.read_buffer = self.read_buffer.split(PACKET_DELIMITER)
+
+        for packet in packets:
+            self.packet_received(packet)
+
+    def packet_received(self, data):
         """Receive commands from the server
 
         A received command must have the following field:
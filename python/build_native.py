@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Build _billionaire_native, the cffi extension over libbillionaire
+
+Run by `make python` once bin/libbillionaire.a has been built. The
+extension is written next to this script, where native.py imports it.
+"""
+import os
+import shutil
+
+from cffi import FFI
+
+ROOT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PYTHON_DIR = os.path.join(ROOT_DIR, 'python')
+BUILD_DIR = os.path.join(ROOT_DIR, 'build', 'python')
+
+CDEF = """
+#define OFFER_MIN_CARDS ...
+#define OFFER_MAX_CARDS ...
+#define OFFER_INDEX_OFFSET ...
+#define MAX_PLAYERS ...
+#define INITIAL_SCORE ...
+#define WINNING_SCORE ...
+#define EJSON ...
+#define CMD_SUCCESS ...
+
+enum card_id {
+  DIAMONDS, GOLD, OIL, PROPERTY, MINING, SHIPPING, BANKING, SPORT,
+  TOTAL_COMMODITY_AMOUNT, BILLIONAIRE, TAX_COLLECTOR, TOTAL_UNIQUE_CARDS,
+  ...
+};
+
+typedef uint64_t packed_hand;
+
+typedef struct card_location {
+  packed_hand card_counts;
+  uint8_t num_cards;
+  ...;
+} card_location;
+
+typedef struct book_owner {
+  uint32_t owner_id;
+  uint32_t levels;
+  ...;
+} book_owner;
+
+typedef struct book {
+  book_owner owners[...];
+  size_t num_owners;
+  ...;
+} book;
+
+typedef enum engine_action_type {
+  ENGINE_PASS, ENGINE_NEW_OFFER, ENGINE_CANCEL_OFFER, ...
+} engine_action_type;
+
+typedef struct engine_action {
+  engine_action_type type;
+  card_location cards;
+  size_t card_amt;
+  ...;
+} engine_action;
+
+typedef struct engine {
+  size_t num_seats;
+  card_location hands[...];
+  int scores[...];
+  bool running;
+  size_t next_seat;
+  book* current_trades;
+  int last_err;
+  size_t num_turns;
+  size_t num_trades;
+  size_t num_rounds;
+  ...;
+} engine;
+
+typedef struct batch_obs {
+  uint8_t* seats;
+  packed_hand* hands;
+  uint32_t* offer_levels;
+  uint32_t* own_levels;
+  int* errors;
+  int* rewards;
+  bool* dones;
+  ...;
+} batch_obs;
+
+typedef struct batch_engine {
+  size_t num_games;
+  size_t num_seats;
+  card_location* hands;
+  int* scores;
+  size_t num_games_won;
+  size_t num_rounds;
+  batch_obs obs;
+  ...;
+} batch_engine;
+
+extern const char* error_what[];
+
+engine* engine_new(size_t num_seats, bool has_billionaire, bool has_taxman,
+                   uint64_t seed, uint64_t stream);
+void seed_engine(engine* engine_obj, uint64_t seed, uint64_t stream);
+void engine_start_game(engine* engine_obj);
+void engine_stop_game(engine* engine_obj);
+bool engine_submit(engine* engine_obj, size_t seat,
+                   const engine_action* action);
+bool engine_take_turn(engine* engine_obj, const engine_action* action);
+void free_engine(engine* engine_obj);
+
+batch_engine* batch_engine_new(size_t num_games, size_t num_seats,
+                               bool has_billionaire, bool has_taxman,
+                               uint64_t seed);
+void batch_engine_reset(batch_engine* batch);
+const batch_obs* batch_engine_step(batch_engine* batch,
+                                   const engine_action actions[]);
+void free_batch_engine(batch_engine* batch);
+"""
+
+ffibuilder = FFI()
+ffibuilder.cdef(CDEF)
+ffibuilder.set_source(
+    '_billionaire_native',
+    '#include "libbillionaire.h"',
+    include_dirs=[os.path.join(ROOT_DIR, 'include')],
+    extra_objects=[os.path.join(ROOT_DIR, 'bin', 'libbillionaire.a')],
+    libraries=['json-c', 'xxhash'],
+    extra_compile_args=['-std=c11'])
+
+if __name__ == '__main__':
+    module_path = ffibuilder.compile(tmpdir=BUILD_DIR)
+    shutil.copy(module_path, PYTHON_DIR)
@@ -12,6 +12,9 @@ TCP_IP = '127.0.0.1'
 TCP_PORT = 5555
 ADDR = (TCP_IP, TCP_PORT)
 
+# Terminates each newline-framed command packet
+PACKET_DELIMITER = b'\n'
+
 
 class MessagePasser(GObject.Object):
     """A test, first and foremost"""
@@ -22,6 +25,7 @@ class MessagePasser(GObject.Object):
 
         self.output = None
         self.input = None
+        self.read_buffer = b''
 
         self.client = Gio.SocketClient.new()
 
@@ -42,7 +46,8 @@ class MessagePasser(GObject.Object):
 
         command_list = CommandList(command)
 
-        self.output.write(command_list.to_json().encode('utf-8'))
+        data = command_list.to_json().encode('utf-8')
+        self.output.write(data + PACKET_DELIMITER)
 
     def run(self):
         socket_addr = Gio.InetSocketAddress.new_from_string(*ADDR)
@@ -67,14 +72,31 @@ class MessagePasser(GObject.Object):
         self.output = self.conn.get_output_stream()
         self.input = self.conn.get_input_stream()
 
+        # An empty packet picks newline framing before the server replies
+        self.output.write(PACKET_DELIMITER)
+
         self.input.read_bytes_async(MessagePasser.READ_BYTES,
                                     GLib.PRIORITY_DEFAULT, self.cancellable,
                                     self.on_read)
 
     def on_read(self, source_object, result, *user_data):
-        """Receive commands from the server"""
+        """Split data from the server into command packets"""
         data = source_object.read_bytes_finish(result).get_data()
 
+        # Keep any partial packet until the rest of it is received
+        self.read_buffer += data
+        *packets, self.read_buffer = self.read_buffer.split(PACKET_DELIMITER)
+
+        for packet in packets:
+            self.on_packet(packet)
+
+        # Continually add this
+        source_object.read_bytes_async(MessagePasser.READ_BYTES,
+                                       GLib.PRIORITY_DEFAULT, self.cancellable,
+                                       self.on_read)
+
+    def on_packet(self, data):
+        """Receive commands from the server"""
         try:
             self.received_cmds = CommandList.from_bytes(data)
         except UnicodeDecodeError as e:
@@ -175,11 +197,6 @@ class MessagePasser(GObject.Object):
             self.feed.add_to_feed(Command.END_ROUND,
                                   f'Your current score is now {new_score}')
 
-        # Continually add this
-        source_object.read_bytes_async(MessagePasser.READ_BYTES,
-                                       GLib.PRIORITY_DEFAULT, self.cancellable,
-                                       self.on_read)
-
     def on_new_offer(self, widget, offer):
         print(f'NEW_OFFER: {offer}')
 
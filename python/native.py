@@ -0,0 +1,287 @@
+"""Games of Billionaire played in process on the native C engine
+
+Requires NumPy and the _billionaire_native extension, which is built by
+`make python`. The rules are those of libbillionaire, the same code the
+server enforces them with.
+
+Hands are handed back as NumPy arrays of card counts indexed by the
+values of CardID, so no Python object is made per card.
+"""
+from collections import namedtuple
+
+import numpy as np
+
+from _billionaire_native import ffi, lib
+from card import CardID
+
+# Card types counted in a hand, commodities first
+NUM_CARD_TYPES = lib.TOTAL_UNIQUE_CARDS
+
+# Kinds of action a seat can take on its turn
+ACTION_PASS = lib.ENGINE_PASS
+ACTION_OFFER = lib.ENGINE_NEW_OFFER
+ACTION_CANCEL = lib.ENGINE_CANCEL_OFFER
+
+# Layout of engine_action, so a batch of actions can be filled by NumPy
+ACTION_DTYPE = np.dtype({
+    'names': ['type', 'cards', 'num_cards', 'card_amt'],
+    'formats': [f'i{ffi.sizeof("engine_action_type")}', '<u8', 'u1',
+                f'u{ffi.sizeof("size_t")}'],
+    'offsets': [ffi.offsetof('engine_action', 'type'),
+                ffi.offsetof('engine_action', 'cards') +
+                ffi.offsetof('card_location', 'card_counts'),
+                ffi.offsetof('engine_action', 'cards') +
+                ffi.offsetof('card_location', 'num_cards'),
+                ffi.offsetof('engine_action', 'card_amt')],
+    'itemsize': ffi.sizeof('engine_action')})
+
+# Layout of card_location, for viewing arrays of hands
+HAND_DTYPE = np.dtype({
+    'names': ['card_counts'],
+    'formats': ['<u8'],
+    'offsets': [ffi.offsetof('card_location', 'card_counts')],
+    'itemsize': ffi.sizeof('card_location')})
+
+Observation = namedtuple('Observation', [
+    'seats', 'hands', 'offer_levels', 'own_levels', 'errors', 'rewards',
+    'dones'])
+Observation.__doc__ = """What every game of a Batch looks like after a step
+
+seats, offer_levels, own_levels, errors and dones have one element per
+game, hands has one row of card counts per game and rewards one row of
+points per seat of each game. Only hands is a copy, the rest are views
+of arrays that are overwritten by the next step.
+"""
+
+
+def unpack_hands(packed):
+    """Return the card counts of packed_hand words
+
+    The counts of a word are a row of NUM_CARD_TYPES uint8 values, so
+    the result has shape packed.shape + (NUM_CARD_TYPES,).
+    """
+    packed = np.asarray(packed, dtype='<u8')
+    words = np.ascontiguousarray(packed.reshape(-1))
+    nibbles = words.view(np.uint8).reshape(-1, 8)
+    counts = np.stack((nibbles & 0xF, nibbles >> 4), axis=-1)
+
+    return counts.reshape(packed.shape + (16,))[..., :NUM_CARD_TYPES]
+
+
+def pack_hands(counts):
+    """Return packed_hand words holding rows of card counts"""
+    counts = np.asarray(counts, dtype=np.uint64)
+    shifts = np.arange(NUM_CARD_TYPES, dtype=np.uint64) * np.uint64(4)
+
+    return np.bitwise_or.reduce(counts << shifts, axis=-1)
+
+
+def levels_to_sizes(levels):
+    """Return the offer sizes marked in a mask of book levels"""
+    return [i + lib.OFFER_INDEX_OFFSET for i in range(32)
+            if levels & (1 << i)]
+
+
+def error_message(err):
+    """Return a description of the error code of a failed action"""
+    if err == lib.CMD_SUCCESS:
+        return None
+
+    return ffi.string(lib.error_what[err - lib.EJSON - 1]).decode()
+
+
+def _view(ptr, count, dtype):
+    """Return a NumPy array sharing memory with a C array"""
+    dtype = np.dtype(dtype)
+    return np.frombuffer(ffi.buffer(ptr, count * dtype.itemsize),
+                         dtype=dtype)
+
+
+class Game():
+    """A single game played one turn at a time, without any server"""
+    def __init__(self, num_players=4, has_billionaire=True,
+                 has_taxman=True, seed=0, stream=0):
+        self._engine = ffi.gc(lib.engine_new(num_players, has_billionaire,
+                                             has_taxman, seed, stream),
+                              lib.free_engine)
+        self._action = ffi.new('engine_action*')
+
+        self.num_players = num_players
+        self.scores = _view(self._engine.scores, num_players, np.intc)
+        self._hands = _view(self._engine.hands, num_players, HAND_DTYPE)
+
+    @property
+    def running(self):
+        return bool(self._engine.running)
+
+    @property
+    def seat(self):
+        """The seat whose turn it is"""
+        return self._engine.next_seat
+
+    @property
+    def hands(self):
+        """Card counts of every seat, one row per seat"""
+        return unpack_hands(self._hands['card_counts'])
+
+    def hand(self, seat):
+        """Card counts of one seat"""
+        return unpack_hands(self._hands['card_counts'][seat])
+
+    @property
+    def offers(self):
+        """Masks of the book levels each seat has offers resting at"""
+        book = self._engine.current_trades
+        levels = np.zeros(self.num_players, dtype=np.uint32)
+
+        for i in range(book.num_owners):
+            levels[book.owners[i].owner_id] = book.owners[i].levels
+
+        return levels
+
+    @property
+    def num_turns(self):
+        return self._engine.num_turns
+
+    @property
+    def num_trades(self):
+        return self._engine.num_trades
+
+    @property
+    def num_rounds(self):
+        return self._engine.num_rounds
+
+    def start(self, seed=None, stream=0):
+        """Start a game, first reseeding the shuffles if seed is given"""
+        if seed is not None:
+            lib.seed_engine(self._engine, seed, stream)
+
+        lib.engine_start_game(self._engine)
+
+    def stop(self):
+        lib.engine_stop_game(self._engine)
+
+    def offer(self, cards):
+        """Offer cards for the seat whose turn it is
+
+        cards is either a dict of CardID to amount or a row of card
+        counts. Returns the error code of a failed offer, or 0.
+        """
+        if isinstance(cards, dict):
+            counts = np.zeros(NUM_CARD_TYPES, dtype=np.uint8)
+
+            for card_id, amt in cards.items():
+                counts[card_id.value if isinstance(card_id, CardID)
+                       else card_id] = amt
+
+        else:
+            counts = np.asarray(cards)
+
+        self._action.type = ACTION_OFFER
+        self._action.cards.card_counts = int(pack_hands(counts))
+        self._action.cards.num_cards = int(counts.sum())
+
+        return self._take_turn()
+
+    def cancel(self, card_amt):
+        """Take back the oldest offer of a size for the seat whose turn it
+        is. Returns the error code of a failed cancel, or 0.
+        """
+        self._action.type = ACTION_CANCEL
+        self._action.card_amt = card_amt
+
+        return self._take_turn()
+
+    def pass_turn(self):
+        self._action.type = ACTION_PASS
+
+        return self._take_turn()
+
+    def _take_turn(self):
+        lib.engine_take_turn(self._engine, self._action)
+
+        return self._engine.last_err
+
+
+class Batch():
+    """Many games advanced one turn each at a time, for training bots
+
+    Every game shuffles from its own stream of the seed, and is started
+    again as soon as it is won.
+    """
+    def __init__(self, num_games, num_players=4, has_billionaire=True,
+                 has_taxman=True, seed=0):
+        self._batch = ffi.gc(lib.batch_engine_new(num_games, num_players,
+                                                  has_billionaire,
+                                                  has_taxman, seed),
+                             lib.free_batch_engine)
+
+        self.num_games = num_games
+        self.num_players = num_players
+        self.actions = np.zeros(num_games, dtype=ACTION_DTYPE)
+        self._actions_ptr = ffi.cast('engine_action*',
+                                     ffi.from_buffer(self.actions))
+
+        num_hands = num_games * num_players
+        obs = self._batch.obs
+
+        self.scores = _view(self._batch.scores, num_hands,
+                            np.intc).reshape(num_games, num_players)
+        self._hands = _view(self._batch.hands, num_hands, HAND_DTYPE)
+        self._obs = Observation(
+            seats=_view(obs.seats, num_games, np.uint8),
+            hands=_view(obs.hands, num_games, '<u8'),
+            offer_levels=_view(obs.offer_levels, num_games, np.uint32),
+            own_levels=_view(obs.own_levels, num_games, np.uint32),
+            errors=_view(obs.errors, num_games, np.intc),
+            rewards=_view(obs.rewards, num_hands,
+                          np.intc).reshape(num_games, num_players),
+            dones=_view(obs.dones, num_games, np.bool_))
+
+    @property
+    def hands(self):
+        """Card counts of every seat of every game"""
+        counts = unpack_hands(self._hands['card_counts'])
+        return counts.reshape(self.num_games, self.num_players,
+                              NUM_CARD_TYPES)
+
+    @property
+    def num_rounds(self):
+        return self._batch.num_rounds
+
+    @property
+    def num_games_won(self):
+        return self._batch.num_games_won
+
+    def reset(self):
+        """Start every game again"""
+        lib.batch_engine_reset(self._batch)
+        return self.observe()
+
+    def observe(self):
+        return self._obs._replace(hands=unpack_hands(self._obs.hands))
+
+    def step(self, types, counts=None, card_amts=None):
+        """Take one action in every game for the seat whose turn it is
+
+        types holds ACTION_PASS, ACTION_OFFER or ACTION_CANCEL for each
+        game, counts the rows of card counts offered and card_amts the
+        sizes of offer cancelled. Returns the Observation of every game.
+        """
+        actions = self.actions
+        actions['type'] = types
+
+        if counts is None:
+            actions['cards'] = 0
+            actions['num_cards'] = 0
+
+        else:
+            counts = np.asarray(counts)
+            actions['cards'] = pack_hands(counts)
+            actions['num_cards'] = counts.sum(axis=-1)
+
+        actions['card_amt'] = 0 if card_amts is None else card_amts
+
+        lib.batch_engine_step(self._batch, self._actions_ptr)
+
+        return self.observe()
@@ -0,0 +1,295 @@
+#include "batch_engine.h"
+
+#include <err.h>
+#include <string.h>
+
+#include "command_error.h"
+
+/* Allocate a zeroed array, exiting if there is no memory for it */
+static void*
+alloc_array(size_t num_elems, size_t elem_size, const char* name)
+{
+  void* arr = calloc(num_elems, elem_size);
+
+  if (arr == NULL) {
+    err(1, "%s malloc failed", name);
+  }
+
+  return arr;
+}
+
+/* Shuffle the deck from its original order and deal it into every seat
+   of a game */
+static void
+deal_game(batch_engine* batch, size_t game)
+{
+  card_location* player_hands[MAX_PLAYERS];
+  card_location* hands = &batch->hands[game*batch->num_seats];
+
+  for (size_t seat = 0; seat < batch->num_seats; ++seat) {
+    player_hands[seat] = &hands[seat];
+  }
+
+  memcpy(batch->shuffled->cards, batch->deck->cards,
+         batch->deck->num_cards*sizeof(card_id));
+
+  shuffle_card_array(batch->shuffled, &batch->shufflers[game]);
+  deal_cards_to_hands(batch->num_seats, batch->shuffled, player_hands);
+
+  batch->num_passes[game] = 0;
+}
+
+/* Reset a game's scores and book and deal its first round */
+static void
+start_game(batch_engine* batch, size_t game)
+{
+  int* scores = &batch->scores[game*batch->num_seats];
+
+  clear_book(&batch->books[game]);
+
+  for (size_t seat = 0; seat < batch->num_seats; ++seat) {
+    scores[seat] = INITIAL_SCORE;
+  }
+
+  batch->next_seats[game] = 0;
+
+  deal_game(batch, game);
+}
+
+/* Score every hand of a game, then deal the next round, or start the
+   game again once a seat has reached WINNING_SCORE */
+static void
+end_round(batch_engine* batch, size_t game)
+{
+  size_t num_seats = batch->num_seats;
+  bool game_won = engine_score_round(&batch->books[game],
+                                     &batch->hands[game*num_seats],
+                                     &batch->scores[game*num_seats],
+                                     num_seats, batch->seat_hands,
+                                     &batch->obs.rewards[game*num_seats]);
+
+  batch->num_rounds++;
+
+  if (game_won) {
+    batch->obs.dones[game] = true;
+    batch->num_games_won++;
+    start_game(batch, game);
+    return;
+  }
+
+  deal_game(batch, game);
+}
+
+/* Put cards from a seat's hand on offer, ending the round if the offer
+   trades into a winning hand. Returns the reason the offer failed, or
+   0 */
+static int
+submit_offer(batch_engine* batch, size_t game, size_t seat,
+             const card_location* cards)
+{
+  engine_trade trade;
+  int offer_err = engine_apply_offer(&batch->books[game],
+                                     &batch->hands[game*batch->num_seats],
+                                     seat, cards, &trade);
+
+  if (offer_err == CMD_SUCCESS && (trade.seat_won || trade.other_seat_won)) {
+    end_round(batch, game);
+  }
+
+  return offer_err;
+}
+
+/* Take back a seat's oldest offer of a size. Returns the reason the
+   cancel failed, or 0 */
+static int
+submit_cancel(batch_engine* batch, size_t game, size_t seat, size_t card_amt)
+{
+  card_location returned;
+
+  return engine_apply_cancel(&batch->books[game],
+                             &batch->hands[game*batch->num_seats], seat,
+                             card_amt, &returned);
+}
+
+/* Fill in what the seat whose turn is next in a game can see */
+static void
+observe(batch_engine* batch, size_t game)
+{
+  const book* current_trades = &batch->books[game];
+  size_t seat = batch->next_seats[game];
+  uint32_t offer_levels = 0;
+  uint32_t own_levels = 0;
+
+  for (size_t i = 0; i < current_trades->num_owners; ++i) {
+    if (current_trades->owners[i].owner_id == seat) {
+      own_levels |= current_trades->owners[i].levels;
+    }
+    else {
+      offer_levels |= current_trades->owners[i].levels;
+    }
+  }
+
+  batch->obs.seats[game] = (uint8_t) seat;
+  batch->obs.hands[game] =
+    batch->hands[game*batch->num_seats + seat].card_counts;
+  batch->obs.offer_levels[game] = offer_levels;
+  batch->obs.own_levels[game] = own_levels;
+}
+
+batch_engine*
+batch_engine_new(size_t num_games, size_t num_seats, bool has_billionaire,
+                 bool has_taxman, uint64_t seed)
+{
+  if (num_seats < 2 || num_seats > MAX_PLAYERS) {
+    errx(1, "batch seat count must be between 2 and %d", MAX_PLAYERS);
+  }
+
+  batch_engine* new_batch = malloc(sizeof(batch_engine));
+
+  if (new_batch == NULL) {
+    err(1, "new_batch malloc failed");
+  }
+
+  size_t num_hands = num_games*num_seats;
+
+  new_batch->num_games = num_games;
+  new_batch->num_seats = num_seats;
+
+  new_batch->next_seats = alloc_array(num_games, sizeof(uint8_t),
+                                      "next_seats");
+  new_batch->num_passes = alloc_array(num_games, sizeof(uint8_t),
+                                      "num_passes");
+  new_batch->books = alloc_array(num_games, sizeof(book), "books");
+  new_batch->shufflers = alloc_array(num_games, sizeof(rng), "shufflers");
+  new_batch->hands = alloc_array(num_hands, sizeof(card_location), "hands");
+  new_batch->scores = alloc_array(num_hands, sizeof(int), "scores");
+
+  new_batch->obs.seats = alloc_array(num_games, sizeof(uint8_t), "obs.seats");
+  new_batch->obs.hands = alloc_array(num_games, sizeof(packed_hand),
+                                     "obs.hands");
+  new_batch->obs.offer_levels = alloc_array(num_games, sizeof(uint32_t),
+                                            "obs.offer_levels");
+  new_batch->obs.own_levels = alloc_array(num_games, sizeof(uint32_t),
+                                          "obs.own_levels");
+  new_batch->obs.errors = alloc_array(num_games, sizeof(int), "obs.errors");
+  new_batch->obs.rewards = alloc_array(num_hands, sizeof(int),
+                                       "obs.rewards");
+  new_batch->obs.dones = alloc_array(num_games, sizeof(bool), "obs.dones");
+
+  card_location* unordered_deck = generate_deck((int) num_seats,
+                                                has_billionaire, has_taxman);
+
+  new_batch->deck = flatten_card_location(unordered_deck);
+  new_batch->shuffled = card_array_new(new_batch->deck->num_cards);
+  new_batch->seat_hands = hand_matrix_new(num_seats);
+
+  free_card_location(unordered_deck);
+
+  for (size_t game = 0; game < num_games; ++game) {
+    book_init(&new_batch->books[game]);
+    rng_init(&new_batch->shufflers[game], seed, game);
+  }
+
+  new_batch->num_games_won = 0;
+  new_batch->num_rounds = 0;
+
+  batch_engine_reset(new_batch);
+
+  return new_batch;
+}
+
+void
+batch_engine_reset(batch_engine* batch)
+{
+  memset(batch->obs.rewards, 0,
+         batch->num_games*batch->num_seats*sizeof(int));
+  memset(batch->obs.errors, 0, batch->num_games*sizeof(int));
+  memset(batch->obs.dones, 0, batch->num_games*sizeof(bool));
+
+  for (size_t game = 0; game < batch->num_games; ++game) {
+    start_game(batch, game);
+    observe(batch, game);
+  }
+}
+
+const batch_obs*
+batch_engine_step(batch_engine* batch, const engine_action actions[])
+{
+  size_t num_seats = batch->num_seats;
+
+  memset(batch->obs.rewards, 0, batch->num_games*num_seats*sizeof(int));
+  memset(batch->obs.dones, 0, batch->num_games*sizeof(bool));
+
+  for (size_t game = 0; game < batch->num_games; ++game) {
+    const engine_action* action = &actions[game];
+    size_t seat = batch->next_seats[game];
+    int err = 0;
+
+    batch->next_seats[game] = (uint8_t) ((seat + 1) % num_seats);
+
+    switch (action->type) {
+      case ENGINE_NEW_OFFER:
+        batch->num_passes[game] = 0;
+        err = submit_offer(batch, game, seat, &action->cards);
+        break;
+
+      case ENGINE_CANCEL_OFFER:
+        batch->num_passes[game] = 0;
+        err = submit_cancel(batch, game, seat, action->card_amt);
+        break;
+
+      default:
+        /* Nobody is going to trade again this round */
+        if (++batch->num_passes[game] == num_seats) {
+          end_round(batch, game);
+        }
+        break;
+    }
+
+    batch->obs.errors[game] = err;
+
+    observe(batch, game);
+  }
+
+  return &batch->obs;
+}
+
+const card_location*
+get_batch_hand(const batch_engine* batch, size_t game, size_t seat)
+{
+  return &batch->hands[game*batch->num_seats + seat];
+}
+
+int
+get_batch_score(const batch_engine* batch, size_t game, size_t seat)
+{
+  return batch->scores[game*batch->num_seats + seat];
+}
+
+void
+free_batch_engine(batch_engine* batch)
+{
+  for (size_t game = 0; game < batch->num_games; ++game) {
+    free_book_offers(&batch->books[game]);
+  }
+
+  free(batch->next_seats);
+  free(batch->num_passes);
+  free(batch->books);
+  free(batch->shufflers);
+  free(batch->hands);
+  free(batch->scores);
+
+  free(batch->obs.seats);
+  free(batch->obs.hands);
+  free(batch->obs.offer_levels);
+  free(batch->obs.own_levels);
+  free(batch->obs.errors);
+  free(batch->obs.rewards);
+  free(batch->obs.dones);
+
+  free_card_array(batch->deck);
+  free_card_array(batch->shuffled);
+  free_hand_matrix(batch->seat_hands);
+  free(batch);
+}
@@ -1,304 +1,251 @@
 #include "billionaire.h"
 
 #include <stdio.h>
+#include <string.h>
 
-#include "book.h"
 #include "card_location.h"
 #include "client.h"
-#include "client_hash_table.h"
 #include "command.h"
 #include "command_error.h"
+#include "engine.h"
 #include "game_state.h"
+#include "room.h"
 #include "utils.h"
 
-void
-start_billionaire_game()
+/* Return the name a change to the book is given in BOOK_EVENT. */
+static const char*
+book_event_name(engine_book_event book_event)
 {
-  client* client_obj = NULL;
-
-  printf("Player limit of %d reached. Game starting...\n",
-         billionaire_game->player_limit);
-  billionaire_game->running = true;
-
-  card_location** player_hands;
+  switch (book_event) {
+    case ENGINE_BOOK_NEW_OFFER:
+      return Command.NEW_OFFER;
 
-  printf("Dealing cards...\n");
-  player_hands = deal_cards(billionaire_game->num_players,
-                            billionaire_game->deck);
+    case ENGINE_BOOK_CANCELLED_OFFER:
+      return Command.CANCELLED_OFFER;
 
-  size_t iplayer = 0;
-
-  /* Split the deck between all players, and send their hands through START */
-  TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-    json_object* start = command_start(player_hands[iplayer]);
-    client_obj->hand = player_hands[iplayer];
-
-    enqueue_command(client_obj, start);
-    iplayer++;
+    default:
+      return Command.SUCCESSFUL_TRADE;
   }
-
-  free(player_hands);
 }
 
-void
-stop_billionaire_game()
+/* Create a BOOK_EVENT command from a table's book event, naming each
+   participant by the ID of the client playing its seat. */
+static command*
+command_from_book_event(const room* this_room, const engine_event* event)
 {
-  client* client_obj = NULL;
-
-  printf("Player limit of %d no longer satisfied. Game stopping...\n",
-         billionaire_game->player_limit);
-  billionaire_game->running = false;
-
-  /* Clear current trade book of current trades */
-  clear_book(billionaire_game->current_trades);
+  uint32_t participants[MAX_PARTICIPANTS];
 
-  /* Send an END_GAME command to each remaining client */
-  TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-    json_object* end_game = command_end_game();
-    enqueue_command(client_obj, end_game);
+  for (size_t i = 0; i < event->num_participants; ++i) {
+    participants[i] = this_room->seat_ids[event->participants[i]];
   }
 
+  return command_book_event(book_event_name(event->book_event),
+                            event->card_amt, participants,
+                            event->num_participants);
 }
 
-void
-process_client_command(client* this_client, char json_str[], size_t str_size)
+/* Create the command a client is sent for an event of the table. */
+static command*
+command_from_event(const room* this_room, const engine_event* event)
 {
-  client* client_obj = NULL;
-  cmd_errno = CMD_SUCCESS;
+  cmd_result res = {.err = event->err};
 
-  json_object* cmd_array = parse_command_list_string(json_str, str_size);
+  switch (event->type) {
+    case ENGINE_START:
+      return command_start(&event->cards, event->score);
 
-  if (cmd_errno != CMD_SUCCESS) {
-    enqueue_command(this_client, command_error());
-  }
+    case ENGINE_SUCCESSFUL_TRADE:
+      return command_successful_trade(&event->cards,
+                                      this_room->seat_ids[event->seat]);
 
-  else {
-    JSON_ARRAY_FOREACH(cmd_obj, cmd_array) {
-      /* Check cmd_object has command field */
-      if (get_JSON_value(cmd_obj, "command") == NULL) {
-        cmd_errno = (int) EBADCMDOBJ;
-        enqueue_command(this_client, command_error());
-        continue;
-      }
+    case ENGINE_CANCELLED_OFFER:
+      return command_cancelled_offer(&event->cards);
 
-      if (command_is(cmd_obj, Command.NEW_OFFER)) {
-        printf("Received NEW_OFFER from %s\n", this_client->id);
+    case ENGINE_BOOK_EVENT:
+      return command_from_book_event(this_room, event);
 
-        /* Parse offer */
-        json_object* card_array = get_JSON_value(cmd_obj, "cards");
+    case ENGINE_BILLIONAIRE:
+      return command_billionaire(this_room->seat_ids[event->seat]);
 
-        if (cmd_errno != CMD_SUCCESS) {
-          enqueue_command(this_client, command_error());
-          continue;
-        }
+    case ENGINE_END_ROUND:
+      return command_end_round(event->score);
 
-        card_location* card_loc = card_location_from_JSON(card_array);
+    case ENGINE_END_GAME:
+      return command_end_game();
 
-        if (cmd_errno != CMD_SUCCESS) {
-          enqueue_command(this_client, command_error());
-          continue;
-        }
+    default:
+      return command_error(&res);
+  }
+}
 
-        /* Validate the offer */
-        validate_offer(card_loc, this_client->hand);
+/* Queue an event of the table for the client playing a seat. */
+static void
+send_seat_event(const engine* table, size_t seat, const engine_event* event,
+                void* data)
+{
+  room* this_room = (room*) data;
+  client* client_obj = this_room->seats[seat];
 
-        if (cmd_errno != CMD_SUCCESS) {
-          if (cmd_errno != ENOOFFER) {
-            /* Send CANCELLED_OFFER back to this_client */
-            offer* bad_offer = offer_init(card_loc, this_client->id);
+  (void) table;
 
-            json_object* cancel = command_cancelled_offer(bad_offer);
-            enqueue_command(this_client, cancel);
+  /* A client that has left is sent nothing more */
+  if (client_obj == NULL) {
+    return;
+  }
 
-            free_offer(bad_offer);
-          }
+  enqueue_command(client_obj, command_from_event(this_room, event));
+}
 
-          enqueue_command(this_client, command_error());
-          continue;
-        }
+/* Queue an event sent to the whole table for every client in the room
+   but those playing the excluded seats, encoding it only once. */
+static void
+broadcast_table_event(const engine* table, const engine_event* event,
+                      const size_t excluded[], size_t num_excluded,
+                      void* data)
+{
+  room* this_room = (room*) data;
+  client* excluded_clients[MAX_PARTICIPANTS] = {NULL};
 
-        size_t total_cards = get_total_cards(card_loc);
+  (void) table;
 
-        printf("Offer of %zu cards\n", total_cards);
+  for (size_t i = 0; i < num_excluded; ++i) {
+    excluded_clients[i] = this_room->seats[excluded[i]];
+  }
 
-#ifdef DBUG
-        for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
-          size_t card_amt = get_card_amount(card_loc, card);
+  broadcast_command(&this_room->clients, command_from_event(this_room, event),
+                    excluded_clients);
+}
 
-          if (card_amt == 0) {
-            continue;
-          }
+/* Translate a command object sent by a client into the action it asks
+   the table for. Sets res to EBADCMDOBJ, EBADCMDNAME or the reason the
+   command's fields could not be read. */
+static void
+read_action(const client* this_client, json_object* cmd_obj,
+            engine_action* action, cmd_result* res)
+{
+  size_t name_len = 0;
+  const char* cmd_name = get_command_name(cmd_obj, &name_len, res);
 
-          printf("  %zux of card %d\n", card_amt, card);
-        }
-#endif /* DBUG */
+  /* Check cmd_object has command field */
+  if (cmd_failed(res)) {
+    res->err = (int) EBADCMDOBJ;
+    return;
+  }
 
-        /* Add offer to book */
-        offer* new_offer = offer_init(card_loc, this_client->id);
-        offer* traded_offer = fill_offer(billionaire_game->current_trades,
-                                         new_offer);
+  printf("Received %s from " CLIENT_ID_FMT "\n", cmd_name, this_client->id);
 
-        if (cmd_errno != CMD_SUCCESS) {
-          /* Send CANCELLED_OFFER back to this_client */
-          json_object* cancel = command_cancelled_offer(new_offer);
-          enqueue_command(this_client, cancel);
+  if (strcmp(cmd_name, Command.NEW_OFFER) == 0) {
+    json_object* card_array = get_JSON_value(cmd_obj, "cards", res);
 
-          free_offer(new_offer);
+    if (cmd_failed(res)) {
+      return;
+    }
 
-          enqueue_command(this_client, command_error());
-          continue;
-        }
+    action->type = ENGINE_NEW_OFFER;
+    read_card_location_JSON(&action->cards, card_array, res);
+  }
 
-        /* Update this_client's hand */
-        subtract_card_location(this_client->hand, new_offer->cards);
+  else if (strcmp(cmd_name, Command.CANCEL_OFFER) == 0) {
+    json_object* card_amt_json = get_JSON_value(cmd_obj, "card_amt", res);
 
-        if (cmd_errno != CMD_SUCCESS) {
-          enqueue_command(this_client, command_error());
-          /* TODO: send offer back? */
-          free_offer(new_offer);
-          continue;
-        }
+    if (cmd_failed(res)) {
+      return;
+    }
 
-        /* Check if an offer has traded */
-        if (traded_offer != NULL) {
-          client* other_client = get_client(hashed_clients, traded_offer->owner_id);
+    action->type = ENGINE_CANCEL_OFFER;
+    action->card_amt = (size_t) json_object_get_int(card_amt_json);
+  }
 
-          /* Update participants' hands */
-          merge_card_location(this_client->hand, traded_offer->cards);
-          merge_card_location(other_client->hand, new_offer->cards);
+  else {
+    /* Invalid command name */
+    res->err = (int) EBADCMDNAME;
+  }
+}
+
+void
+start_billionaire_game(room* this_room)
+{
+  game_state* billionaire_game = this_room->game;
+  client* client_obj = NULL;
+  size_t seat = 0;
+
+  engine_agent agent = {
+    .act = NULL,
+    .on_event = send_seat_event,
+    .data = this_room
+  };
+  engine_broadcaster broadcaster = {
+    .on_broadcast = broadcast_table_event,
+    .data = this_room
+  };
+
+  printf("Room %zu: player limit of %d reached. Game starting...\n",
+         this_room->id, billionaire_game->player_limit);
+
+  /* Seat each client at the table in the order they joined */
+  TAILQ_FOREACH(client_obj, &this_room->clients, entries) {
+    client_obj->seat = seat;
+    this_room->seats[seat] = client_obj;
+    this_room->seat_ids[seat] = client_obj->id;
+
+    set_engine_agent(billionaire_game->table, seat++, &agent);
+  }
 
-          /* Send SUCCESSFUL_TRADE commands to participants */
-          json_object* this_trade = command_successful_trade(traded_offer);
-          json_object* other_trade = command_successful_trade(new_offer);
+  set_engine_broadcaster(billionaire_game->table, &broadcaster);
 
-          free_offer(new_offer);
-          free_offer(traded_offer);
+  /* Deals the first round, sending each player their hand through
+     START */
+  engine_start_game(billionaire_game->table);
+}
 
-          enqueue_command(this_client, this_trade);
-          enqueue_command(other_client, other_trade);
+void
+stop_billionaire_game(room* this_room)
+{
+  game_state* billionaire_game = this_room->game;
 
-          /* Send BOOK_EVENT to remaining players */
-          const char* participants[MAX_PARTICIPANTS] = {this_client->id, other_client->id};
+  printf("Room %zu: player limit of %d no longer satisfied. Game stopping...\n",
+         this_room->id, billionaire_game->player_limit);
 
-          /* Check for win conditions */
-          bool this_client_has_won = has_won(this_client->hand);
-          bool other_client_has_won = has_won(other_client->hand);
+  /* Clears the book and sends an END_GAME command to each remaining
+     client */
+  engine_stop_game(billionaire_game->table);
+}
 
-          TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-            if (this_client_has_won) {
-              enqueue_command(client_obj, command_billionaire(this_client->id));
-            }
+void
+process_client_command(room* this_room, client* this_client,
+                       json_object* packet, cmd_result* res)
+{
+  game_state* billionaire_game = this_room->game;
 
-            if (other_client_has_won) {
-              enqueue_command(client_obj, command_billionaire(other_client->id));
-            }
+  json_object* cmd_array = parse_command_list(packet, res);
 
-            if (client_eq(client_obj, this_client) ||
-                client_eq(client_obj, other_client)) {
-              continue;
-            }
+  if (cmd_failed(res)) {
+    enqueue_command(this_client, command_error(res));
+  }
 
-            json_object* book_event = command_book_event(Command.SUCCESSFUL_TRADE,
-                                                         total_cards,
-                                                         participants);
+  else {
+    JSON_ARRAY_FOREACH(cmd_obj, cmd_array) {
+      engine_action action = {.type = ENGINE_PASS, .card_amt = 0};
 
-            enqueue_command(client_obj, book_event);
-          }
+      read_action(this_client, cmd_obj, &action, res);
 
-          /* TODO: Reset the round */
-          if (this_client_has_won || other_client_has_won) {
-            /* Update each client's score */
-            printf("Updating scores...\n");
-            TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-              update_score(client_obj);
-#ifdef DBUG
-              printf("%s's score is now %d\n",
-                     client_obj->id, client_obj->score);
-#endif /* DBUG */
-              enqueue_command(client_obj,
-                              command_end_round(client_obj->score));
-            }
-
-            printf("Clearing book...\n");
-            clear_book(billionaire_game->current_trades);
-          }
-        }
-
-        else {
-          printf("Offer added to book\n");
-
-          /* Send BOOK_EVENT to remaining players */
-          const char* participants[MAX_PARTICIPANTS] = {this_client->id, NULL};
-
-          TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-            if (client_eq(client_obj, this_client)) {
-              continue;
-            }
-
-            json_object* book_event = command_book_event(Command.NEW_OFFER,
-                                                         total_cards,
-                                                         participants);
-
-            enqueue_command(client_obj, book_event);
-          }
-        }
-      } /* Command.NEW_OFFER */
-
-      else if (command_is(cmd_obj, Command.CANCEL_OFFER)) {
-        printf("Received CANCEL_OFFER from %s\n", this_client->id);
-
-        /* Parse offer */
-        json_object* card_amt_json = get_JSON_value(cmd_obj, "card_amt");
-
-        if (cmd_errno != CMD_SUCCESS) {
-          enqueue_command(this_client, command_error());
-          continue;
-        }
-
-        size_t card_amt = (size_t) json_object_get_int(card_amt_json);
-
-        offer* cancelled_offer = cancel_offer(billionaire_game->current_trades,
-                                              card_amt, this_client->id);
-
-        if (cmd_errno != CMD_SUCCESS) {
-          enqueue_command(this_client, command_error());
-          continue;
-        }
-
-        /* Offer has been successfully cancelled */
-        json_object* cancel = command_cancelled_offer(cancelled_offer);
-        enqueue_command(this_client, cancel);
-
-        merge_card_location(this_client->hand, cancelled_offer->cards);
-
-        /* Send BOOK_EVENT to remaining players */
-        const char* participants[MAX_PARTICIPANTS] = {this_client->id, NULL};
-
-        TAILQ_FOREACH(client_obj, &client_tailq_head, entries) {
-          if (client_eq(client_obj, this_client)) {
-            continue;
-          }
-
-          json_object* book_event = command_book_event(Command.CANCELLED_OFFER,
-                                                           card_amt,
-                                                           participants);
-
-          enqueue_command(client_obj, book_event);
-        }
-      } /* Command.CANCEL_OFFER */
-
-      else {
-        /* Invalid command name */
-        cmd_errno = (int) EBADCMDNAME;
-        enqueue_command(this_client, command_error());
+      if (cmd_failed(res)) {
+        enqueue_command(this_client, command_error(res));
         continue;
       }
+
+      /* The table tells every client what came of the action */
+      engine_submit(billionaire_game->table, this_client->seat, &action);
+
+      /* Nothing more can be played once the game is over, and the room
+         waits for its players to be replaced */
+      if (!is_running(billionaire_game)) {
+        update_room(this_room);
+        break;
+      }
     }
   }
 
   /* Free cmd_array after use */
   json_object_put(cmd_array);
-
-  /* Send any outstanding commands to clients */
-  send_commands_to_clients(&client_tailq_head);
 }
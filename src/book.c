@@ -6,6 +6,53 @@
 
 #include "command_error.h"
 
+/* Return the index of an owner in the book, or num_owners if the owner
+   has no offers in the book. */
+static size_t
+find_owner(const book* book_obj, uint32_t owner_id)
+{
+  size_t i = 0;
+
+  while (i < book_obj->num_owners && book_obj->owners[i].owner_id != owner_id) {
+    ++i;
+  }
+
+  return i;
+}
+
+/* Record that an owner now has offers at an index. */
+static void
+add_owner_level(book* book_obj, uint32_t owner_id, int offer_ind)
+{
+  size_t i = find_owner(book_obj, owner_id);
+
+  if (i == book_obj->num_owners) {
+    book_obj->owners[i].owner_id = owner_id;
+    book_obj->owners[i].levels = 0;
+    book_obj->num_owners++;
+  }
+
+  book_obj->owners[i].levels |= UINT32_C(1) << offer_ind;
+}
+
+/* Record that an owner no longer has offers at an index. */
+static void
+remove_owner_level(book* book_obj, uint32_t owner_id, int offer_ind)
+{
+  size_t i = find_owner(book_obj, owner_id);
+
+  if (i == book_obj->num_owners) {
+    return;
+  }
+
+  book_obj->owners[i].levels &= ~(UINT32_C(1) << offer_ind);
+
+  /* Owners without offers are not kept, so the last owner fills the gap */
+  if (book_obj->owners[i].levels == 0) {
+    book_obj->owners[i] = book_obj->owners[--book_obj->num_owners];
+  }
+}
+
 book*
 book_new()
 {
@@ -15,17 +62,30 @@ book_new()
     err(1, "new_book malloc failed");
   }
 
-  for (int i = 0; i < (TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET; ++i) {
-    new_book->offers[i] = NULL;
-  }
+  book_init(new_book);
 
   return new_book;
 }
 
+void
+book_init(book* book_obj)
+{
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
+    book_obj->levels[i].head = NULL;
+    book_obj->levels[i].tail = NULL;
+    book_obj->levels[i].length = 0;
+  }
+
+  book_obj->num_owners = 0;
+
+  book_obj->offer_pool = slab_new(sizeof(offer), OFFER_SLAB_CHUNK);
+  slab_reserve(book_obj->offer_pool, OFFER_SLAB_CHUNK);
+}
+
 bool
 offer_at(book* book_obj, int offer_ind)
 {
-  return book_obj->offers[offer_ind] != NULL;
+  return book_obj->levels[offer_ind].head != NULL;
 }
 
 bool
@@ -34,56 +94,111 @@ no_offer_at(book* book_obj, int offer_ind)
   return !offer_at(book_obj, offer_ind);
 }
 
+size_t
+get_num_offers_at(book* book_obj, int offer_ind)
+{
+  return book_obj->levels[offer_ind].length;
+}
+
 void
-set_offer_at(book* book_obj, int offer_ind, offer* offer_obj)
+push_offer_at(book* book_obj, int offer_ind, offer* offer_obj)
 {
-  book_obj->offers[offer_ind] = offer_obj;
+  offer_queue* queue = &book_obj->levels[offer_ind];
+
+  offer_obj->prev = queue->tail;
+  offer_obj->next = NULL;
+
+  if (queue->tail != NULL) {
+    queue->tail->next = offer_obj;
+  }
+  else {
+    queue->head = offer_obj;
+    add_owner_level(book_obj, offer_obj->owner_id, offer_ind);
+  }
+
+  queue->tail = offer_obj;
+  queue->length++;
 }
 
 offer*
 get_offer_at(book* book_obj, int offer_ind)
 {
-  return book_obj->offers[offer_ind];
+  return book_obj->levels[offer_ind].head;
 }
 
-void
+offer*
 remove_offer_at(book* book_obj, int offer_ind)
 {
-  set_offer_at(book_obj, offer_ind, NULL);
+  offer* offer_obj = get_offer_at(book_obj, offer_ind);
+
+  if (offer_obj != NULL) {
+    withdraw_offer(book_obj, offer_obj);
+  }
+
+  return offer_obj;
 }
 
-offer*
-fill_offer(book* book_obj, offer* offer_obj)
+void
+withdraw_offer(book* book_obj, offer* offer_obj)
 {
   int offer_ind = get_offer_index(offer_obj);
+  offer_queue* queue = &book_obj->levels[offer_ind];
 
-  if (no_offer_at(book_obj, offer_ind)) {
-    set_offer_at(book_obj, offer_ind, offer_obj);
-    return NULL;
+  if (offer_obj->prev != NULL) {
+    offer_obj->prev->next = offer_obj->next;
+  }
+  else {
+    queue->head = offer_obj->next;
   }
 
+  if (offer_obj->next != NULL) {
+    offer_obj->next->prev = offer_obj->prev;
+  }
   else {
-    /* Return the offer object ready to trade to the parent method */
-    offer* return_offer = get_offer_at(book_obj, offer_ind);
+    queue->tail = offer_obj->prev;
+  }
 
-    if (have_same_owner(return_offer, offer_obj)) {
-      cmd_errno = (int) EOFFEROVER;
-      return NULL;
-    }
+  offer_obj->prev = NULL;
+  offer_obj->next = NULL;
+  queue->length--;
 
-    remove_offer_at(book_obj, offer_ind);
-    return return_offer;
+  if (queue->head == NULL) {
+    remove_owner_level(book_obj, offer_obj->owner_id, offer_ind);
   }
 }
 
 offer*
-cancel_offer(book* book_obj, size_t card_amt, const char* client_id)
+fill_offer(book* book_obj, offer* offer_obj)
+{
+  int offer_ind = get_offer_index(offer_obj);
+  offer* resting_offer = get_offer_at(book_obj, offer_ind);
+
+  /* Every resting offer has the same owner, so either the oldest one
+     trades or the new offer joins the back of the queue */
+  if (resting_offer == NULL || have_same_owner(resting_offer, offer_obj)) {
+    push_offer_at(book_obj, offer_ind, offer_obj);
+    return NULL;
+  }
+
+  /* Return the offer object ready to trade to the parent method */
+  return remove_offer_at(book_obj, offer_ind);
+}
+
+offer*
+cancel_offer(book* book_obj, size_t card_amt, uint32_t client_id,
+             cmd_result* res)
 {
   int offer_ind = offset_index(card_amt);
 
+  /* No offer of that size can exist in the book */
+  if (card_amt < OFFER_MIN_CARDS || card_amt > OFFER_MAX_CARDS) {
+    res->err = (int) ECANEMPTY;
+    return NULL;
+  }
+
   if (no_offer_at(book_obj, offer_ind)) {
     /* No offer to cancel */
-    cmd_errno = (int) ECANEMPTY;
+    res->err = (int) ECANEMPTY;
     return NULL;
   }
 
@@ -91,38 +206,97 @@ cancel_offer(book* book_obj, size_t card_amt, const char* client_id)
     offer* offer_to_cancel = get_offer_at(book_obj, offer_ind);
 
     if (is_owner(offer_to_cancel, client_id)) {
-      remove_offer_at(book_obj, offer_ind);
-      return offer_to_cancel;
+      return remove_offer_at(book_obj, offer_ind);
     }
 
     else {
       /* Client does not own offer to cancel */
-      cmd_errno = (int) ECANPERM;
+      res->err = (int) ECANPERM;
       return NULL;
     }
   }
 }
 
-void
-clear_book(book* book_obj)
+size_t
+cancel_owner_offers(book* book_obj, uint32_t client_id, card_location* hand)
 {
-  for (int i = 0; i < (TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET; ++i) {
-    if (offer_at(book_obj, i)) {
-      free_offer(book_obj->offers[i]);
-      book_obj->offers[i] = NULL;
+  size_t i = find_owner(book_obj, client_id);
+  size_t num_cancelled = 0;
+
+  if (i == book_obj->num_owners) {
+    return 0;
+  }
+
+  uint32_t levels = book_obj->owners[i].levels;
+
+  /* Every offer in each of the owner's queues belongs to the owner, so
+     the queues are emptied whole */
+  while (levels != 0) {
+    offer_queue* queue = &book_obj->levels[__builtin_ctz(levels)];
+    offer* offer_obj = queue->head;
+
+    while (offer_obj != NULL) {
+      offer* next_offer = offer_obj->next;
+
+      if (hand != NULL) {
+        merge_card_location(hand, &offer_obj->cards);
+      }
+
+      free_offer(book_obj, offer_obj);
+      num_cancelled++;
+
+      offer_obj = next_offer;
     }
+
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->length = 0;
+
+    levels &= levels - 1;
   }
+
+  book_obj->owners[i] = book_obj->owners[--book_obj->num_owners];
+
+  return num_cancelled;
+}
+
+uint32_t
+get_owner_levels(const book* book_obj, uint32_t client_id)
+{
+  size_t i = find_owner(book_obj, client_id);
+
+  if (i == book_obj->num_owners) {
+    return 0;
+  }
+
+  return book_obj->owners[i].levels;
 }
 
 void
-free_book(book* book_obj)
+clear_book(book* book_obj)
 {
-  for (int i = 0; i < (TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET; ++i) {
-    if (offer_at(book_obj, i)) {
-      free_offer(book_obj->offers[i]);
-    }
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
+    book_obj->levels[i].head = NULL;
+    book_obj->levels[i].tail = NULL;
+    book_obj->levels[i].length = 0;
   }
 
+  book_obj->num_owners = 0;
+
+  /* Release the offers in one go, rather than one at a time */
+  slab_reset(book_obj->offer_pool);
+}
+
+void
+free_book_offers(book* book_obj)
+{
+  free_slab(book_obj->offer_pool);
+}
+
+void
+free_book(book* book_obj)
+{
+  free_book_offers(book_obj);
   free(book_obj);
 }
 
@@ -134,54 +308,54 @@ JSON_from_offer(offer* offer_obj)
      object does not need to contain the owner_id field. */
   json_object* offer_json = json_object_new_object();
 
-  json_object* offer_cards_json = JSON_from_card_location(offer_obj->cards);
+  json_object* offer_cards_json = JSON_from_card_location(&offer_obj->cards);
   json_object_object_add(offer_json, "cards", offer_cards_json);
 
   return offer_json;
 }
 
 offer*
-offer_new()
+offer_new(book* book_obj)
 {
-  offer* new_offer = malloc(sizeof(offer));
+  offer* new_offer = slab_alloc(book_obj->offer_pool);
 
-  if (new_offer == NULL) {
-    err(1, "new_offer malloc failed");
-  }
-
-  strncpy(new_offer->owner_id, "", 2);
-  new_offer->cards = NULL;
+  new_offer->owner_id = 0;
+  new_offer->prev = NULL;
+  new_offer->next = NULL;
+  clear_card_location(&new_offer->cards);
 
   return new_offer;
 }
 
 offer*
-offer_init(card_location* cards, const char* owner_id)
+offer_init(book* book_obj, const card_location* cards, uint32_t owner_id)
 {
-  offer* offer_obj = offer_new();
+  offer* offer_obj = offer_new(book_obj);
 
-  /* Assume owner_id has length HASH_LENGTH, as it should come from utils.h */
-  strncpy(offer_obj->owner_id, owner_id, HASH_LENGTH);
+  offer_obj->owner_id = owner_id;
 
-  offer_obj->cards = cards;
+  offer_obj->cards = *cards;
 
   return offer_obj;
 }
 
 offer*
-offer_init_cards(card_id card, size_t amount, const char* owner_id)
+offer_init_cards(book* book_obj, card_id card, size_t amount,
+                 uint32_t owner_id)
 {
-  card_location* cards = card_location_new();
-  add_cards_to_location(cards, card, amount);
+  card_location cards;
+
+  clear_card_location(&cards);
+  add_cards_to_location(&cards, card, amount);
 
-  return offer_init(cards, owner_id);
+  return offer_init(book_obj, &cards, owner_id);
 }
 
 
 int
 get_offer_index(offer* offer_obj)
 {
-  size_t card_amt = get_total_cards(offer_obj->cards);
+  size_t card_amt = get_total_cards(&offer_obj->cards);
 
   return offset_index(card_amt);
 }
@@ -194,9 +368,9 @@ offset_index(size_t card_amt)
 }
 
 bool
-is_owner(offer* offer_obj, const char* prospective_owner_id)
+is_owner(offer* offer_obj, uint32_t prospective_owner_id)
 {
-  return strncmp(offer_obj->owner_id, prospective_owner_id, HASH_LENGTH) == 0;
+  return offer_obj->owner_id == prospective_owner_id;
 }
 
 bool
@@ -206,8 +380,7 @@ have_same_owner(offer* offer1, offer* offer2)
 }
 
 void
-free_offer(offer* offer_obj)
+free_offer(book* book_obj, offer* offer_obj)
 {
-  free_card_location(offer_obj->cards);
-  free(offer_obj);
+  slab_free(book_obj->offer_pool, offer_obj);
 }
@@ -51,12 +51,12 @@ flatten_card_location(card_location* card_loc)
 }
 
 void
-shuffle_card_array(card_array* card_arr)
+shuffle_card_array(card_array* card_arr, rng* rng_obj)
 {
   if (card_arr->num_cards > 1) {
     for (size_t i = 0; i < card_arr->num_cards - 1; ++i) {
-      size_t rnd = (size_t) rand();
-      size_t j = i + rnd/(RAND_MAX/(card_arr->num_cards - i) + 1);
+      size_t j = i + rng_bounded(rng_obj,
+                                 (uint32_t) (card_arr->num_cards - i));
 
       card_id tmp = card_arr->cards[j];
       card_arr->cards[j] = card_arr->cards[i];
@@ -78,20 +78,34 @@ deal_cards(size_t num_players, card_array* ordered_deck)
     player_hands[i] = card_location_new();
   }
 
-  /* Deal cards out */
-  for (size_t i = 0; i < ordered_deck->num_cards; ++i) {
-    /* Get the current player */
-    size_t iplayer = i % num_players;
+  deal_cards_to_hands(num_players, ordered_deck, player_hands);
+
+  return player_hands;
+}
+
+void
+deal_cards_to_hands(size_t num_players, const card_array* ordered_deck,
+                    card_location* player_hands[])
+{
+  /* Deal cards out, a player at a time. Each player gets every
+     num_players-th card, which are counted up before being written to
+     the player's hand in one go */
+  for (size_t iplayer = 0; iplayer < num_players; ++iplayer) {
+    packed_hand card_counts = 0;
+    size_t num_cards = 0;
+
+    for (size_t i = iplayer; i < ordered_deck->num_cards; i += num_players) {
+      card_counts += packed_card(ordered_deck->cards[i], 1);
+      num_cards++;
+    }
 
 #ifdef DBUG
-    printf("Player %zu, card %zu\n", iplayer, i);
+    printf("Player %zu, %zu cards\n", iplayer, num_cards);
 #endif /* DBUG */
 
-    /* Give a card from the deck to the current player */
-    add_card_to_location(player_hands[iplayer], ordered_deck->cards[i]);
+    player_hands[iplayer]->card_counts = card_counts;
+    player_hands[iplayer]->num_cards = (uint8_t) num_cards;
   }
-
-  return player_hands;
 }
 
 void
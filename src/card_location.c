@@ -3,6 +3,7 @@
 #include <err.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "command_error.h"
 #include "utils.h"
@@ -48,15 +49,45 @@ JSON_from_card_location(card_location* card_loc)
   return card_loc_json;
 }
 
-card_location*
-card_location_from_JSON(json_object* card_loc_json)
+size_t
+encode_card_location(char* dest, const card_location* card_loc)
 {
-  if (!json_object_is_type(card_loc_json, json_type_array)) {
-    cmd_errno = (int) EJSONTYPE;
-    return NULL;
+  size_t len = 0;
+
+  dest[len++] = '[';
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    size_t card_amt = get_card_amount(card_loc, card);
+
+    if (card_amt == 0) {
+      continue;
+    }
+
+    /* Separate cards objects after the first one */
+    if (len > 1) {
+      dest[len++] = ',';
+    }
+
+    len += (size_t) snprintf(dest + len, CARD_JSON_MAX_LEN,
+                             "{\"id\":%d,\"amt\":%d,\"val\":%d}",
+                             card, (int) card_amt, card_values[card]);
   }
 
-  card_location* card_loc = card_location_new();
+  dest[len++] = ']';
+
+  return len;
+}
+
+void
+read_card_location_JSON(card_location* card_loc, json_object* card_loc_json,
+                        cmd_result* res)
+{
+  clear_card_location(card_loc);
+
+  if (!json_object_is_type(card_loc_json, json_type_array)) {
+    res->err = (int) EJSONTYPE;
+    return;
+  }
 
   /* Iterate through each array item */
   size_t array_len = json_object_array_length(card_loc_json);
@@ -64,24 +95,43 @@ card_location_from_JSON(json_object* card_loc_json)
   for (size_t i = 0; i < array_len; ++i) {
     json_object* card_json = json_object_array_get_idx(card_loc_json, i);
 
-    json_object* card_id_json = get_JSON_value(card_json, "id");
+    json_object* card_id_json = get_JSON_value(card_json, "id", res);
+
+    if (cmd_failed(res)) {
+      return;
+    }
+
+    json_object* card_amt_json = get_JSON_value(card_json, "amt", res);
 
-    if (cmd_errno != CMD_SUCCESS) {
-      free_card_location(card_loc);
-      return NULL;
+    if (cmd_failed(res)) {
+      return;
     }
 
-    json_object* card_amt_json = get_JSON_value(card_json, "amt");
+    int card = json_object_get_int(card_id_json);
+    int card_amt = json_object_get_int(card_amt_json);
 
-    if (cmd_errno != CMD_SUCCESS) {
-      free_card_location(card_loc);
-      return NULL;
+    /* Client input must fit within the inline counts */
+    if (card < DIAMONDS || card >= TOTAL_UNIQUE_CARDS ||
+        card_amt < 0 ||
+        card_amt > CARD_MAX_AMOUNT - (int) get_card_amount(card_loc, card)) {
+      res->err = (int) EBADCARD;
+      return;
     }
 
-    card_id card = json_object_get_int(card_id_json);
-    size_t card_amt = (size_t) json_object_get_int(card_amt_json);
+    add_cards_to_location(card_loc, (card_id) card, (size_t) card_amt);
+  }
+}
+
+card_location*
+card_location_from_JSON(json_object* card_loc_json, cmd_result* res)
+{
+  card_location* card_loc = card_location_new();
+
+  read_card_location_JSON(card_loc, card_loc_json, res);
 
-    add_cards_to_location(card_loc, card, card_amt);
+  if (cmd_failed(res)) {
+    free_card_location(card_loc);
+    return NULL;
   }
 
   return card_loc;
@@ -96,15 +146,7 @@ card_location_new()
     err(1, "new_card_location malloc failed");
   }
 
-  /* Create array used to count the number of cards, initialised to zero */
-  new_card_location->card_counts = calloc(TOTAL_UNIQUE_CARDS, sizeof(size_t));
-
-  if (new_card_location->card_counts == NULL) {
-    err(1, "new_card_location->card_counts malloc failed");
-  }
-
-  /* Initialise other fields */
-  new_card_location->num_cards = 0;
+  clear_card_location(new_card_location);
 
   return new_card_location;
 }
@@ -164,19 +206,20 @@ add_card_to_location(card_location* card_loc, card_id card)
 void
 add_cards_to_location(card_location* card_loc, card_id card, size_t amount)
 {
-  card_loc->num_cards += amount;
-  card_loc->card_counts[card] += amount;
+  card_loc->num_cards += (uint8_t) amount;
+  card_loc->card_counts += packed_card(card, amount);
 }
 
 void
-remove_cards_from_location(card_location* card_loc, card_id card, size_t amount)
+remove_cards_from_location(card_location* card_loc, card_id card,
+                           size_t amount, cmd_result* res)
 {
   if (has_enough_cards(card_loc, card, amount)) {
-    card_loc->num_cards -= amount;
-    card_loc->card_counts[card] -= amount;
+    card_loc->num_cards -= (uint8_t) amount;
+    card_loc->card_counts -= packed_card(card, amount);
   }
   else {
-    cmd_errno = (int) ECARDRM;
+    res->err = (int) ECARDRM;
     return;
   }
 }
@@ -184,113 +227,103 @@ remove_cards_from_location(card_location* card_loc, card_id card, size_t amount)
 void
 merge_card_location(card_location* dest_loc, const card_location* src_loc)
 {
-  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
-    size_t card_amt = get_card_amount(src_loc, card);
-
-    add_cards_to_location(dest_loc, card, card_amt);
-  }
+  dest_loc->card_counts = packed_add(dest_loc->card_counts,
+                                     src_loc->card_counts);
+  dest_loc->num_cards += src_loc->num_cards;
 }
 
 void
-subtract_card_location(card_location* dest_loc, const card_location* src_loc)
+subtract_card_location(card_location* dest_loc, const card_location* src_loc,
+                       cmd_result* res)
 {
-  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
-    size_t card_amt = get_card_amount(src_loc, card);
-
-    remove_cards_from_location(dest_loc, card, card_amt);
-
-    if (cmd_errno != CMD_SUCCESS) {
-      return;
-    }
+  if (!packed_subtract(&dest_loc->card_counts, src_loc->card_counts)) {
+    res->err = (int) ECARDRM;
+    return;
   }
+
+  dest_loc->num_cards -= src_loc->num_cards;
 }
 
 void
-validate_offer(card_location* offer, const card_location* hand)
+validate_offer(const card_location* offer, const card_location* hand,
+               cmd_result* res)
 {
   size_t total_offer_size = get_total_cards(offer);
 
   /* Check if any cards were traded */
   if (total_offer_size == 0) {
-    cmd_errno = (int) ENOOFFER;
-    free_card_location(offer);
+    res->err = (int) ENOOFFER;
     return;
   }
 
   /* Check if enough cards were traded */
   else if (total_offer_size < OFFER_MIN_CARDS) {
-    cmd_errno = (int) ESMALLOFFER;
-    /* Offer not freed as it needs to be sent back */
+    res->err = (int) ESMALLOFFER;
     return;
   }
 
-  /* Individual card type checking */
-  size_t num_commodities = 0, num_wildcards = 0;
+  /* Check the offer is small enough to fit in the book */
+  else if (total_offer_size > OFFER_MAX_CARDS) {
+    res->err = (int) ELARGEOFFER;
+    return;
+  }
 
-  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
-    size_t card_amt = get_card_amount(offer, card);
-
-    if (card_amt > 0) {
-      /* Check offer is a subset of the hand */
-      if (!has_enough_cards(hand, card, card_amt)) {
-        cmd_errno = (int) EHANDSUBSET;
-        /* Offer not freed as it needs to be sent back */
-        return;
-      }
-
-      /* Card type is commodity */
-      if (card < TOTAL_COMMODITY_AMOUNT) {
-        num_commodities++;
-
-        /* Check offer contains <= OFFER_MAX_UNIQ_COMMS unique commodities */
-        if (num_commodities > OFFER_MAX_UNIQ_COMMS) {
-          cmd_errno = (int) EUNIQCOMMS;
-          /* Offer not freed as it needs to be sent back */
-          return;
-        }
-      }
-      /* Card type is wildcard */
-      else {
-        num_wildcards++;
-
-        /* Check offer contains <= OFFER_MAX_UNIQ_WILDS unique wildcards */
-        if (num_wildcards > OFFER_MAX_UNIQ_WILDS) {
-          cmd_errno = (int) EUNIQWILDS;
-          /* Offer not freed as it needs to be sent back */
-          return;
-        }
-      }
-    }
+  packed_hand offer_counts = offer->card_counts;
+
+  /* Each check is done for every card type at once, and the error found
+   * at the lowest card type is reported. Bit 4i of each mask marks a
+   * failure at card type i. */
+  uint64_t not_subset = packed_borrows(hand->card_counts, offer_counts) >> 3;
+
+  /* Mark the (OFFER_MAX_UNIQ_COMMS + 1)th commodity or wildcard type of
+   * the offer */
+  uint64_t commodities = packed_nonzero(offer_counts) & PACKED_COMMODITY_BITS;
+  uint64_t wildcards = packed_nonzero(offer_counts) & PACKED_WILDCARD_BITS;
+
+  for (size_t i = 0; i < OFFER_MAX_UNIQ_COMMS; ++i) {
+    commodities &= commodities - 1;
+  }
+
+  for (size_t i = 0; i < OFFER_MAX_UNIQ_WILDS; ++i) {
+    wildcards &= wildcards - 1;
+  }
+
+  uint64_t failures = not_subset | commodities | wildcards;
+
+  if (failures == 0) {
+    return;
+  }
+
+  uint64_t first_failure = failures & -failures;
+
+  /* Check offer is a subset of the hand */
+  if (not_subset & first_failure) {
+    res->err = (int) EHANDSUBSET;
+  }
+
+  /* Check offer contains <= OFFER_MAX_UNIQ_COMMS unique commodities */
+  else if (commodities & first_failure) {
+    res->err = (int) EUNIQCOMMS;
+  }
+
+  /* Check offer contains <= OFFER_MAX_UNIQ_WILDS unique wildcards */
+  else {
+    res->err = (int) EUNIQWILDS;
   }
 }
 
 bool
 has_won(const card_location* hand)
 {
-  /* Check for wildcards */
-  size_t num_wildcards = 0;
-  num_wildcards += get_card_amount(hand, BILLIONAIRE);
-  num_wildcards += get_card_amount(hand, TAX_COLLECTOR);
-
   /* Check win condition */
-  for (card_id comm_card = DIAMONDS; comm_card < TOTAL_COMMODITY_AMOUNT; ++comm_card) {
-    size_t comm_amt = get_card_amount(hand, comm_card);
-
-    if ((comm_amt + num_wildcards) >= (TOTAL_COMMODITY_AMOUNT + 1)) {
-      return true;
-    }
-  }
-
-  return false;
+  return packed_winning_commodities(hand->card_counts,
+                                    TOTAL_COMMODITY_AMOUNT + 1) != 0;
 }
 
 int
 evaluate_hand_score(const card_location* hand)
 {
   int score = 0;
-  size_t num_wildcards = 0;
-  num_wildcards += get_card_amount(hand, BILLIONAIRE);
-  num_wildcards += get_card_amount(hand, TAX_COLLECTOR);
 
   /* Subtract points if hand contains TAX_COLLECTOR */
   if (get_card_amount(hand, TAX_COLLECTOR) > 0) {
@@ -298,12 +331,12 @@ evaluate_hand_score(const card_location* hand)
   }
 
   /* Add total for winning commodity type */
-  for (card_id comm_card = DIAMONDS; comm_card < TOTAL_COMMODITY_AMOUNT; ++comm_card) {
-    size_t comm_amt = get_card_amount(hand, comm_card);
+  unsigned winning = packed_winning_commodities(hand->card_counts,
+                                                TOTAL_COMMODITY_AMOUNT + 1);
 
-    if ((comm_amt + num_wildcards) >= (TOTAL_COMMODITY_AMOUNT + 1)) {
-      score += card_values[comm_card];
-    }
+  while (winning != 0) {
+    score += card_values[__builtin_ctz(winning)];
+    winning &= winning - 1;
   }
 
   /* Double total if hand contains BILLIONAIRE */
@@ -317,7 +350,7 @@ evaluate_hand_score(const card_location* hand)
 size_t
 get_card_amount(const card_location* card_loc, card_id card)
 {
-  return card_loc->card_counts[card];
+  return packed_get(card_loc->card_counts, card);
 }
 
 size_t
@@ -337,16 +370,11 @@ has_enough_cards(const card_location* card_loc, card_id card, size_t amount)
 void
 clear_card_location(card_location* card_loc)
 {
-  card_loc->num_cards = 0;
-
-  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
-    card_loc->card_counts[card] = 0;
-  }
+  memset(card_loc, 0, sizeof(card_location));
 }
 
 void
 free_card_location(card_location* card_loc)
 {
-  free(card_loc->card_counts);
   free(card_loc);
 }
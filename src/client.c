@@ -11,7 +11,7 @@
 #include "utils.h"
 
 client*
-client_new(struct event_base* evbase, int fd,
+client_new(struct event_base* evbase, int fd, framing mode,
            bufferevent_data_cb readcb, bufferevent_event_cb eventcb)
 {
   client* new_client = malloc(sizeof(client));
@@ -22,9 +22,11 @@ client_new(struct event_base* evbase, int fd,
 
   new_client->fd = fd;
 
-  new_client->hand = NULL;
+  new_client->seat = 0;
 
-  new_client->score = 0;
+  new_client->room = NULL;
+
+  new_client->id = 0;
 
   new_client->buf_ev = bufferevent_socket_new(evbase, new_client->fd, 0);
 
@@ -32,30 +34,59 @@ client_new(struct event_base* evbase, int fd,
   bufferevent_setcb(new_client->buf_ev, readcb, NULL,
                     eventcb, new_client);
 
+  /* Initialise frame reassembly */
+  frame_reader_init(&new_client->reader, mode);
+
   /* Enable bufferevent so callbacks will be called */
   bufferevent_enable(new_client->buf_ev, EV_READ);
 
   /* Initialise the command queue */
-  STAILQ_INIT(&new_client->command_stailq_head);
+  command_ring_init(&new_client->commands);
 
-  /* Add the new client to the tailq. */
-  TAILQ_INSERT_TAIL(&client_tailq_head, new_client, entries);
+  new_client->overflowed = false;
 
   return new_client;
 }
 
+bool
+enqueue_command(client* client_obj, command* cmd)
+{
+  const char* cmd_name = cmd->name;
+
+  if (!command_ring_push(&client_obj->commands, cmd)) {
+    printf("Command queue of " CLIENT_ID_FMT " is full, dropped %s\n",
+           client_obj->id, cmd_name);
+    client_obj->overflowed = true;
+    return false;
+  }
+
+  printf("Queued %s for " CLIENT_ID_FMT "\n", cmd_name, client_obj->id);
+
+  return true;
+}
+
 void
-enqueue_command(client* client_obj, json_object* cmd)
+broadcast_command(client_head* client_head_obj, command* cmd,
+                  client* excluded[MAX_PARTICIPANTS])
 {
-  struct command* cmd_struct = calloc(1, sizeof(struct command));
+  client* client_obj = NULL;
 
-  size_t cmd_len;
-  const char* cmd_str = get_command_name(cmd, &cmd_len);
+  TAILQ_FOREACH(client_obj, client_head_obj, entries) {
+    bool is_excluded = false;
 
-  printf("Queued %s for %s\n", cmd_str, client_obj->id);
+    for (int i = 0; excluded != NULL && i < MAX_PARTICIPANTS; ++i) {
+      if (excluded[i] != NULL && client_eq(client_obj, excluded[i])) {
+        is_excluded = true;
+      }
+    }
 
-  cmd_struct->cmd_json = cmd;
-  STAILQ_INSERT_TAIL(&client_obj->command_stailq_head, cmd_struct, cmds);
+    if (!is_excluded) {
+      enqueue_command(client_obj, ref_command(cmd));
+    }
+  }
+
+  /* Release the reference held by the caller */
+  free_command(cmd);
 }
 
 void
@@ -65,67 +96,105 @@ send_commands_to_clients(client_head* client_head_obj)
 
   /* For each joined client, flush their command queue */
   TAILQ_FOREACH(client_obj, client_head_obj, entries) {
-    struct command* cmd_struct;
-    struct command* next_cmd_struct;
+    command_ring* ring = &client_obj->commands;
+    command* cmd;
+
+    struct evbuffer* output = bufferevent_get_output(client_obj->buf_ev);
+    framing mode = client_obj->reader.mode;
+
+    struct evbuffer_iovec vec;
+    char* dest;
 
     /* If a client does not have any commands to flush, skip it */
-    if (STAILQ_EMPTY(&client_obj->command_stailq_head)) {
+    if (command_ring_is_empty(ring)) {
       continue;
     }
 
-    json_object* command_wrapper = json_object_new_object();
-    json_object* json_commands = json_object_new_array();
+    /* Anything queued for a client that is about to be dropped is
+       discarded */
+    if (client_obj->overflowed) {
+      clear_command_ring(ring);
+      continue;
+    }
 
-    /* This loop does not free memory allocated to the JSON object
-       representing the actual command */
-    cmd_struct = STAILQ_FIRST(&client_obj->command_stailq_head);
+    /* Commands wait until the client's first byte gives its framing */
+    if (mode == FRAMING_UNKNOWN) {
+      continue;
+    }
 
-    while (cmd_struct != NULL) {
-      next_cmd_struct = STAILQ_NEXT(cmd_struct, cmds);
-      json_object_array_add(json_commands, cmd_struct->cmd_json);
+    /* Work out the length of the packet, as it precedes length-prefixed
+       frames */
+    size_t packet_len = strlen(PACKET_OPEN) + strlen(PACKET_CLOSE);
 
-      free(cmd_struct);
-      cmd_struct = next_cmd_struct;
+    for (size_t i = 0; i < ring->length; ++i) {
+      packet_len += get_command_length(get_command_ring_at(ring, i)) + 1;
     }
 
-    /* Re-initialise the queue after it has been cleared */
-    STAILQ_INIT(&client_obj->command_stailq_head);
+    /* Commands are separated by one less comma than there are commands */
+    packet_len -= 1;
+
+    /* Write the whole frame into the output in one go, copying each
+       encoded command straight out of the command pool */
+    size_t frame_len = FRAME_HEADER_SIZE + packet_len + 1;
+
+    /* A client whose frame cannot be given room is dropped, like one
+       that has fallen behind */
+    if (evbuffer_reserve_space(output, (ev_ssize_t) frame_len, &vec, 1) < 1 ||
+        vec.iov_len < frame_len) {
+      printf("Could not reserve %zu bytes of output to " CLIENT_ID_FMT "\n",
+             frame_len, client_obj->id);
+      client_obj->overflowed = true;
+      clear_command_ring(ring);
+      continue;
+    }
+
+    dest = (char*) vec.iov_base;
+    dest += encode_frame_header(dest, mode, packet_len);
+    memcpy(dest, PACKET_OPEN, strlen(PACKET_OPEN));
+    dest += strlen(PACKET_OPEN);
 
-    /* Add JSON array to the wrapper object */
-    json_object_object_add(command_wrapper, "commands", json_commands);
+    while ((cmd = command_ring_pop(ring)) != NULL) {
+      dest += copy_command(dest, cmd);
 
-    /* Write resulting object to client's bufferevent */
-    size_t cmd_len = 0;
-    const char* cmd_str = JSON_to_str(command_wrapper, &cmd_len);
-    bufferevent_write(client_obj->buf_ev, cmd_str, cmd_len);
+      if (!command_ring_is_empty(ring)) {
+        *dest++ = ',';
+      }
+
+      free_command(cmd);
+    }
 
-    printf("Sent queued command(s) to %s\n", client_obj->id);
+    memcpy(dest, PACKET_CLOSE, strlen(PACKET_CLOSE));
+    dest += strlen(PACKET_CLOSE);
+    dest += encode_frame_trailer(dest, mode);
 
-    /* Free the command wrapper and its constituent objects */
-    json_object_put(command_wrapper);
+    vec.iov_len = (size_t) (dest - (char*) vec.iov_base);
+    evbuffer_commit_space(output, &vec, 1);
+
+    printf("Sent queued command(s) to " CLIENT_ID_FMT "\n", client_obj->id);
+
+    /* A client that is not reading what it is sent cannot keep up */
+    if (evbuffer_get_length(output) > CLIENT_OUTPUT_LIMIT) {
+      printf("Output to " CLIENT_ID_FMT " exceeds %d bytes\n",
+             client_obj->id, CLIENT_OUTPUT_LIMIT);
+      client_obj->overflowed = true;
+    }
   }
 }
 
 bool
 client_eq(client* client1, client* client2)
 {
-  return (strncmp(client1->id, client2->id, HASH_LENGTH) == 0) &&
-         (client1->fd == client2->fd);
-}
-
-void
-update_score(client* client_obj)
-{
-  int hand_score = evaluate_hand_score(client_obj->hand);
-  client_obj->score += hand_score;
+  return (client1->id == client2->id) && (client1->fd == client2->fd);
 }
 
 void
 free_client(client* client_obj)
 {
-  if (client_obj->hand != NULL) free_card_location(client_obj->hand);
+  /* Free any commands that were never sent */
+  free_command_ring(&client_obj->commands);
+
   bufferevent_free(client_obj->buf_ev);
+  free_frame_reader(&client_obj->reader);
   close(client_obj->fd);
-  free(client_obj->id);
   free(client_obj);
 }
@@ -3,145 +3,235 @@
 #include <err.h>
 #include <string.h>
 
-#include "utils.h"
+/* Allocate an array of empty slots. */
+static client_slot*
+client_slots_new(size_t capacity)
+{
+  client_slot* slots = calloc(capacity, sizeof(client_slot));
 
-client_hash_table* hashed_clients = NULL;
+  if (slots == NULL) {
+    err(1, "slots calloc failed");
+  }
 
-client_hash_table*
-client_hash_table_new(size_t size)
+  return slots;
+}
+
+/* Return the index of the slot holding a key, or capacity if it is not
+   held in the array. */
+static size_t
+find_slot(const client_slot* slots, size_t capacity, uint32_t key)
 {
-  client_hash_table* new_table = malloc(sizeof(client_hash_table));
+  size_t mask = capacity - 1;
+  size_t idx = key & mask;
+
+  /* Every client further along is closer to its home than the key
+     would be, so the search can stop at the first one */
+  for (uint32_t dist = 1; slots[idx].dist >= dist; ++dist) {
+    if (slots[idx].key == key) {
+      return idx;
+    }
 
-  if (new_table == NULL) {
-    err(1, "new_table malloc failed");
+    idx = (idx + 1) & mask;
   }
 
-  new_table->size = size;
-  new_table->buckets = malloc(new_table->size*sizeof(client*));
+  return capacity;
+}
 
-  if (new_table->buckets == NULL) {
-    err(1, "new_table->buckets malloc failed");
-  }
+/* Insert a client that is known not to be held in the array. */
+static void
+insert_slot(client_slot* slots, size_t capacity, client_slot entry)
+{
+  size_t mask = capacity - 1;
+  size_t idx = entry.key & mask;
+
+  entry.dist = 1;
+
+  while (slots[idx].dist != 0) {
+    /* Take the slot of a client closer to its home, and carry on
+       finding a slot for that client instead */
+    if (slots[idx].dist < entry.dist) {
+      client_slot displaced = slots[idx];
+      slots[idx] = entry;
+      entry = displaced;
+    }
 
-  for (size_t i = 0; i < new_table->size; ++i) {
-    new_table->buckets[i] = NULL;
+    idx = (idx + 1) & mask;
+    entry.dist++;
   }
 
-  return new_table;
+  slots[idx] = entry;
 }
 
-void
-put_client(client_hash_table* table_obj, client* client_obj)
+/* Empty a slot, shifting the clients after it back to fill the gap. */
+static void
+remove_slot(client_slot* slots, size_t capacity, size_t idx)
 {
-  size_t bucket_idx = get_bucket_idx(table_obj, client_obj->id);
+  size_t mask = capacity - 1;
+  size_t next = (idx + 1) & mask;
 
-  client* current = table_obj->buckets[bucket_idx];
+  while (slots[next].dist > 1) {
+    slots[idx] = slots[next];
+    slots[idx].dist--;
 
-  if (current == NULL) {
-    table_obj->buckets[bucket_idx] = client_obj;
-    return;
+    idx = next;
+    next = (next + 1) & mask;
   }
 
-  /* Resolve hash collision through separate chaining */
-  client* next = NULL;
+  memset(&slots[idx], 0, sizeof(client_slot));
+}
 
-  while (current != NULL) {
-    next = current->next_hash;
+/* Move up to steps slots of the old array into the current one. */
+static void
+migrate_slots(client_hash_table* table_obj, size_t steps)
+{
+  if (table_obj->old_slots == NULL) {
+    return;
+  }
 
-    /* Client already exists! */
-    if (client_eq(current, client_obj)) {
-      /* TODO: set error */
-      return;
-    }
+  while (steps-- > 0 && table_obj->old_next < table_obj->old_capacity) {
+    size_t idx = table_obj->old_next;
+    client_slot* old_slot = &table_obj->old_slots[idx];
 
-    if (next == NULL) {
-      current->next_hash = client_obj;
-      return;
+    if (old_slot->dist == 0) {
+      table_obj->old_next++;
+      continue;
     }
 
-    current = next;
+    insert_slot(table_obj->slots, table_obj->capacity, *old_slot);
+
+    /* Removing the slot may shift another client into it, so it is
+       looked at again */
+    remove_slot(table_obj->old_slots, table_obj->old_capacity, idx);
   }
 
-  /* Control will never reach this part of the function */
+  if (table_obj->old_next == table_obj->old_capacity) {
+    free(table_obj->old_slots);
+    table_obj->old_slots = NULL;
+    table_obj->old_capacity = 0;
+    table_obj->old_next = 0;
+  }
 }
 
-client*
-get_client(const client_hash_table* table_obj, const char* client_id)
+/* Start moving into an array twice the size, once the table is too
+   full. */
+static void
+grow_client_hash_table(client_hash_table* table_obj)
 {
-  size_t bucket_idx = get_bucket_idx(table_obj, client_id);
-
-  client* current = table_obj->buckets[bucket_idx];
-  client* next = NULL;
-
-  while (current != NULL) {
-    next = current->next_hash;
+  size_t num_clients = table_obj->num_clients + 1;
 
-    if (memcmp(current->id, client_id, HASH_LENGTH) == 0) {
-      return current;
-    }
+  if (num_clients*CLIENT_TABLE_LOAD_DEN <=
+      table_obj->capacity*CLIENT_TABLE_LOAD_NUM) {
+    return;
+  }
 
-    current = next;
+  /* Only one array can be moved out of at a time */
+  while (table_obj->old_slots != NULL) {
+    migrate_slots(table_obj, table_obj->old_capacity);
   }
 
-  return NULL;
+  table_obj->old_slots = table_obj->slots;
+  table_obj->old_capacity = table_obj->capacity;
+  table_obj->old_next = 0;
+
+  table_obj->capacity *= 2;
+  table_obj->slots = client_slots_new(table_obj->capacity);
 }
 
-void
-del_client(client_hash_table* table_obj, client* client_obj)
+client_hash_table*
+client_hash_table_new(size_t capacity)
 {
-  size_t bucket_idx = get_bucket_idx(table_obj, client_obj->id);
+  client_hash_table* new_table = malloc(sizeof(client_hash_table));
 
-  client* prev = NULL;
-  client* current = table_obj->buckets[bucket_idx];
-  client* next = NULL;
+  if (new_table == NULL) {
+    err(1, "new_table malloc failed");
+  }
 
-  while (current != NULL) {
-    next = current->next_hash;
+  new_table->capacity = CLIENT_TABLE_MIN_CAPACITY;
 
-    /* Stronger check of equality than memcmp'ing IDs */
-    if (client_eq(current, client_obj)) {
-      if (prev != NULL) {
-        prev->next_hash = next;
-      }
-      else {
-        table_obj->buckets[bucket_idx] = next;
-      }
+  while (capacity*CLIENT_TABLE_LOAD_DEN >
+         new_table->capacity*CLIENT_TABLE_LOAD_NUM) {
+    new_table->capacity *= 2;
+  }
 
-      return;
-    }
+  new_table->slots = client_slots_new(new_table->capacity);
+  new_table->old_slots = NULL;
+  new_table->old_capacity = 0;
+  new_table->old_next = 0;
+  new_table->num_clients = 0;
 
-    prev = current;
-    current = next;
-  }
+  return new_table;
 }
 
-size_t
-get_bucket_idx(const client_hash_table* table_obj, const char* key)
+bool
+put_client(client_hash_table* table_obj, client* client_obj)
 {
-  uint32_t hash = hash_xxhash(key);
+  client_slot entry = {client_obj, client_obj->id, 0};
 
-  return (size_t) (hash % table_obj->size);
+  if (get_client(table_obj, entry.key) != NULL) {
+    return false;
+  }
+
+  migrate_slots(table_obj, CLIENT_TABLE_MIGRATE_STEP);
+  grow_client_hash_table(table_obj);
+
+  insert_slot(table_obj->slots, table_obj->capacity, entry);
+  table_obj->num_clients++;
+
+  return true;
 }
 
-void
-free_client_hash_table(client_hash_table* table_obj)
+client*
+get_client(const client_hash_table* table_obj, uint32_t client_id)
 {
-  /* Set all bucket pointers to null, remove list links */
-  for (size_t i = 0; i < table_obj->size; ++i) {
-    client* current = table_obj->buckets[i];
-    client* next = NULL;
+  size_t idx = find_slot(table_obj->slots, table_obj->capacity, client_id);
+
+  if (idx < table_obj->capacity) {
+    return table_obj->slots[idx].client_obj;
+  }
 
-    while (current != NULL) {
-      next = current->next_hash;
-      if (next == NULL) break;
+  /* The client may not have been moved across yet */
+  if (table_obj->old_slots != NULL) {
+    idx = find_slot(table_obj->old_slots, table_obj->old_capacity,
+                    client_id);
 
-      current->next_hash = NULL;
-      current = next;
+    if (idx < table_obj->old_capacity) {
+      return table_obj->old_slots[idx].client_obj;
     }
+  }
+
+  return NULL;
+}
+
+void
+del_client(client_hash_table* table_obj, client* client_obj)
+{
+  size_t idx = find_slot(table_obj->slots, table_obj->capacity,
+                         client_obj->id);
 
-    table_obj->buckets[i] = NULL;
+  if (idx < table_obj->capacity) {
+    if (table_obj->slots[idx].client_obj == client_obj) {
+      remove_slot(table_obj->slots, table_obj->capacity, idx);
+      table_obj->num_clients--;
+    }
+  }
+  else if (table_obj->old_slots != NULL) {
+    idx = find_slot(table_obj->old_slots, table_obj->old_capacity,
+                    client_obj->id);
+
+    if (idx < table_obj->old_capacity &&
+        table_obj->old_slots[idx].client_obj == client_obj) {
+      remove_slot(table_obj->old_slots, table_obj->old_capacity, idx);
+      table_obj->num_clients--;
+    }
   }
 
-  free(table_obj->buckets);
+  migrate_slots(table_obj, CLIENT_TABLE_MIGRATE_STEP);
+}
+
+void
+free_client_hash_table(client_hash_table* table_obj)
+{
+  free(table_obj->old_slots);
+  free(table_obj->slots);
   free(table_obj);
 }
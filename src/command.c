@@ -1,169 +1,339 @@
 #include "command.h"
 
+#include <err.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "command_error.h"
 #include "utils.h"
 
+/* Opening of a command object, up to the value of its "command" field */
+#define COMMAND_FIELD_OPEN "{\"command\":"
+
+/* Characters surrounding a field's key, as in ,"key": */
+#define FIELD_KEY_PADDING 4
+
+/* Upper bound on the length of an int encoded as JSON, plus a null */
+#define INT_JSON_MAX_LEN 12
+
+/* Length of a client ID encoded as a JSON string */
+#define CLIENT_ID_JSON_LEN (CLIENT_ID_DIGITS + 2)
+
+/* Pool of the commands made by each thread */
+static _Thread_local slab* command_pool = NULL;
+
 const struct commands Command = {
   "JOIN", "START", "SUCCESSFUL_TRADE", "CANCELLED_OFFER", "BOOK_EVENT",
   "BILLIONAIRE", "END_ROUND", "END_GAME", "ERROR", "NEW_OFFER", "CANCEL_OFFER"
 };
 
-json_object*
-make_command(const char* cmd_name)
+/* Check there is room at the end of a command's encoding for a field,
+   leaving room to close the object, then write the field's key and
+   return where its value should be written. */
+static char*
+reserve_field(command* cmd, const char* key, size_t value_max_len)
 {
-  json_object* cmd = json_object_new_object();
-  json_object* cmd_str = json_object_new_string(cmd_name);
-  json_object_object_add(cmd, "command", cmd_str);
+  size_t key_len = strlen(key);
 
-  return cmd;
-}
+  if (cmd->json_len + key_len + FIELD_KEY_PADDING + value_max_len >
+      COMMAND_JSON_MAX_LEN - 1) {
+    errx(1, "%s command exceeds %d characters", cmd->name,
+         COMMAND_JSON_MAX_LEN);
+  }
 
-json_object*
-command_join(char* id)
-{
-  json_object* cmd = make_command(Command.JOIN);
+  char* dest = cmd->json + cmd->json_len;
 
-  json_object* client_id = json_object_new_string(id);
-  json_object_object_add(cmd, "client_id", client_id);
+  *dest++ = ',';
+  *dest++ = '"';
+  memcpy(dest, key, key_len);
+  dest += key_len;
+  *dest++ = '"';
+  *dest++ = ':';
 
-  return cmd;
+  return dest;
 }
 
-json_object*
-command_start(card_location* player_hand)
+/* Commit a field written into space from reserve_field(). */
+static void
+commit_field(command* cmd, const char* end)
 {
-  json_object* cmd = make_command(Command.START);
+  cmd->json_len = (size_t) (end - cmd->json);
+}
 
-  json_object* hand_json = JSON_from_card_location(player_hand);
-  json_object* score_json = json_object_new_int(INITIAL_SCORE);
+static void
+add_string_field(command* cmd, const char* key, const char* value)
+{
+  size_t value_len = strlen(value);
 
-  json_object_object_add(cmd, "hand", hand_json);
-  json_object_object_add(cmd, "score", score_json);
+  char* dest = reserve_field(cmd, key, JSON_STR_MAX_LEN(value_len));
+  dest += encode_JSON_string(dest, value, value_len);
 
-  return cmd;
+  commit_field(cmd, dest);
 }
 
-json_object*
-command_successful_trade(offer* traded_offer)
+static void
+add_int_field(command* cmd, const char* key, int value)
 {
-  json_object* cmd = make_command(Command.SUCCESSFUL_TRADE);
+  char* dest = reserve_field(cmd, key, INT_JSON_MAX_LEN);
+  dest += snprintf(dest, INT_JSON_MAX_LEN, "%d", value);
 
-  json_object* offer_cards = JSON_from_card_location(traded_offer->cards);
-  json_object* offer_owner = json_object_new_string(traded_offer->owner_id);
+  commit_field(cmd, dest);
+}
 
-  json_object_object_add(cmd, "cards", offer_cards);
-  json_object_object_add(cmd, "owner_id", offer_owner);
+static void
+add_cards_field(command* cmd, const char* key, const card_location* cards)
+{
+  char* dest = reserve_field(cmd, key, CARD_LOCATION_JSON_MAX_LEN);
+  dest += encode_card_location(dest, cards);
 
-  return cmd;
+  commit_field(cmd, dest);
 }
 
-json_object*
-command_cancelled_offer(offer* cancelled_offer)
+/* Write a client ID as a quoted JSON string, returning its length. */
+static size_t
+encode_client_id_string(char* dest, uint32_t id)
 {
-  json_object* cmd = make_command(Command.CANCELLED_OFFER);
+  dest[0] = '"';
+  encode_client_id(dest + 1, id);
+  dest[CLIENT_ID_JSON_LEN - 1] = '"';
 
-  json_object* offer_cards = JSON_from_card_location(cancelled_offer->cards);
-  json_object_object_add(cmd, "cards", offer_cards);
+  return CLIENT_ID_JSON_LEN;
+}
 
-  return cmd;
+static void
+add_client_id_field(command* cmd, const char* key, uint32_t id)
+{
+  char* dest = reserve_field(cmd, key, CLIENT_ID_JSON_LEN);
+  dest += encode_client_id_string(dest, id);
+
+  commit_field(cmd, dest);
 }
 
-json_object*
-command_book_event(const char* event, size_t card_amt,
-                       const char* participants[MAX_PARTICIPANTS])
+static void
+add_client_id_array_field(command* cmd, const char* key,
+                          const uint32_t ids[], size_t num_ids)
 {
-  json_object* cmd = make_command(Command.BOOK_EVENT);
+  size_t max_len = 2 + num_ids*(CLIENT_ID_JSON_LEN + 1);
 
-  json_object* event_json = json_object_new_string(event);
-  json_object* card_amt_json = json_object_new_int((int) card_amt);
-  json_object* participants_json = json_object_new_array();
+  char* dest = reserve_field(cmd, key, max_len);
 
-  for (int i = 0; i < MAX_PARTICIPANTS; ++i) {
-    const char* participant = participants[i];
+  *dest++ = '[';
 
-    if (participant == NULL) {
-      continue;
+  for (size_t i = 0; i < num_ids; ++i) {
+    /* Separate values after the first one */
+    if (i > 0) {
+      *dest++ = ',';
     }
 
-    json_object* participant_json = json_object_new_string(participant);
-    json_object_array_add(participants_json, participant_json);
+    dest += encode_client_id_string(dest, ids[i]);
   }
 
-  json_object_object_add(cmd, "event", event_json);
-  json_object_object_add(cmd, "card_amt", card_amt_json);
-  json_object_object_add(cmd, "participants", participants_json);
+  *dest++ = ']';
 
-  return cmd;
+  commit_field(cmd, dest);
 }
 
-json_object*
-command_billionaire(const char* winner_id)
+/* Return the calling thread's command pool, creating it on first use. */
+static slab*
+get_command_pool()
+{
+  if (command_pool == NULL) {
+    command_pool = slab_new(sizeof(command), COMMAND_SLAB_CHUNK);
+  }
+
+  return command_pool;
+}
+
+command*
+make_command(const char* cmd_name)
 {
-  json_object* cmd = make_command(Command.BILLIONAIRE);
+  command* cmd = slab_alloc(get_command_pool());
+
+  cmd->name = cmd_name;
+  cmd->refcnt = 1;
 
-  json_object* winner_json = json_object_new_string(winner_id);
+  /* The "command" field is always the first field of the object */
+  size_t name_len = strlen(cmd_name);
+  char* dest = cmd->json;
 
-  json_object_object_add(cmd, "winner_id", winner_json);
+  memcpy(dest, COMMAND_FIELD_OPEN, strlen(COMMAND_FIELD_OPEN));
+  dest += strlen(COMMAND_FIELD_OPEN);
+  dest += encode_JSON_string(dest, cmd_name, name_len);
+
+  commit_field(cmd, dest);
 
   return cmd;
 }
 
-json_object*
-command_end_round(int score)
+command*
+end_command(command* cmd)
+{
+  cmd->json[cmd->json_len++] = '}';
+
+  return cmd;
+}
+
+command*
+command_join(uint32_t id)
 {
-  json_object* cmd = make_command(Command.END_ROUND);
+  command* cmd = make_command(Command.JOIN);
 
-  json_object* score_json = json_object_new_int(score);
+  add_client_id_field(cmd, "client_id", id);
 
-  json_object_object_add(cmd, "score", score_json);
+  return end_command(cmd);
+}
 
-  return cmd;
+command*
+command_start(const card_location* player_hand, int score)
+{
+  command* cmd = make_command(Command.START);
+
+  add_cards_field(cmd, "hand", player_hand);
+  add_int_field(cmd, "score", score);
+
+  return end_command(cmd);
 }
 
-json_object*
-command_end_game()
+command*
+command_successful_trade(const card_location* cards, uint32_t owner_id)
 {
-  return make_command(Command.END_GAME);
+  command* cmd = make_command(Command.SUCCESSFUL_TRADE);
+
+  add_cards_field(cmd, "cards", cards);
+  add_client_id_field(cmd, "owner_id", owner_id);
+
+  return end_command(cmd);
 }
 
-json_object*
-command_error()
+command*
+command_cancelled_offer(const card_location* cards)
+{
+  command* cmd = make_command(Command.CANCELLED_OFFER);
+
+  add_cards_field(cmd, "cards", cards);
+
+  return end_command(cmd);
+}
+
+command*
+command_book_event(const char* event, size_t card_amt,
+                   const uint32_t participants[MAX_PARTICIPANTS],
+                   size_t num_participants)
+{
+  command* cmd = make_command(Command.BOOK_EVENT);
+
+  add_string_field(cmd, "event", event);
+  add_int_field(cmd, "card_amt", (int) card_amt);
+  add_client_id_array_field(cmd, "participants", participants,
+                            num_participants);
+
+  return end_command(cmd);
+}
+
+command*
+command_billionaire(uint32_t winner_id)
+{
+  command* cmd = make_command(Command.BILLIONAIRE);
+
+  add_client_id_field(cmd, "winner_id", winner_id);
+
+  return end_command(cmd);
+}
+
+command*
+command_end_round(int score)
+{
+  command* cmd = make_command(Command.END_ROUND);
+
+  add_int_field(cmd, "score", score);
+
+  return end_command(cmd);
+}
+
+command*
+command_end_game()
 {
-  json_object* cmd = make_command(Command.ERROR);
+  return end_command(make_command(Command.END_GAME));
+}
 
-  json_object* errno_json = json_object_new_int(cmd_errno);
+command*
+command_error(cmd_result* res)
+{
+  command* cmd = make_command(Command.ERROR);
 
-  char* what;
+  const char* what;
 
-  if (cmd_errno <= EJSON) { /* The error comes from <json-c/json-c.h> */
-    what = (char*) json_tokener_error_desc(cmd_errno);
+  if (res->err <= EJSON) { /* The error comes from <json-c/json-c.h> */
+    what = json_tokener_error_desc(res->err);
     printf("External JSON error, %s\n", what);
   }
 
   else { /* The error is internal and has a specified reason */
-    what = (char*) error_what[cmd_errno - EJSON - 1];
-    printf("Internal error, %d: %s\n", cmd_errno - EJSON - 1, what);
+    what = error_what[res->err - EJSON - 1];
+    printf("Internal error, %d: %s\n", res->err - EJSON - 1, what);
   }
 
-  json_object* what_json = json_object_new_string(what);
+  add_int_field(cmd, "errno", res->err);
+  add_string_field(cmd, "what", what);
+
+  res->err = CMD_SUCCESS;
 
-  json_object_object_add(cmd, "errno", errno_json);
-  json_object_object_add(cmd, "what", what_json);
+  return end_command(cmd);
+}
+
+size_t
+get_command_length(const command* cmd)
+{
+  return cmd->json_len;
+}
 
-  cmd_errno = CMD_SUCCESS;
+command*
+ref_command(command* cmd)
+{
+  cmd->refcnt++;
 
   return cmd;
 }
 
+size_t
+copy_command(char* dest, const command* cmd)
+{
+  memcpy(dest, cmd->json, cmd->json_len);
+
+  return cmd->json_len;
+}
+
+void
+free_command(command* cmd)
+{
+  if (--cmd->refcnt > 0) {
+    return;
+  }
+
+  slab_free(command_pool, cmd);
+}
+
+const slab_stats*
+get_command_pool_stats()
+{
+  return get_slab_stats(get_command_pool());
+}
+
+void
+free_command_pool()
+{
+  if (command_pool != NULL) {
+    free_slab(command_pool);
+    command_pool = NULL;
+  }
+}
+
 const char*
-get_command_name(json_object* cmd, size_t* str_len)
+get_command_name(json_object* cmd, size_t* str_len, cmd_result* res)
 {
-  json_object* cmd_str_json = get_JSON_value(cmd, "command");
+  json_object* cmd_str_json = get_JSON_value(cmd, "command", res);
 
-  if (cmd_errno != CMD_SUCCESS) {
+  if (cmd_failed(res)) {
     *str_len = 0;
     return NULL;
   }
@@ -175,29 +345,42 @@ get_command_name(json_object* cmd, size_t* str_len)
 }
 
 json_object*
-parse_command_list_string(char* json_str, size_t str_len)
+parse_command_list_string(const char* json_str, size_t str_len,
+                          cmd_result* res)
 {
-  json_object* parse_obj = str_to_JSON(json_str, str_len);
+  json_object* parse_obj = str_to_JSON(json_str, str_len, res);
 
-  if (cmd_errno != CMD_SUCCESS) {
+  if (cmd_failed(res)) {
     json_object_put(parse_obj);
     return NULL;
   }
 
-  json_object* cmd_array = get_JSON_value(parse_obj, "commands");
+  return parse_command_list(parse_obj, res);
+}
 
-  if (cmd_errno != CMD_SUCCESS) {
-    json_object_put(parse_obj);
+json_object*
+parse_command_list(json_object* packet, cmd_result* res)
+{
+  if (packet == NULL || cmd_failed(res)) {
+    json_object_put(packet);
+    return NULL;
+  }
+
+  json_object* cmd_array = get_JSON_value(packet, "commands", res);
+
+  if (cmd_failed(res)) {
+    json_object_put(packet);
     return NULL;
   }
 
   if (!json_object_is_type(cmd_array, json_type_array)) {
-    cmd_errno = (int) EJSONTYPE;
+    res->err = (int) EJSONTYPE;
+    json_object_put(packet);
     return NULL;
   }
 
   json_object_get(cmd_array);
-  json_object_put(parse_obj);
+  json_object_put(packet);
 
   return cmd_array;
 }
@@ -205,8 +388,13 @@ parse_command_list_string(char* json_str, size_t str_len)
 bool
 command_is(json_object* cmd, const char* cmd_name)
 {
+  cmd_result res = CMD_RESULT_INIT;
   size_t cmd_len = 0;
-  const char* cmd_str = get_command_name(cmd, &cmd_len);
+  const char* cmd_str = get_command_name(cmd, &cmd_len, &res);
+
+  if (cmd_failed(&res)) {
+    return false;
+  }
 
   return (strcmp(cmd_str, cmd_name) == 0);
 }
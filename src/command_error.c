@@ -1,7 +1,5 @@
 #include "command_error.h"
 
-int cmd_errno = CMD_SUCCESS;
-
 const char* error_what[] = {
   "JSON value unable to be extracted",
   "JSON object is not the desired type",
@@ -15,5 +13,14 @@ const char* error_what[] = {
   "Cards in offer do not exist in hand",
   "Offer contains too many unique commodities",
   "Offer contains too many unique wildcards",
-  "Not enough cards to remove from card_location"
+  "Not enough cards to remove from card_location",
+  "Command packet exceeds the maximum frame size",
+  "Offer contains too many cards",
+  "Cards object does not describe valid cards"
 };
+
+bool
+cmd_failed(const cmd_result* res)
+{
+  return res->err != CMD_SUCCESS;
+}
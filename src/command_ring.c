@@ -0,0 +1,117 @@
+#include "command_ring.h"
+
+#include <err.h>
+
+/* Return the array index of a command a number of places from the
+   front of the ring. */
+static size_t
+ring_index(const command_ring* ring, size_t index)
+{
+  return (ring->head + index) & (ring->capacity - 1);
+}
+
+/* Double the capacity of a full ring, unwrapping its commands to the
+   start of the new array. */
+static void
+grow_command_ring(command_ring* ring)
+{
+  size_t new_capacity = 2*ring->capacity;
+  command** new_cmds = malloc(new_capacity*sizeof(command*));
+
+  if (new_cmds == NULL) {
+    err(1, "new_cmds malloc failed");
+  }
+
+  for (size_t i = 0; i < ring->length; ++i) {
+    new_cmds[i] = ring->cmds[ring_index(ring, i)];
+  }
+
+  free(ring->cmds);
+
+  ring->cmds = new_cmds;
+  ring->capacity = new_capacity;
+  ring->head = 0;
+}
+
+void
+command_ring_init(command_ring* ring)
+{
+  ring->cmds = malloc(COMMAND_RING_INIT_CAPACITY*sizeof(command*));
+
+  if (ring->cmds == NULL) {
+    err(1, "ring->cmds malloc failed");
+  }
+
+  ring->capacity = COMMAND_RING_INIT_CAPACITY;
+  ring->head = 0;
+  ring->length = 0;
+}
+
+bool
+command_ring_push(command_ring* ring, command* cmd)
+{
+  if (ring->length == ring->capacity) {
+    if (ring->capacity >= COMMAND_RING_MAX_CAPACITY) {
+      free_command(cmd);
+      return false;
+    }
+
+    grow_command_ring(ring);
+  }
+
+  ring->cmds[ring_index(ring, ring->length)] = cmd;
+  ring->length++;
+
+  return true;
+}
+
+command*
+command_ring_pop(command_ring* ring)
+{
+  command* cmd;
+
+  if (ring->length == 0) {
+    return NULL;
+  }
+
+  cmd = ring->cmds[ring->head];
+
+  ring->head = ring_index(ring, 1);
+  ring->length--;
+
+  return cmd;
+}
+
+command*
+get_command_ring_at(const command_ring* ring, size_t index)
+{
+  return ring->cmds[ring_index(ring, index)];
+}
+
+bool
+command_ring_is_empty(const command_ring* ring)
+{
+  return ring->length == 0;
+}
+
+void
+clear_command_ring(command_ring* ring)
+{
+  command* cmd;
+
+  while ((cmd = command_ring_pop(ring)) != NULL) {
+    free_command(cmd);
+  }
+
+  ring->head = 0;
+}
+
+void
+free_command_ring(command_ring* ring)
+{
+  clear_command_ring(ring);
+
+  free(ring->cmds);
+  ring->cmds = NULL;
+  ring->capacity = 0;
+}
@@ -0,0 +1,554 @@
+#include "engine.h"
+
+#include <err.h>
+#include <string.h>
+
+#include "command_error.h"
+
+/* Hand an event to a seat's agent. */
+static void
+send_event(const engine* engine_obj, size_t seat, const engine_event* event)
+{
+  const engine_agent* agent = &engine_obj->agents[seat];
+
+  if (agent->on_event != NULL) {
+    agent->on_event(engine_obj, seat, event, agent->data);
+  }
+}
+
+/* Hand an event to every seat but the excluded ones, through the
+   broadcaster if there is one. */
+static void
+broadcast_event(const engine* engine_obj, const engine_event* event,
+                const size_t excluded[], size_t num_excluded)
+{
+  const engine_broadcaster* broadcaster = &engine_obj->broadcaster;
+
+  if (broadcaster->on_broadcast != NULL) {
+    broadcaster->on_broadcast(engine_obj, event, excluded, num_excluded,
+                              broadcaster->data);
+    return;
+  }
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    bool is_excluded = false;
+
+    for (size_t i = 0; i < num_excluded; ++i) {
+      is_excluded |= (excluded[i] == seat);
+    }
+
+    if (!is_excluded) {
+      send_event(engine_obj, seat, event);
+    }
+  }
+}
+
+/* Announce a change to the book to every seat that did not take part. */
+static void
+broadcast_book_event(const engine* engine_obj, engine_book_event book_event,
+                     size_t card_amt, const size_t participants[],
+                     size_t num_participants)
+{
+  engine_event event = {
+    .type = ENGINE_BOOK_EVENT,
+    .book_event = book_event,
+    .card_amt = card_amt,
+    .num_participants = num_participants
+  };
+
+  memcpy(event.participants, participants, num_participants*sizeof(size_t));
+
+  broadcast_event(engine_obj, &event, participants, num_participants);
+}
+
+/* Tell a seat why its action failed. */
+static void
+send_error(engine* engine_obj, size_t seat, int err)
+{
+  engine_event event = {.type = ENGINE_ERROR, .err = err};
+
+  engine_obj->last_err = err;
+
+  send_event(engine_obj, seat, &event);
+}
+
+/* Reshuffle the deck and deal it into every seat's hand. */
+static void
+deal_round(engine* engine_obj)
+{
+  card_location* player_hands[ENGINE_MAX_SEATS];
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    player_hands[seat] = &engine_obj->hands[seat];
+  }
+
+  shuffle_card_array(engine_obj->deck, &engine_obj->shuffler);
+  deal_cards_to_hands(engine_obj->num_seats, engine_obj->deck, player_hands);
+
+  engine_obj->num_passes = 0;
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    engine_event event = {
+      .type = ENGINE_START,
+      .cards = engine_obj->hands[seat],
+      .score = engine_obj->scores[seat]
+    };
+
+    send_event(engine_obj, seat, &event);
+  }
+}
+
+/* Score every hand, then either deal the next round or end the game
+   once a seat has reached WINNING_SCORE. */
+static void
+end_round(engine* engine_obj)
+{
+  int hand_scores[ENGINE_MAX_SEATS];
+  bool game_won = engine_score_round(engine_obj->current_trades,
+                                     engine_obj->hands, engine_obj->scores,
+                                     engine_obj->num_seats,
+                                     engine_obj->seat_hands, hand_scores);
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    engine_event event = {
+      .type = ENGINE_END_ROUND,
+      .score = engine_obj->scores[seat]
+    };
+
+    send_event(engine_obj, seat, &event);
+  }
+
+  engine_obj->num_rounds++;
+
+  if (game_won) {
+    engine_event event = {.type = ENGINE_END_GAME};
+
+    engine_obj->running = false;
+    broadcast_event(engine_obj, &event, NULL, 0);
+    return;
+  }
+
+  deal_round(engine_obj);
+}
+
+/* Announce the winner of a round to every seat. */
+static void
+broadcast_billionaire(const engine* engine_obj, size_t seat)
+{
+  engine_event event = {.type = ENGINE_BILLIONAIRE, .seat = seat};
+
+  broadcast_event(engine_obj, &event, NULL, 0);
+}
+
+/* Put cards from a seat's hand on offer, trading them straight away if
+   another seat has an offer of the same size. */
+static bool
+submit_offer(engine* engine_obj, size_t seat, const card_location* cards)
+{
+  engine_trade trade;
+  int offer_err = engine_apply_offer(engine_obj->current_trades,
+                                     engine_obj->hands, seat, cards, &trade);
+
+  if (offer_err != CMD_SUCCESS) {
+    /* Hand back a rejected offer, which the seat may have taken out of
+       its own view of its hand when offering it */
+    if (offer_err != ENOOFFER) {
+      engine_event returned = {
+        .type = ENGINE_CANCELLED_OFFER,
+        .cards = *cards
+      };
+
+      send_event(engine_obj, seat, &returned);
+    }
+
+    send_error(engine_obj, seat, offer_err);
+    return false;
+  }
+
+  size_t card_amt = get_total_cards(cards);
+
+  if (!trade.traded) {
+    size_t participants[MAX_PARTICIPANTS] = {seat};
+
+    broadcast_book_event(engine_obj, ENGINE_BOOK_NEW_OFFER, card_amt,
+                         participants, 1);
+    return true;
+  }
+
+  size_t other_seat = trade.other_seat;
+
+  engine_event this_trade = {
+    .type = ENGINE_SUCCESSFUL_TRADE,
+    .cards = trade.received,
+    .seat = other_seat
+  };
+  engine_event other_trade = {
+    .type = ENGINE_SUCCESSFUL_TRADE,
+    .cards = trade.given,
+    .seat = seat
+  };
+
+  engine_obj->num_trades++;
+
+  send_event(engine_obj, seat, &this_trade);
+  send_event(engine_obj, other_seat, &other_trade);
+
+  size_t participants[MAX_PARTICIPANTS] = {seat, other_seat};
+
+  broadcast_book_event(engine_obj, ENGINE_BOOK_SUCCESSFUL_TRADE, card_amt,
+                       participants, 2);
+
+  /* Check for win conditions */
+  if (trade.seat_won) {
+    broadcast_billionaire(engine_obj, seat);
+  }
+
+  if (trade.other_seat_won) {
+    broadcast_billionaire(engine_obj, other_seat);
+  }
+
+  if (trade.seat_won || trade.other_seat_won) {
+    end_round(engine_obj);
+  }
+
+  return true;
+}
+
+/* Take back a seat's oldest offer of a size. */
+static bool
+submit_cancel(engine* engine_obj, size_t seat, size_t card_amt)
+{
+  engine_event event = {.type = ENGINE_CANCELLED_OFFER};
+  int cancel_err = engine_apply_cancel(engine_obj->current_trades,
+                                       engine_obj->hands, seat, card_amt,
+                                       &event.cards);
+
+  if (cancel_err != CMD_SUCCESS) {
+    send_error(engine_obj, seat, cancel_err);
+    return false;
+  }
+
+  send_event(engine_obj, seat, &event);
+
+  size_t participants[MAX_PARTICIPANTS] = {seat};
+
+  broadcast_book_event(engine_obj, ENGINE_BOOK_CANCELLED_OFFER, card_amt,
+                       participants, 1);
+
+  return true;
+}
+
+int
+engine_apply_offer(book* book_obj, card_location hands[], size_t seat,
+                   const card_location* cards, engine_trade* trade)
+{
+  cmd_result res = CMD_RESULT_INIT;
+
+  validate_offer(cards, &hands[seat], &res);
+
+  if (cmd_failed(&res)) {
+    return res.err;
+  }
+
+  /* The offer is known to be in the hand, so this cannot fail. The cards
+     leave the hand before the offer can trade */
+  offer* new_offer = offer_init(book_obj, cards, (uint32_t) seat);
+  subtract_card_location(&hands[seat], cards, &res);
+
+  offer* traded_offer = fill_offer(book_obj, new_offer);
+
+  trade->traded = (traded_offer != NULL);
+  trade->seat_won = false;
+  trade->other_seat_won = false;
+
+  if (!trade->traded) {
+    return CMD_SUCCESS;
+  }
+
+  size_t other_seat = (size_t) traded_offer->owner_id;
+
+  merge_card_location(&hands[seat], &traded_offer->cards);
+  merge_card_location(&hands[other_seat], &new_offer->cards);
+
+  trade->other_seat = other_seat;
+  trade->given = new_offer->cards;
+  trade->received = traded_offer->cards;
+
+  free_offer(book_obj, new_offer);
+  free_offer(book_obj, traded_offer);
+
+  /* Only the two hands of the trade have changed, so they are checked on
+     their own. The hand_matrix is filled in at the end of a round, where
+     every seat is scored at once */
+  trade->seat_won = has_won(&hands[seat]);
+  trade->other_seat_won = has_won(&hands[other_seat]);
+
+  return CMD_SUCCESS;
+}
+
+int
+engine_apply_cancel(book* book_obj, card_location hands[], size_t seat,
+                    size_t card_amt, card_location* returned)
+{
+  cmd_result res = CMD_RESULT_INIT;
+
+  offer* cancelled_offer = cancel_offer(book_obj, card_amt, (uint32_t) seat,
+                                        &res);
+
+  if (cmd_failed(&res)) {
+    return res.err;
+  }
+
+  merge_card_location(&hands[seat], &cancelled_offer->cards);
+  *returned = cancelled_offer->cards;
+
+  free_offer(book_obj, cancelled_offer);
+
+  return CMD_SUCCESS;
+}
+
+bool
+engine_score_round(book* book_obj, card_location hands[], int scores[],
+                   size_t num_seats, hand_matrix* seat_hands, int points[])
+{
+  bool game_won = false;
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    /* Cards still on offer count towards the owner's hand */
+    cancel_owner_offers(book_obj, (uint32_t) seat, &hands[seat]);
+    set_hand_matrix_seat(seat_hands, seat, &hands[seat]);
+  }
+
+  evaluate_hand_matrix(seat_hands, NULL, points);
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    scores[seat] += points[seat];
+    game_won |= (scores[seat] >= WINNING_SCORE);
+  }
+
+  clear_book(book_obj);
+
+  return game_won;
+}
+
+engine*
+engine_new(size_t num_seats, bool has_billionaire, bool has_taxman,
+           uint64_t seed, uint64_t stream)
+{
+  if (num_seats < 2 || num_seats > ENGINE_MAX_SEATS) {
+    errx(1, "engine seat count must be between 2 and %d", ENGINE_MAX_SEATS);
+  }
+
+  engine* new_engine = malloc(sizeof(engine));
+
+  if (new_engine == NULL) {
+    err(1, "new_engine malloc failed");
+  }
+
+  memset(new_engine, 0, sizeof(engine));
+
+  new_engine->num_seats = num_seats;
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    clear_card_location(&new_engine->hands[seat]);
+    new_engine->scores[seat] = INITIAL_SCORE;
+  }
+
+  card_location* unordered_deck = generate_deck((int) num_seats,
+                                                has_billionaire, has_taxman);
+
+  new_engine->deck = flatten_card_location(unordered_deck);
+
+  free_card_location(unordered_deck);
+
+  new_engine->current_trades = book_new();
+  new_engine->seat_hands = hand_matrix_new(num_seats);
+
+  rng_init(&new_engine->shuffler, seed, stream);
+
+  return new_engine;
+}
+
+void
+set_engine_agent(engine* engine_obj, size_t seat, const engine_agent* agent)
+{
+  engine_obj->agents[seat] = *agent;
+}
+
+void
+set_engine_broadcaster(engine* engine_obj,
+                       const engine_broadcaster* broadcaster)
+{
+  engine_obj->broadcaster = *broadcaster;
+}
+
+const card_location*
+get_engine_hand(const engine* engine_obj, size_t seat)
+{
+  return &engine_obj->hands[seat];
+}
+
+int
+get_engine_score(const engine* engine_obj, size_t seat)
+{
+  return engine_obj->scores[seat];
+}
+
+void
+seed_engine(engine* engine_obj, uint64_t seed, uint64_t stream)
+{
+  card_array* deck = engine_obj->deck;
+  size_t card_counts[TOTAL_UNIQUE_CARDS] = {0};
+  size_t i = 0;
+
+  /* Every shuffle permutes the previous one, so the deck is put back in
+     the order it was created in */
+  for (size_t n = 0; n < deck->num_cards; ++n) {
+    card_counts[deck->cards[n]]++;
+  }
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    for (size_t n = 0; n < card_counts[card]; ++n) {
+      deck->cards[i++] = card;
+    }
+  }
+
+  rng_init(&engine_obj->shuffler, seed, stream);
+}
+
+void
+engine_start_game(engine* engine_obj)
+{
+  clear_book(engine_obj->current_trades);
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    engine_obj->scores[seat] = INITIAL_SCORE;
+  }
+
+  engine_obj->running = true;
+  engine_obj->next_seat = 0;
+
+  deal_round(engine_obj);
+}
+
+void
+engine_stop_game(engine* engine_obj)
+{
+  engine_event event = {.type = ENGINE_END_GAME};
+
+  engine_obj->running = false;
+  clear_book(engine_obj->current_trades);
+
+  broadcast_event(engine_obj, &event, NULL, 0);
+}
+
+void
+engine_withdraw_seat(engine* engine_obj, size_t seat)
+{
+  book* current_trades = engine_obj->current_trades;
+  uint32_t levels = get_owner_levels(current_trades, (uint32_t) seat);
+  size_t participants[MAX_PARTICIPANTS] = {seat};
+
+  /* Nobody could trade with the seat's offers once it has gone */
+  while (levels != 0) {
+    size_t card_amt = (size_t) (__builtin_ctz(levels) + OFFER_INDEX_OFFSET);
+
+    broadcast_book_event(engine_obj, ENGINE_BOOK_CANCELLED_OFFER, card_amt,
+                         participants, 1);
+
+    levels &= levels - 1;
+  }
+
+  cancel_owner_offers(current_trades, (uint32_t) seat,
+                      &engine_obj->hands[seat]);
+}
+
+bool
+engine_submit(engine* engine_obj, size_t seat, const engine_action* action)
+{
+  engine_obj->last_err = CMD_SUCCESS;
+
+  switch (action->type) {
+    case ENGINE_NEW_OFFER:
+      return submit_offer(engine_obj, seat, &action->cards);
+
+    case ENGINE_CANCEL_OFFER:
+      return submit_cancel(engine_obj, seat, action->card_amt);
+
+    default:
+      return true;
+  }
+}
+
+bool
+engine_step(engine* engine_obj)
+{
+  if (!engine_obj->running) {
+    return false;
+  }
+
+  size_t seat = engine_obj->next_seat;
+  const engine_agent* agent = &engine_obj->agents[seat];
+  engine_action action = {.type = ENGINE_PASS, .card_amt = 0};
+
+  clear_card_location(&action.cards);
+
+  if (agent->act != NULL) {
+    agent->act(engine_obj, seat, &action, agent->data);
+  }
+
+  return engine_take_turn(engine_obj, &action);
+}
+
+bool
+engine_take_turn(engine* engine_obj, const engine_action* action)
+{
+  if (!engine_obj->running) {
+    return false;
+  }
+
+  size_t seat = engine_obj->next_seat;
+
+  engine_obj->next_seat = (seat + 1) % engine_obj->num_seats;
+  engine_obj->num_turns++;
+  engine_obj->last_err = CMD_SUCCESS;
+
+  if (action->type == ENGINE_PASS) {
+    /* Nobody is going to trade again this round */
+    if (++engine_obj->num_passes == engine_obj->num_seats) {
+      end_round(engine_obj);
+    }
+  }
+
+  else {
+    engine_obj->num_passes = 0;
+    engine_submit(engine_obj, seat, action);
+  }
+
+  return engine_obj->running;
+}
+
+bool
+engine_play_game(engine* engine_obj, size_t max_turns)
+{
+  engine_start_game(engine_obj);
+
+  for (size_t turn = 0; turn < max_turns; ++turn) {
+    if (!engine_step(engine_obj)) {
+      return true;
+    }
+  }
+
+  engine_stop_game(engine_obj);
+
+  return false;
+}
+
+void
+free_engine(engine* engine_obj)
+{
+  free_card_array(engine_obj->deck);
+  free_book(engine_obj->current_trades);
+  free_hand_matrix(engine_obj->seat_hands);
+  free(engine_obj);
+}
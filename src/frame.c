@@ -0,0 +1,301 @@
+#include "frame.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "command_error.h"
+
+/* Find the delimiter ending the frame at the front of a newline-delimited
+   input buffer, remembering how much has already been searched. */
+static bool
+find_delimiter(frame_reader* reader, struct evbuffer* input)
+{
+  size_t input_len = evbuffer_get_length(input);
+
+  if (reader->scanned >= input_len) {
+    return false;
+  }
+
+  struct evbuffer_ptr start;
+  evbuffer_ptr_set(input, &start, reader->scanned, EVBUFFER_PTR_SET);
+
+  struct evbuffer_ptr eol = evbuffer_search_eol(input, &start, NULL,
+                                                EVBUFFER_EOL_LF);
+
+  if (eol.pos < 0) {
+    reader->scanned = input_len;
+    return false;
+  }
+
+  reader->frame_len = (size_t) eol.pos;
+  reader->have_len = true;
+
+  return true;
+}
+
+/* Take the length header off the frame at the front of a length-prefixed
+   input buffer. */
+static bool
+read_frame_header(frame_reader* reader, struct evbuffer* input)
+{
+  uint8_t header[FRAME_HEADER_SIZE];
+
+  if (evbuffer_get_length(input) < FRAME_HEADER_SIZE) {
+    return false;
+  }
+
+  evbuffer_remove(input, header, FRAME_HEADER_SIZE);
+
+  reader->frame_len = ((size_t) header[0] << 24) |
+                      ((size_t) header[1] << 16) |
+                      ((size_t) header[2] << 8) |
+                      ((size_t) header[3]);
+  reader->have_len = true;
+
+  return true;
+}
+
+/* Pick the framing of a connection from the first byte its peer sends,
+   leaving the byte in the input. Returns false until a byte arrives. */
+static bool
+sniff_framing(frame_reader* reader, struct evbuffer* input)
+{
+  char first;
+
+  if (evbuffer_copyout(input, &first, 1) < 1) {
+    return false;
+  }
+
+  reader->mode = (first == FRAME_PACKET_OPEN || first == FRAME_DELIMITER)
+                 ? FRAMING_NEWLINE
+                 : FRAMING_LENGTH;
+
+  return true;
+}
+
+/* Drain what is buffered of an oversized frame. Returns true once the
+   whole frame has been discarded. */
+static bool
+discard_frame(frame_reader* reader, struct evbuffer* input)
+{
+  if (reader->mode == FRAMING_LENGTH) {
+    size_t input_len = evbuffer_get_length(input);
+    size_t drain_len = (input_len < reader->discard_len) ? input_len
+                                                         : reader->discard_len;
+
+    evbuffer_drain(input, drain_len);
+    reader->discard_len -= drain_len;
+  }
+
+  else {
+    struct evbuffer_ptr eol = evbuffer_search_eol(input, NULL, NULL,
+                                                  EVBUFFER_EOL_LF);
+
+    if (eol.pos < 0) {
+      evbuffer_drain(input, evbuffer_get_length(input));
+      return false;
+    }
+
+    evbuffer_drain(input, (size_t) eol.pos + 1);
+  }
+
+  reader->discarding = (reader->discard_len > 0);
+
+  return !reader->discarding;
+}
+
+/* Reset a reader so it is ready for the next frame. */
+static void
+reset_frame_reader(frame_reader* reader)
+{
+  reader->frame_len = 0;
+  reader->have_len = false;
+  reader->scanned = 0;
+}
+
+bool
+framing_from_str(const char* name, framing* mode)
+{
+  if (strcmp(name, "newline") == 0) {
+    *mode = FRAMING_NEWLINE;
+    return true;
+  }
+
+  if (strcmp(name, "length") == 0) {
+    *mode = FRAMING_LENGTH;
+    return true;
+  }
+
+  return false;
+}
+
+void
+frame_reader_init(frame_reader* reader, framing mode)
+{
+  reader->mode = mode;
+  reader->discarding = false;
+  reader->discard_len = 0;
+  reader->tok = json_tokener_new();
+
+  if (reader->tok == NULL) {
+    err(1, "reader->tok malloc failed");
+  }
+
+  reset_frame_reader(reader);
+}
+
+frame_status
+next_frame(frame_reader* reader, struct evbuffer* input, size_t* frame_len)
+{
+  if (reader->mode == FRAMING_UNKNOWN && !sniff_framing(reader, input)) {
+    return FRAME_INCOMPLETE;
+  }
+
+  if (reader->discarding && !discard_frame(reader, input)) {
+    return FRAME_INCOMPLETE;
+  }
+
+  while (!reader->have_len) {
+    bool found = (reader->mode == FRAMING_LENGTH)
+                 ? read_frame_header(reader, input)
+                 : find_delimiter(reader, input);
+
+    if (!found) {
+      /* No delimiter within the size limit, drop everything up to it */
+      if (reader->scanned > MAX_FRAME_SIZE) {
+        evbuffer_drain(input, reader->scanned);
+        reset_frame_reader(reader);
+        reader->discarding = true;
+        return FRAME_TOO_LARGE;
+      }
+
+      return FRAME_INCOMPLETE;
+    }
+
+    /* Skip an empty frame, and its delimiter */
+    if (reader->frame_len == 0) {
+      if (reader->mode == FRAMING_NEWLINE) {
+        evbuffer_drain(input, 1);
+      }
+
+      reset_frame_reader(reader);
+    }
+  }
+
+  if (reader->frame_len > MAX_FRAME_SIZE) {
+    if (reader->mode == FRAMING_LENGTH) {
+      reader->discard_len = reader->frame_len;
+      reader->discarding = true;
+    }
+    else {
+      evbuffer_drain(input, reader->frame_len + 1);
+    }
+
+    reset_frame_reader(reader);
+    return FRAME_TOO_LARGE;
+  }
+
+  if (evbuffer_get_length(input) < reader->frame_len) {
+    return FRAME_INCOMPLETE;
+  }
+
+  *frame_len = reader->frame_len;
+
+  return FRAME_READY;
+}
+
+json_object*
+parse_frame(frame_reader* reader, struct evbuffer* input, size_t frame_len,
+            cmd_result* res)
+{
+  struct evbuffer_iovec extents[MAX_FRAME_EXTENTS];
+  int num_extents = 0;
+
+  enum json_tokener_error jerr = json_tokener_continue;
+  json_object* parse_obj = NULL;
+
+  if (frame_len > 0) {
+    num_extents = evbuffer_peek(input, (ev_ssize_t) frame_len, NULL,
+                                extents, MAX_FRAME_EXTENTS);
+
+    /* Linearise a frame scattered over too many chains */
+    if (num_extents > MAX_FRAME_EXTENTS) {
+      extents[0].iov_base = evbuffer_pullup(input, (ev_ssize_t) frame_len);
+      extents[0].iov_len = frame_len;
+      num_extents = 1;
+    }
+  }
+
+  json_tokener_reset(reader->tok);
+
+  /* Feed the tokener each extent in turn, as it is able to resume a
+   * parse across calls */
+  size_t remaining = frame_len;
+
+  for (int i = 0; i < num_extents && jerr == json_tokener_continue; ++i) {
+    size_t extent_len = (extents[i].iov_len < remaining) ? extents[i].iov_len
+                                                         : remaining;
+
+    parse_obj = json_tokener_parse_ex(reader->tok, extents[i].iov_base,
+                                      (int) extent_len);
+    jerr = json_tokener_get_error(reader->tok);
+    remaining -= extent_len;
+  }
+
+  /* Newline-delimited frames also end with their delimiter */
+  if (reader->mode == FRAMING_NEWLINE) {
+    frame_len += 1;
+  }
+
+  evbuffer_drain(input, frame_len);
+  reset_frame_reader(reader);
+
+  /* The frame ended part of the way through a JSON value */
+  if (jerr == json_tokener_continue) {
+    jerr = json_tokener_error_parse_eof;
+  }
+
+  /* Malformed JSON */
+  if (jerr != json_tokener_success) {
+    res->err = (int) jerr;
+    json_object_put(parse_obj);
+    return NULL;
+  }
+
+  return parse_obj;
+}
+
+size_t
+encode_frame_header(char* dest, framing mode, size_t payload_len)
+{
+  if (mode != FRAMING_LENGTH) {
+    return 0;
+  }
+
+  dest[0] = (char) (uint8_t) (payload_len >> 24);
+  dest[1] = (char) (uint8_t) (payload_len >> 16);
+  dest[2] = (char) (uint8_t) (payload_len >> 8);
+  dest[3] = (char) (uint8_t) payload_len;
+
+  return FRAME_HEADER_SIZE;
+}
+
+size_t
+encode_frame_trailer(char* dest, framing mode)
+{
+  if (mode != FRAMING_NEWLINE) {
+    return 0;
+  }
+
+  dest[0] = FRAME_DELIMITER;
+
+  return 1;
+}
+
+void
+free_frame_reader(frame_reader* reader)
+{
+  json_tokener_free(reader->tok);
+  reader->tok = NULL;
+}
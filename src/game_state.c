@@ -6,10 +6,9 @@
 
 #include "card_location.h"
 
-game_state* billionaire_game = NULL;
-
 game_state*
-game_state_new(int player_limit, bool has_billionaire, bool has_taxman)
+game_state_new(int player_limit, bool has_billionaire, bool has_taxman,
+               uint64_t seed, uint64_t stream)
 {
   game_state* new_game_state = malloc(sizeof(game_state));
 
@@ -20,20 +19,10 @@ game_state_new(int player_limit, bool has_billionaire, bool has_taxman)
   /* Initialise parameter values */
   new_game_state->num_players = 0;
   new_game_state->player_limit = player_limit;
-  new_game_state->running = false;
-
-  /* Initialise and shuffle deck */
-  card_location* unordered_deck = generate_deck(player_limit,
-                                                has_billionaire,
-                                                has_taxman);
-
-  new_game_state->deck = flatten_card_location(unordered_deck);
-
-  free_card_location(unordered_deck);
-
-  shuffle_card_array(new_game_state->deck);
 
-  new_game_state->current_trades = book_new();
+  /* The table's deck is shuffled at the start of every round */
+  new_game_state->table = engine_new((size_t) player_limit, has_billionaire,
+                                     has_taxman, seed, stream);
 
   return new_game_state;
 }
@@ -47,13 +36,12 @@ is_full(const game_state* gs_obj)
 bool
 is_running(const game_state* gs_obj)
 {
-  return gs_obj->running;
+  return gs_obj->table->running;
 }
 
 void
 game_state_free(game_state* gs_obj)
 {
-  free_card_array(gs_obj->deck);
-  free_book(gs_obj->current_trades);
+  free_engine(gs_obj->table);
   free(gs_obj);
 }
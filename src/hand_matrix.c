@@ -0,0 +1,422 @@
+#include "hand_matrix.h"
+
+#include <err.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAND_MATRIX_X86
+#include <immintrin.h>
+#endif
+
+/* Amount of one commodity, wildcards included, that wins the round */
+#define WIN_AMOUNT (TOTAL_COMMODITY_AMOUNT + 1)
+
+hand_matrix*
+hand_matrix_new(size_t num_seats)
+{
+  hand_matrix* new_matrix = malloc(sizeof(hand_matrix));
+
+  if (new_matrix == NULL) {
+    err(1, "new_matrix malloc failed");
+  }
+
+  new_matrix->num_seats = num_seats;
+  new_matrix->stride = (num_seats + HAND_MATRIX_ALIGN - 1)/HAND_MATRIX_ALIGN
+                       *HAND_MATRIX_ALIGN;
+
+  /* An empty matrix still gets one padded row per card type */
+  if (new_matrix->stride == 0) {
+    new_matrix->stride = HAND_MATRIX_ALIGN;
+  }
+
+  new_matrix->counts = aligned_alloc(HAND_MATRIX_ALIGN,
+                                     TOTAL_UNIQUE_CARDS*new_matrix->stride);
+
+  if (new_matrix->counts == NULL) {
+    err(1, "new_matrix->counts aligned_alloc failed");
+  }
+
+  clear_hand_matrix(new_matrix);
+
+  return new_matrix;
+}
+
+void
+set_hand_matrix_seat(hand_matrix* matrix, size_t seat,
+                     const card_location* hand)
+{
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    matrix->counts[card*matrix->stride + seat] =
+      (uint8_t) get_card_amount(hand, card);
+  }
+}
+
+uint8_t
+get_hand_matrix_count(const hand_matrix* matrix, size_t seat, card_id card)
+{
+  return matrix->counts[card*matrix->stride + seat];
+}
+
+void
+clear_hand_matrix(hand_matrix* matrix)
+{
+  memset(matrix->counts, 0, TOTAL_UNIQUE_CARDS*matrix->stride);
+}
+
+/* Copy the results of a group of seats evaluated together to whichever
+   outputs were asked for. */
+static void
+store_lanes(const hand_matrix* matrix, size_t seat, size_t num_lanes,
+            const uint8_t* won_lanes, const int16_t* score_lanes,
+            bool* won, int* scores)
+{
+  /* Lanes past the last seat only hold padding */
+  if (num_lanes > matrix->num_seats - seat) {
+    num_lanes = matrix->num_seats - seat;
+  }
+
+  for (size_t i = 0; i < num_lanes; ++i) {
+    if (won != NULL) {
+      won[seat + i] = (won_lanes[i] != 0);
+    }
+
+    if (scores != NULL) {
+      scores[seat + i] = score_lanes[i];
+    }
+  }
+}
+
+/* Evaluate every seat one at a time. */
+static void
+evaluate_hands_scalar(const hand_matrix* matrix, bool* won, int* scores)
+{
+  const uint8_t* counts = matrix->counts;
+  size_t stride = matrix->stride;
+
+  for (size_t seat = 0; seat < matrix->num_seats; ++seat) {
+    uint8_t billionaire = counts[BILLIONAIRE*stride + seat];
+    uint8_t taxman = counts[TAX_COLLECTOR*stride + seat];
+    int wildcards = billionaire + taxman;
+
+    bool any_won = false;
+    int score = (taxman > 0) ? card_values[TAX_COLLECTOR] : 0;
+
+    for (card_id comm = DIAMONDS; comm < TOTAL_COMMODITY_AMOUNT; ++comm) {
+      if (counts[comm*stride + seat] + wildcards >= WIN_AMOUNT) {
+        any_won = true;
+        score += card_values[comm];
+      }
+    }
+
+    if (won != NULL) {
+      won[seat] = any_won;
+    }
+
+    if (scores != NULL) {
+      scores[seat] = (billionaire > 0) ? 2*score : score;
+    }
+  }
+}
+
+#ifdef HAND_MATRIX_X86
+
+/* Sign extend the 16-bit scores in the low or high half of a vector to
+   32-bit ints. */
+static inline __m128i
+extend_lo_sse2(__m128i scores)
+{
+  return _mm_srai_epi32(_mm_unpacklo_epi16(scores, scores), 16);
+}
+
+static inline __m128i
+extend_hi_sse2(__m128i scores)
+{
+  return _mm_srai_epi32(_mm_unpackhi_epi16(scores, scores), 16);
+}
+
+/* Evaluate every seat, 16 seats at a time.
+ *
+ * Each byte lane holds one seat, and rows are padded to a whole number
+ * of vectors with empty hands. A commodity wins for a seat when its
+ * count plus the seat's wildcards is at least WIN_AMOUNT, and the score
+ * of each winning commodity is accumulated in 16-bit lanes. */
+static void
+evaluate_hands_sse2(const hand_matrix* matrix, bool* won, int* scores)
+{
+  const uint8_t* counts = matrix->counts;
+  size_t stride = matrix->stride;
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i win_amount = _mm_set1_epi8(WIN_AMOUNT);
+  const __m128i taxman_value =
+    _mm_set1_epi16((short) card_values[TAX_COLLECTOR]);
+
+  for (size_t seat = 0; seat < matrix->num_seats; seat += 16) {
+    const uint8_t* column = counts + seat;
+
+    __m128i billionaire =
+      _mm_load_si128((const __m128i*) (column + BILLIONAIRE*stride));
+    __m128i taxman =
+      _mm_load_si128((const __m128i*) (column + TAX_COLLECTOR*stride));
+    __m128i wildcards = _mm_adds_epu8(billionaire, taxman);
+
+    __m128i any_won = zero;
+    __m128i score_lo = zero;
+    __m128i score_hi = zero;
+
+    for (card_id comm = DIAMONDS; comm < TOTAL_COMMODITY_AMOUNT; ++comm) {
+      __m128i comm_amt =
+        _mm_load_si128((const __m128i*) (column + comm*stride));
+      __m128i total = _mm_adds_epu8(comm_amt, wildcards);
+
+      /* total >= win_amount, as unsigned bytes */
+      __m128i hit = _mm_cmpeq_epi8(_mm_max_epu8(total, win_amount), total);
+      __m128i value = _mm_set1_epi16((short) card_values[comm]);
+
+      /* Widen the seats in each half of hit to 16-bit masks */
+      __m128i hit_lo = _mm_unpacklo_epi8(hit, hit);
+      __m128i hit_hi = _mm_unpackhi_epi8(hit, hit);
+
+      any_won = _mm_or_si128(any_won, hit);
+      score_lo = _mm_add_epi16(score_lo, _mm_and_si128(hit_lo, value));
+      score_hi = _mm_add_epi16(score_hi, _mm_and_si128(hit_hi, value));
+    }
+
+    /* Subtract points from seats holding TAX_COLLECTOR */
+    __m128i no_taxman = _mm_cmpeq_epi8(taxman, zero);
+    __m128i no_taxman_lo = _mm_unpacklo_epi8(no_taxman, no_taxman);
+    __m128i no_taxman_hi = _mm_unpackhi_epi8(no_taxman, no_taxman);
+
+    score_lo = _mm_add_epi16(score_lo,
+                             _mm_andnot_si128(no_taxman_lo, taxman_value));
+    score_hi = _mm_add_epi16(score_hi,
+                             _mm_andnot_si128(no_taxman_hi, taxman_value));
+
+    /* Double the score of seats holding BILLIONAIRE */
+    __m128i no_billionaire = _mm_cmpeq_epi8(billionaire, zero);
+    __m128i no_billionaire_lo = _mm_unpacklo_epi8(no_billionaire,
+                                                  no_billionaire);
+    __m128i no_billionaire_hi = _mm_unpackhi_epi8(no_billionaire,
+                                                  no_billionaire);
+
+    score_lo = _mm_add_epi16(score_lo,
+                             _mm_andnot_si128(no_billionaire_lo, score_lo));
+    score_hi = _mm_add_epi16(score_hi,
+                             _mm_andnot_si128(no_billionaire_hi, score_hi));
+
+    /* Whole groups of seats are written straight to the outputs */
+    if (seat + 16 <= matrix->num_seats) {
+      if (won != NULL) {
+        _mm_storeu_si128((__m128i*) (won + seat),
+                         _mm_and_si128(any_won, _mm_set1_epi8(1)));
+      }
+
+      if (scores != NULL) {
+        /* Sign extend each score to an int */
+        __m128i* score_out = (__m128i*) (scores + seat);
+
+        _mm_storeu_si128(score_out, extend_lo_sse2(score_lo));
+        _mm_storeu_si128(score_out + 1, extend_hi_sse2(score_lo));
+        _mm_storeu_si128(score_out + 2, extend_lo_sse2(score_hi));
+        _mm_storeu_si128(score_out + 3, extend_hi_sse2(score_hi));
+      }
+
+      continue;
+    }
+
+    uint8_t won_lanes[16];
+    int16_t score_lanes[16];
+
+    _mm_storeu_si128((__m128i*) won_lanes, any_won);
+    _mm_storeu_si128((__m128i*) score_lanes, score_lo);
+    _mm_storeu_si128((__m128i*) (score_lanes + 8), score_hi);
+
+    store_lanes(matrix, seat, 16, won_lanes, score_lanes, won, scores);
+  }
+}
+
+/* Widen the byte masks in the low or high half of a vector to 16-bit
+   masks, keeping the seats in order. */
+__attribute__((target("avx2")))
+static inline __m256i
+widen_lo_avx2(__m256i mask)
+{
+  return _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mask));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+widen_hi_avx2(__m256i mask)
+{
+  return _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mask, 1));
+}
+
+/* Sign extend the 16-bit scores in the low or high half of a vector to
+   32-bit ints. */
+__attribute__((target("avx2")))
+static inline __m256i
+extend_lo_avx2(__m256i scores)
+{
+  return _mm256_cvtepi16_epi32(_mm256_castsi256_si128(scores));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+extend_hi_avx2(__m256i scores)
+{
+  return _mm256_cvtepi16_epi32(_mm256_extracti128_si256(scores, 1));
+}
+
+/* Evaluate every seat, 32 seats at a time.
+ *
+ * This is evaluate_hands_sse2() on 256-bit vectors. */
+__attribute__((target("avx2")))
+static void
+evaluate_hands_avx2(const hand_matrix* matrix, bool* won, int* scores)
+{
+  const uint8_t* counts = matrix->counts;
+  size_t stride = matrix->stride;
+
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i win_amount = _mm256_set1_epi8(WIN_AMOUNT);
+  const __m256i taxman_value =
+    _mm256_set1_epi16((short) card_values[TAX_COLLECTOR]);
+
+  for (size_t seat = 0; seat < matrix->num_seats; seat += 32) {
+    const uint8_t* column = counts + seat;
+
+    __m256i billionaire =
+      _mm256_load_si256((const __m256i*) (column + BILLIONAIRE*stride));
+    __m256i taxman =
+      _mm256_load_si256((const __m256i*) (column + TAX_COLLECTOR*stride));
+    __m256i wildcards = _mm256_adds_epu8(billionaire, taxman);
+
+    __m256i any_won = zero;
+    __m256i score_lo = zero;
+    __m256i score_hi = zero;
+
+    for (card_id comm = DIAMONDS; comm < TOTAL_COMMODITY_AMOUNT; ++comm) {
+      __m256i comm_amt =
+        _mm256_load_si256((const __m256i*) (column + comm*stride));
+      __m256i total = _mm256_adds_epu8(comm_amt, wildcards);
+
+      /* total >= win_amount, as unsigned bytes */
+      __m256i hit = _mm256_cmpeq_epi8(_mm256_max_epu8(total, win_amount),
+                                      total);
+      __m256i value = _mm256_set1_epi16((short) card_values[comm]);
+
+      any_won = _mm256_or_si256(any_won, hit);
+      score_lo = _mm256_add_epi16(score_lo,
+                                  _mm256_and_si256(widen_lo_avx2(hit), value));
+      score_hi = _mm256_add_epi16(score_hi,
+                                  _mm256_and_si256(widen_hi_avx2(hit), value));
+    }
+
+    /* Subtract points from seats holding TAX_COLLECTOR */
+    __m256i no_taxman = _mm256_cmpeq_epi8(taxman, zero);
+
+    score_lo = _mm256_add_epi16(score_lo,
+                                _mm256_andnot_si256(widen_lo_avx2(no_taxman),
+                                                    taxman_value));
+    score_hi = _mm256_add_epi16(score_hi,
+                                _mm256_andnot_si256(widen_hi_avx2(no_taxman),
+                                                    taxman_value));
+
+    /* Double the score of seats holding BILLIONAIRE */
+    __m256i no_billionaire = _mm256_cmpeq_epi8(billionaire, zero);
+
+    score_lo = _mm256_add_epi16(score_lo,
+                                _mm256_andnot_si256(widen_lo_avx2(no_billionaire),
+                                                    score_lo));
+    score_hi = _mm256_add_epi16(score_hi,
+                                _mm256_andnot_si256(widen_hi_avx2(no_billionaire),
+                                                    score_hi));
+
+    /* Whole groups of seats are written straight to the outputs */
+    if (seat + 32 <= matrix->num_seats) {
+      if (won != NULL) {
+        _mm256_storeu_si256((__m256i*) (won + seat),
+                            _mm256_and_si256(any_won, _mm256_set1_epi8(1)));
+      }
+
+      if (scores != NULL) {
+        /* Sign extend each score to an int */
+        __m256i* score_out = (__m256i*) (scores + seat);
+
+        _mm256_storeu_si256(score_out, extend_lo_avx2(score_lo));
+        _mm256_storeu_si256(score_out + 1, extend_hi_avx2(score_lo));
+        _mm256_storeu_si256(score_out + 2, extend_lo_avx2(score_hi));
+        _mm256_storeu_si256(score_out + 3, extend_hi_avx2(score_hi));
+      }
+
+      continue;
+    }
+
+    uint8_t won_lanes[32];
+    int16_t score_lanes[32];
+
+    _mm256_storeu_si256((__m256i*) won_lanes, any_won);
+    _mm256_storeu_si256((__m256i*) score_lanes, score_lo);
+    _mm256_storeu_si256((__m256i*) (score_lanes + 16), score_hi);
+
+    store_lanes(matrix, seat, 32, won_lanes, score_lanes, won, scores);
+  }
+}
+
+#endif /* HAND_MATRIX_X86 */
+
+bool
+hand_kernel_supported(hand_kernel kernel)
+{
+  switch (kernel) {
+  case HAND_KERNEL_AUTO:
+  case HAND_KERNEL_SCALAR:
+    return true;
+#ifdef HAND_MATRIX_X86
+  case HAND_KERNEL_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case HAND_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif /* HAND_MATRIX_X86 */
+  default:
+    return false;
+  }
+}
+
+void
+evaluate_hand_matrix(const hand_matrix* matrix, bool* won, int* scores)
+{
+  evaluate_hand_matrix_with(matrix, HAND_KERNEL_AUTO, won, scores);
+}
+
+void
+evaluate_hand_matrix_with(const hand_matrix* matrix, hand_kernel kernel,
+                          bool* won, int* scores)
+{
+  if (kernel == HAND_KERNEL_AUTO) {
+    kernel = hand_kernel_supported(HAND_KERNEL_AVX2) ? HAND_KERNEL_AVX2
+           : hand_kernel_supported(HAND_KERNEL_SSE2) ? HAND_KERNEL_SSE2
+           : HAND_KERNEL_SCALAR;
+  }
+
+  switch (kernel) {
+#ifdef HAND_MATRIX_X86
+  case HAND_KERNEL_AVX2:
+    evaluate_hands_avx2(matrix, won, scores);
+    break;
+  case HAND_KERNEL_SSE2:
+    evaluate_hands_sse2(matrix, won, scores);
+    break;
+#endif /* HAND_MATRIX_X86 */
+  default:
+    evaluate_hands_scalar(matrix, won, scores);
+    break;
+  }
+}
+
+void
+free_hand_matrix(hand_matrix* matrix)
+{
+  free(matrix->counts);
+  free(matrix);
+}
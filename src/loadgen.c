@@ -0,0 +1,1120 @@
+/*
+ * A load generator for billionaire-server, playing thousands of seats
+ * over real connections from a single event loop and measuring how
+ * quickly the server answers them.
+ */
+
+/* For getopt_long() and clock_gettime() */
+#define _DEFAULT_SOURCE
+
+#include "loadgen.h"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+#include <err.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h> /* clock(), time() */
+#include <unistd.h> /* getpid() */
+
+#include <event2/buffer.h>
+
+#include "command.h"
+#include "command_error.h"
+#include "utils.h"
+
+/* Return the time in nanoseconds from an arbitrary starting point */
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec*1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/* Offer some of a commodity chosen at random from those held at least
+   OFFER_MIN_CARDS times, other than keep */
+static bool
+offer_random_commodity(const card_location* hand, rng* rng_obj, card_id keep,
+                       card_location* offer)
+{
+  card_id choices[TOTAL_COMMODITY_AMOUNT];
+  size_t num_choices = 0;
+
+  for (card_id card = DIAMONDS; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (card != keep && get_card_amount(hand, card) >= OFFER_MIN_CARDS) {
+      choices[num_choices++] = card;
+    }
+  }
+
+  if (num_choices == 0) {
+    return false;
+  }
+
+  card_id card = choices[rng_bounded(rng_obj, (uint32_t) num_choices)];
+  size_t max_amt = get_card_amount(hand, card);
+
+  if (max_amt > OFFER_MAX_CARDS) {
+    max_amt = OFFER_MAX_CARDS;
+  }
+
+  clear_card_location(offer);
+  add_cards_to_location(offer, card, OFFER_MIN_CARDS +
+                        rng_bounded(rng_obj,
+                                    (uint32_t) (max_amt - OFFER_MIN_CARDS + 1)));
+
+  return true;
+}
+
+/* Offer any commodity */
+static bool
+random_choose(const card_location* hand, rng* rng_obj, card_location* offer)
+{
+  return offer_random_commodity(hand, rng_obj, TOTAL_COMMODITY_AMOUNT, offer);
+}
+
+/* Work towards a set of the commodity held most, only rarely giving it
+   up to break up hands of singles */
+static bool
+collector_choose(const card_location* hand, rng* rng_obj,
+                 card_location* offer)
+{
+  card_id most = DIAMONDS;
+
+  for (card_id card = GOLD; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (get_card_amount(hand, card) > get_card_amount(hand, most)) {
+      most = card;
+    }
+  }
+
+  if (rng_bounded(rng_obj, 8) == 0) {
+    most = TOTAL_COMMODITY_AMOUNT;
+  }
+
+  return offer_random_commodity(hand, rng_obj, most, offer);
+}
+
+static const loadgen_strategy strategies[] = {
+  {"random", random_choose},
+  {"collector", collector_choose}
+};
+
+const loadgen_strategy*
+find_loadgen_strategy(const char* name)
+{
+  for (size_t i = 0; i < sizeof(strategies)/sizeof(loadgen_strategy); ++i) {
+    if (strcmp(strategies[i].name, name) == 0) {
+      return &strategies[i];
+    }
+  }
+
+  return NULL;
+}
+
+void
+hist_record(loadgen_hist* hist, uint64_t value_ns)
+{
+  size_t bucket = (size_t) value_ns;
+
+  if (value_ns >= LOADGEN_HIST_SUB) {
+    int shift = 63 - __builtin_clzll(value_ns) - LOADGEN_HIST_SUB_BITS;
+
+    bucket = (size_t) (shift + 1)*LOADGEN_HIST_SUB +
+      (size_t) ((value_ns >> shift) & (LOADGEN_HIST_SUB - 1));
+  }
+
+  hist->counts[bucket]++;
+  hist->count++;
+  hist->sum += value_ns;
+
+  if (value_ns > hist->max) {
+    hist->max = value_ns;
+  }
+}
+
+uint64_t
+hist_percentile(const loadgen_hist* hist, double fraction)
+{
+  if (hist->count == 0) {
+    return 0;
+  }
+
+  /* The rank of the sample wanted, counting from 1 */
+  double exact_rank = fraction*(double) hist->count;
+  uint64_t rank = (uint64_t) exact_rank;
+  uint64_t seen = 0;
+
+  if (rank < 1 || (double) rank < exact_rank) {
+    rank++;
+  }
+
+  for (size_t bucket = 0; bucket < LOADGEN_HIST_BUCKETS; ++bucket) {
+    seen += hist->counts[bucket];
+
+    if (seen < rank) {
+      continue;
+    }
+
+    /* Report the top of the bucket, which no sample in it exceeds */
+    uint64_t top = bucket;
+
+    if (bucket >= LOADGEN_HIST_SUB) {
+      int shift = (int) (bucket/LOADGEN_HIST_SUB) - 1;
+
+      top = (((uint64_t) (LOADGEN_HIST_SUB + bucket%LOADGEN_HIST_SUB) + 1)
+             << shift) - 1;
+    }
+
+    return (top < hist->max) ? top : hist->max;
+  }
+
+  return hist->max;
+}
+
+/* Return the slot holding an ID, or the empty slot it would go in */
+static loadgen_slot*
+find_slot(loadgen* lg, uint32_t id)
+{
+  size_t i = id & lg->slot_mask;
+
+  while (lg->slots[i].conn != NULL && lg->slots[i].id != id) {
+    i = (i + 1) & lg->slot_mask;
+  }
+
+  return &lg->slots[i];
+}
+
+/* Remove a connection from the ID table, moving back any later slots
+   that would otherwise no longer be found */
+static void
+remove_slot(loadgen* lg, loadgen_conn* conn)
+{
+  loadgen_slot* slot = find_slot(lg, conn->id);
+
+  if (slot->conn != conn) {
+    return;
+  }
+
+  size_t hole = (size_t) (slot - lg->slots);
+  size_t i = hole;
+
+  lg->slots[hole].conn = NULL;
+
+  while (true) {
+    i = (i + 1) & lg->slot_mask;
+
+    if (lg->slots[i].conn == NULL) {
+      return;
+    }
+
+    size_t home = lg->slots[i].id & lg->slot_mask;
+
+    /* The slot can only move back if its home is not after the hole */
+    if (((i - home) & lg->slot_mask) >= ((i - hole) & lg->slot_mask)) {
+      lg->slots[hole] = lg->slots[i];
+      lg->slots[i].conn = NULL;
+      hole = i;
+    }
+  }
+}
+
+/* Frame a command packet and queue it on a connection */
+static void
+send_packet(loadgen_conn* conn, const char* payload, size_t payload_len)
+{
+  framing mode = conn->owner->options->mode;
+  char header[FRAME_HEADER_SIZE];
+  char trailer[1];
+
+  size_t header_len = encode_frame_header(header, mode, payload_len);
+  size_t trailer_len = encode_frame_trailer(trailer, mode);
+
+  struct evbuffer* output = bufferevent_get_output(conn->bev);
+
+  evbuffer_add(output, header, header_len);
+  evbuffer_add(output, payload, payload_len);
+  evbuffer_add(output, trailer, trailer_len);
+
+  conn->owner->stats.bytes_sent += header_len + payload_len + trailer_len;
+}
+
+static void
+send_new_offer(loadgen_conn* conn, const card_location* offer)
+{
+  char payload[LOADGEN_PACKET_MAX_LEN];
+  size_t len = 0;
+
+  len += (size_t) sprintf(payload, PACKET_OPEN
+                          "{\"command\":\"%s\",\"cards\":",
+                          Command.NEW_OFFER);
+  len += encode_card_location(payload + len, offer);
+  len += (size_t) sprintf(payload + len, "}" PACKET_CLOSE);
+
+  send_packet(conn, payload, len);
+
+  /* The cards are out of the hand until they are traded or returned */
+  cmd_result res = CMD_RESULT_INIT;
+  subtract_card_location(&conn->hand, offer, &res);
+
+  conn->resting_amt = get_total_cards(offer);
+  conn->offer_pending = true;
+  conn->offer_ns = now_ns();
+  conn->owner->stats.offers_sent++;
+}
+
+static void
+send_cancel_offer(loadgen_conn* conn)
+{
+  char payload[LOADGEN_PACKET_MAX_LEN];
+
+  size_t len = (size_t) sprintf(payload, PACKET_OPEN
+                                "{\"command\":\"%s\",\"card_amt\":%zu}"
+                                PACKET_CLOSE,
+                                Command.CANCEL_OFFER, conn->resting_amt);
+
+  send_packet(conn, payload, len);
+
+  conn->cancel_pending = true;
+  conn->owner->stats.cancels_sent++;
+}
+
+/* Give a connection its chance to act: take back its offer on the book
+   now and then, otherwise put a new one up */
+static void
+on_act(evutil_socket_t fd, short ev, void* arg)
+{
+  (void) fd;
+  (void) ev;
+
+  loadgen_conn* conn = (loadgen_conn*) arg;
+
+  if (!conn->playing || conn->offer_pending || conn->cancel_pending) {
+    return;
+  }
+
+  if (conn->resting_amt > 0) {
+    if (rng_bounded(&conn->rng_obj, 4) == 0) {
+      send_cancel_offer(conn);
+    }
+
+    return;
+  }
+
+  card_location offer;
+
+  if (conn->owner->options->strategy->choose(&conn->hand, &conn->rng_obj,
+                                             &offer)) {
+    send_new_offer(conn, &offer);
+  }
+}
+
+static void open_conn(loadgen_conn* conn);
+
+static void
+on_retry(evutil_socket_t fd, short ev, void* arg)
+{
+  (void) fd;
+  (void) ev;
+
+  loadgen_conn* conn = (loadgen_conn*) arg;
+
+  if (conn->owner->running && conn->bev == NULL) {
+    open_conn(conn);
+  }
+}
+
+/* Close a connection, opening it again after retry_secs if the run is
+   still going */
+static void
+close_conn(loadgen_conn* conn, int retry_secs)
+{
+  loadgen* lg = conn->owner;
+
+  if (conn->joined) {
+    remove_slot(lg, conn);
+  }
+
+  evtimer_del(conn->act_ev);
+  bufferevent_free(conn->bev);
+  free_frame_reader(&conn->reader);
+
+  conn->bev = NULL;
+
+  if (!lg->running) {
+    return;
+  }
+
+  if (retry_secs == 0) {
+    open_conn(conn);
+    return;
+  }
+
+  struct timeval retry_tv = {retry_secs, 0};
+  event_base_once(lg->evbase, -1, EV_TIMEOUT, on_retry, conn, &retry_tv);
+}
+
+/* Settle a connection's outstanding offer, if it has one */
+static void
+answer_offer(loadgen_conn* conn, loadgen_hist* hist)
+{
+  if (conn->offer_pending) {
+    hist_record(hist, now_ns() - conn->offer_ns);
+    conn->offer_pending = false;
+  }
+}
+
+/* Forget anything on the book between rounds */
+static void
+reset_round(loadgen_conn* conn)
+{
+  conn->playing = false;
+  conn->resting_amt = 0;
+  conn->offer_pending = false;
+  conn->cancel_pending = false;
+}
+
+static void
+read_cards(json_object* cmd, const char* key, card_location* cards,
+           cmd_result* res)
+{
+  json_object* cards_json = get_JSON_value(cmd, key, res);
+
+  if (cmd_failed(res)) {
+    clear_card_location(cards);
+    return;
+  }
+
+  read_card_location_JSON(cards, cards_json, res);
+}
+
+/* Act on a command from the server. Returns false if the connection
+   has been closed */
+static bool
+handle_command(loadgen_conn* conn, json_object* cmd)
+{
+  loadgen* lg = conn->owner;
+  cmd_result res = CMD_RESULT_INIT;
+  size_t name_len = 0;
+  const char* name = get_command_name(cmd, &name_len, &res);
+
+  if (cmd_failed(&res)) {
+    lg->stats.bad_packets++;
+    return true;
+  }
+
+  lg->stats.commands_received++;
+
+  if (strcmp(name, Command.BOOK_EVENT) == 0) {
+    json_object* event_json = get_JSON_value(cmd, "event", &res);
+    json_object* participants = get_JSON_value(cmd, "participants", &res);
+
+    if (cmd_failed(&res) ||
+        !json_object_is_type(participants, json_type_array) ||
+        json_object_array_length(participants) == 0) {
+      lg->stats.bad_packets++;
+      return true;
+    }
+
+    /* The first participant is the one whose offer caused the event */
+    const char* event = json_object_get_string(event_json);
+    const char* owner_str =
+      json_object_get_string(json_object_array_get_idx(participants, 0));
+    uint32_t owner_id = (uint32_t) strtoul(owner_str, NULL, 16);
+    loadgen_conn* owner = find_slot(lg, owner_id)->conn;
+
+    if (owner == NULL) {
+      return true;
+    }
+
+    if (strcmp(event, Command.SUCCESSFUL_TRADE) == 0) {
+      answer_offer(owner, &lg->stats.offer_trade);
+    }
+    else if (strcmp(event, Command.NEW_OFFER) == 0) {
+      answer_offer(owner, &lg->stats.offer_book);
+    }
+  }
+
+  else if (strcmp(name, Command.SUCCESSFUL_TRADE) == 0) {
+    card_location cards;
+    read_cards(cmd, "cards", &cards, &res);
+    merge_card_location(&conn->hand, &cards);
+
+    /* Whichever offer traded, it was the connection's only one */
+    conn->resting_amt = 0;
+    answer_offer(conn, &lg->stats.offer_trade);
+    lg->stats.fills++;
+  }
+
+  else if (strcmp(name, Command.CANCELLED_OFFER) == 0) {
+    card_location cards;
+    read_cards(cmd, "cards", &cards, &res);
+
+    /* An offer sent before a round ended can be turned down once the
+       next has been dealt, when its cards are no longer part of the
+       hand */
+    if (conn->resting_amt > 0) {
+      merge_card_location(&conn->hand, &cards);
+    }
+
+    conn->resting_amt = 0;
+    conn->cancel_pending = false;
+  }
+
+  else if (strcmp(name, Command.START) == 0) {
+    reset_round(conn);
+    read_cards(cmd, "hand", &conn->hand, &res);
+    conn->playing = true;
+
+    if (conn->awaiting_start) {
+      hist_record(&lg->stats.connect_start, now_ns() - conn->connect_ns);
+      conn->awaiting_start = false;
+    }
+  }
+
+  else if (strcmp(name, Command.JOIN) == 0) {
+    json_object* id_json = get_JSON_value(cmd, "client_id", &res);
+
+    if (cmd_failed(&res)) {
+      lg->stats.bad_packets++;
+      return true;
+    }
+
+    conn->id = (uint32_t) strtoul(json_object_get_string(id_json), NULL, 16);
+
+    loadgen_slot* slot = find_slot(lg, conn->id);
+    slot->id = conn->id;
+    slot->conn = conn;
+
+    conn->joined = true;
+  }
+
+  else if (strcmp(name, Command.END_ROUND) == 0) {
+    reset_round(conn);
+    lg->stats.round_ends++;
+  }
+
+  else if (strcmp(name, Command.END_GAME) == 0) {
+    /* Join a new table straight away */
+    lg->stats.game_ends++;
+    close_conn(conn, 0);
+    return false;
+  }
+
+  else if (strcmp(name, Command.ERROR) == 0) {
+    conn->offer_pending = false;
+    conn->cancel_pending = false;
+    lg->stats.errors++;
+  }
+
+  return true;
+}
+
+static void
+on_read(struct bufferevent* bev, void* arg)
+{
+  loadgen_conn* conn = (loadgen_conn*) arg;
+  loadgen* lg = conn->owner;
+  struct evbuffer* input = bufferevent_get_input(bev);
+
+  size_t frame_len = 0;
+  frame_status status;
+
+  lg->stats.bytes_received += evbuffer_get_length(input);
+
+  while ((status = next_frame(&conn->reader, input, &frame_len)) !=
+         FRAME_INCOMPLETE) {
+    cmd_result res = CMD_RESULT_INIT;
+
+    if (status == FRAME_TOO_LARGE) {
+      lg->stats.bad_packets++;
+      continue;
+    }
+
+    json_object* packet = parse_frame(&conn->reader, input, frame_len, &res);
+    json_object* cmd_array = parse_command_list(packet, &res);
+
+    if (cmd_failed(&res)) {
+      lg->stats.bad_packets++;
+      continue;
+    }
+
+    bool open = true;
+
+    JSON_ARRAY_FOREACH(cmd_obj, cmd_array) {
+      if (!(open = handle_command(conn, cmd_obj))) {
+        break;
+      }
+    }
+
+    json_object_put(cmd_array);
+
+    if (!open) {
+      return;
+    }
+  }
+
+  /* Bytes of a partial frame are counted again when the rest arrives */
+  lg->stats.bytes_received -= evbuffer_get_length(input);
+}
+
+static void
+on_event(struct bufferevent* bev, short what, void* arg)
+{
+  loadgen_conn* conn = (loadgen_conn*) arg;
+  loadgen* lg = conn->owner;
+
+  if (what & BEV_EVENT_CONNECTED) {
+    int one = 1;
+    setsockopt(bufferevent_getfd(bev), IPPROTO_TCP, TCP_NODELAY, &one,
+               sizeof(one));
+
+    /* An empty packet sets the connection's framing before the server
+       sends it anything */
+    send_packet(conn, "", 0);
+
+    lg->stats.connects++;
+    return;
+  }
+
+  if (conn->awaiting_start && !conn->joined) {
+    lg->stats.connect_failures++;
+  }
+  else {
+    lg->stats.disconnects++;
+  }
+
+  close_conn(conn, LOADGEN_RETRY_SECS);
+}
+
+static void
+open_conn(loadgen_conn* conn)
+{
+  loadgen* lg = conn->owner;
+
+  conn->bev = bufferevent_socket_new(lg->evbase, -1, BEV_OPT_CLOSE_ON_FREE);
+
+  if (conn->bev == NULL) {
+    errx(1, "failed to create connection %zu", conn->index);
+  }
+
+  frame_reader_init(&conn->reader, lg->options->mode);
+
+  conn->joined = false;
+  conn->awaiting_start = true;
+  conn->connect_ns = now_ns();
+  clear_card_location(&conn->hand);
+  reset_round(conn);
+
+  bufferevent_setcb(conn->bev, on_read, NULL, on_event, conn);
+  bufferevent_enable(conn->bev, EV_READ | EV_WRITE);
+
+  /* A failure is reported to on_event(), which retries */
+  bufferevent_socket_connect(conn->bev, (struct sockaddr*) &lg->addr,
+                             sizeof(lg->addr));
+
+  evtimer_add(conn->act_ev, lg->think_tv);
+}
+
+static void
+on_done(evutil_socket_t fd, short ev, void* arg)
+{
+  (void) fd;
+  (void) ev;
+
+  event_base_loopbreak((struct event_base*) arg);
+}
+
+loadgen*
+loadgen_new(const loadgen_options* options)
+{
+  loadgen* new_lg = malloc(sizeof(loadgen));
+
+  if (new_lg == NULL) {
+    err(1, "new_lg malloc failed");
+  }
+
+  memset(new_lg, 0, sizeof(loadgen));
+
+  new_lg->options = options;
+  new_lg->num_conns = options->num_tables*options->num_players;
+
+  new_lg->addr.sin_family = AF_INET;
+  new_lg->addr.sin_port = htons((uint16_t) options->port);
+
+  if (inet_pton(AF_INET, options->host, &new_lg->addr.sin_addr) != 1) {
+    errx(1, "'%s' is not an IPv4 address", options->host);
+  }
+
+  new_lg->evbase = event_base_new();
+
+  if (new_lg->evbase == NULL) {
+    errx(1, "event_base_new failed");
+  }
+
+  /* Every act timer has the same timeout, so libevent can keep them in
+     a queue rather than its heap */
+  struct timeval think_tv = {options->think_ms/1000,
+                             (options->think_ms%1000)*1000};
+  new_lg->think_tv = event_base_init_common_timeout(new_lg->evbase,
+                                                    &think_tv);
+
+  new_lg->conns = calloc(new_lg->num_conns, sizeof(loadgen_conn));
+
+  if (new_lg->conns == NULL) {
+    err(1, "conns malloc failed");
+  }
+
+  size_t num_slots = 1;
+
+  while (num_slots < 2*new_lg->num_conns) {
+    num_slots <<= 1;
+  }
+
+  new_lg->slots = calloc(num_slots, sizeof(loadgen_slot));
+  new_lg->slot_mask = num_slots - 1;
+
+  if (new_lg->slots == NULL) {
+    err(1, "slots malloc failed");
+  }
+
+  for (size_t i = 0; i < new_lg->num_conns; ++i) {
+    loadgen_conn* conn = &new_lg->conns[i];
+
+    conn->owner = new_lg;
+    conn->index = i;
+    conn->act_ev = event_new(new_lg->evbase, -1, EV_PERSIST, on_act, conn);
+
+    rng_init(&conn->rng_obj, options->seed, i);
+  }
+
+  return new_lg;
+}
+
+void
+run_loadgen(loadgen* lg)
+{
+  struct event* done_ev = evtimer_new(lg->evbase, on_done, lg->evbase);
+  struct event* int_ev = evsignal_new(lg->evbase, SIGINT, on_done,
+                                      lg->evbase);
+  struct timeval duration_tv = {lg->options->duration, 0};
+
+  evtimer_add(done_ev, &duration_tv);
+  evsignal_add(int_ev, NULL);
+
+  lg->running = true;
+
+  for (size_t i = 0; i < lg->num_conns; ++i) {
+    open_conn(&lg->conns[i]);
+  }
+
+  event_base_dispatch(lg->evbase);
+
+  lg->running = false;
+
+  event_free(int_ev);
+  event_free(done_ev);
+}
+
+/* Return a latency in microseconds */
+static double
+to_us(uint64_t value_ns)
+{
+  return (double) value_ns*1e-3;
+}
+
+static double
+hist_mean(const loadgen_hist* hist)
+{
+  return (hist->count > 0) ? (double) hist->sum/(double) hist->count : 0.0;
+}
+
+static const struct {
+  const char* name;
+  size_t offset;
+} latencies[] = {
+  {"connect_start", offsetof(loadgen_stats, connect_start)},
+  {"offer_trade", offsetof(loadgen_stats, offer_trade)},
+  {"offer_book", offsetof(loadgen_stats, offer_book)}
+};
+
+#define NUM_LATENCIES (sizeof(latencies)/sizeof(latencies[0]))
+
+static const loadgen_hist*
+get_latency(const loadgen_stats* stats, size_t i)
+{
+  return (const loadgen_hist*) ((const char*) stats + latencies[i].offset);
+}
+
+void
+print_loadgen_stats(const loadgen* lg, double elapsed)
+{
+  const loadgen_stats* stats = &lg->stats;
+  size_t num_players = lg->options->num_players;
+
+  printf("Ran for %.3f s\n", elapsed);
+  printf("Connections: %zu made, %zu failed, %zu dropped\n", stats->connects,
+         stats->connect_failures, stats->disconnects);
+  printf("Sent: %zu offers, %zu cancels, %.0f commands/s, %.0f bytes/s\n",
+         stats->offers_sent, stats->cancels_sent,
+         (double) (stats->offers_sent + stats->cancels_sent)/elapsed,
+         (double) stats->bytes_sent/elapsed);
+  printf("Received: %zu commands, %.0f commands/s, %.0f bytes/s\n",
+         stats->commands_received,
+         (double) stats->commands_received/elapsed,
+         (double) stats->bytes_received/elapsed);
+  printf("Played: %zu trades (%.0f/s), %zu rounds, %zu games\n",
+         stats->fills/2, (double) (stats->fills/2)/elapsed,
+         stats->round_ends/num_players, stats->game_ends/num_players);
+  printf("Errors: %zu, bad packets: %zu\n", stats->errors,
+         stats->bad_packets);
+
+  printf("\n");
+  printf("%-14s %10s %10s %10s %10s %10s %10s\n", "latency (us)", "count",
+         "mean", "p50", "p99", "p999", "max");
+
+  for (size_t i = 0; i < NUM_LATENCIES; ++i) {
+    const loadgen_hist* hist = get_latency(stats, i);
+
+    printf("%-14s %10" PRIu64 " %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           latencies[i].name, hist->count, to_us((uint64_t) hist_mean(hist)),
+           to_us(hist_percentile(hist, 0.50)),
+           to_us(hist_percentile(hist, 0.99)),
+           to_us(hist_percentile(hist, 0.999)), to_us(hist->max));
+  }
+}
+
+/* Write the results as a single JSON object */
+static void
+write_json(const loadgen* lg, double elapsed, FILE* out)
+{
+  const loadgen_options* options = lg->options;
+  const loadgen_stats* stats = &lg->stats;
+
+  fprintf(out, "{\"options\":{\"tables\":%zu,\"players\":%zu,"
+          "\"connections\":%zu,\"think_ms\":%d,\"strategy\":\"%s\","
+          "\"framing\":\"%s\",\"seed\":%" PRIu64 "},",
+          options->num_tables, options->num_players, lg->num_conns,
+          options->think_ms, options->strategy->name,
+          (options->mode == FRAMING_LENGTH) ? "length" : "newline",
+          options->seed);
+
+  fprintf(out, "\"elapsed_s\":%.3f,\"connects\":%zu,"
+          "\"connect_failures\":%zu,\"disconnects\":%zu,"
+          "\"offers_sent\":%zu,\"cancels_sent\":%zu,"
+          "\"commands_received\":%zu,\"bytes_sent\":%zu,"
+          "\"bytes_received\":%zu,\"trades\":%zu,\"errors\":%zu,"
+          "\"bad_packets\":%zu,\"sent_per_s\":%.1f,\"received_per_s\":%.1f,"
+          "\"trades_per_s\":%.1f,\"latency_us\":{",
+          elapsed, stats->connects, stats->connect_failures,
+          stats->disconnects, stats->offers_sent, stats->cancels_sent,
+          stats->commands_received, stats->bytes_sent, stats->bytes_received,
+          stats->fills/2, stats->errors, stats->bad_packets,
+          (double) (stats->offers_sent + stats->cancels_sent)/elapsed,
+          (double) stats->commands_received/elapsed,
+          (double) (stats->fills/2)/elapsed);
+
+  for (size_t i = 0; i < NUM_LATENCIES; ++i) {
+    const loadgen_hist* hist = get_latency(stats, i);
+
+    fprintf(out, "%s\"%s\":{\"count\":%" PRIu64 ",\"mean\":%.1f,"
+            "\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+            (i > 0) ? "," : "", latencies[i].name, hist->count,
+            to_us((uint64_t) hist_mean(hist)),
+            to_us(hist_percentile(hist, 0.50)),
+            to_us(hist_percentile(hist, 0.99)),
+            to_us(hist_percentile(hist, 0.999)), to_us(hist->max));
+  }
+
+  fprintf(out, "}}\n");
+}
+
+/* Write the results as a CSV row, with a header if the file is empty */
+static void
+write_csv(const loadgen* lg, double elapsed, FILE* out)
+{
+  const loadgen_options* options = lg->options;
+  const loadgen_stats* stats = &lg->stats;
+
+  fseek(out, 0, SEEK_END);
+
+  if (ftell(out) == 0) {
+    fprintf(out, "tables,players,connections,think_ms,strategy,framing,"
+            "elapsed_s,connects,connect_failures,disconnects,offers_sent,"
+            "cancels_sent,commands_received,trades,errors,sent_per_s,"
+            "received_per_s,trades_per_s");
+
+    for (size_t i = 0; i < NUM_LATENCIES; ++i) {
+      const char* name = latencies[i].name;
+
+      fprintf(out, ",%s_count,%s_p50_us,%s_p99_us,%s_p999_us,%s_max_us",
+              name, name, name, name, name);
+    }
+
+    fprintf(out, "\n");
+  }
+
+  fprintf(out, "%zu,%zu,%zu,%d,%s,%s,%.3f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,"
+          "%.1f,%.1f,%.1f", options->num_tables, options->num_players,
+          lg->num_conns, options->think_ms, options->strategy->name,
+          (options->mode == FRAMING_LENGTH) ? "length" : "newline", elapsed,
+          stats->connects, stats->connect_failures, stats->disconnects,
+          stats->offers_sent, stats->cancels_sent, stats->commands_received,
+          stats->fills/2, stats->errors,
+          (double) (stats->offers_sent + stats->cancels_sent)/elapsed,
+          (double) stats->commands_received/elapsed,
+          (double) (stats->fills/2)/elapsed);
+
+  for (size_t i = 0; i < NUM_LATENCIES; ++i) {
+    const loadgen_hist* hist = get_latency(stats, i);
+
+    fprintf(out, ",%" PRIu64 ",%.1f,%.1f,%.1f,%.1f", hist->count,
+            to_us(hist_percentile(hist, 0.50)),
+            to_us(hist_percentile(hist, 0.99)),
+            to_us(hist_percentile(hist, 0.999)), to_us(hist->max));
+  }
+
+  fprintf(out, "\n");
+}
+
+void
+write_loadgen_results(const loadgen* lg, double elapsed, FILE* out)
+{
+  if (lg->options->format == LOADGEN_CSV) {
+    write_csv(lg, elapsed, out);
+  }
+  else {
+    write_json(lg, elapsed, out);
+  }
+}
+
+void
+free_loadgen(loadgen* lg)
+{
+  for (size_t i = 0; i < lg->num_conns; ++i) {
+    loadgen_conn* conn = &lg->conns[i];
+
+    if (conn->bev != NULL) {
+      close_conn(conn, 0);
+    }
+
+    event_free(conn->act_ev);
+  }
+
+  free(lg->conns);
+  free(lg->slots);
+  event_base_free(lg->evbase);
+  free(lg);
+}
+
+void
+parse_loadgen_options(int argc, char** argv, loadgen_options* options)
+{
+  while (true) {
+    static struct option long_options[] = {
+      {"host",     required_argument, 0, 'H'},
+      {"port",     required_argument, 0, 'P'},
+      {"framing",  required_argument, 0, 'f'},
+      {"tables",   required_argument, 0, 'T'},
+      {"players",  required_argument, 0, 'p'},
+      {"think",    required_argument, 0, 'i'},
+      {"duration", required_argument, 0, 'd'},
+      {"seed",     required_argument, 0, 's'},
+      {"strategy", required_argument, 0, 'a'},
+      {"output",   required_argument, 0, 'o'},
+      {"format",   required_argument, 0, 'F'},
+      {"help",     no_argument,       0, 'h'},
+      {0,          0,                 0, 0}
+    };
+
+    int option_index = 0;
+
+    int c = getopt_long(argc, argv, "H:P:f:T:p:i:d:s:a:o:F:h", long_options,
+                        &option_index);
+
+    /* End of options has been reached */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 'H':
+        options->host = optarg;
+        break;
+
+      case 'P':
+        options->port = (int) strtol(optarg, NULL, 10);
+        if (options->port < 1 || options->port > 65535) {
+          errx(1, "port must be between 1 and 65535");
+        }
+        break;
+
+      case 'f':
+        if (!framing_from_str(optarg, &options->mode)) {
+          errx(1, "unknown framing '%s'", optarg);
+        }
+        break;
+
+      case 'T':
+        options->num_tables = (size_t) strtoull(optarg, NULL, 10);
+        break;
+
+      case 'p':
+        options->num_players = (size_t) strtoull(optarg, NULL, 10);
+        if (options->num_players < 2 || options->num_players > MAX_PLAYERS) {
+          errx(1, "player count must be between 2 and %d", MAX_PLAYERS);
+        }
+        break;
+
+      case 'i':
+        options->think_ms = (int) strtol(optarg, NULL, 10);
+        if (options->think_ms < 1) {
+          errx(1, "think time must be at least 1 ms");
+        }
+        break;
+
+      case 'd':
+        options->duration = (int) strtol(optarg, NULL, 10);
+        if (options->duration < 1) {
+          errx(1, "duration must be at least 1 s");
+        }
+        break;
+
+      case 's':
+        options->seed = (uint64_t) strtoull(optarg, NULL, 10);
+        break;
+
+      case 'a':
+        options->strategy = find_loadgen_strategy(optarg);
+        if (options->strategy == NULL) {
+          errx(1, "unknown strategy '%s'", optarg);
+        }
+        break;
+
+      case 'o':
+        options->output = optarg;
+        break;
+
+      case 'F':
+        if (strcmp(optarg, "json") == 0) {
+          options->format = LOADGEN_JSON;
+        }
+        else if (strcmp(optarg, "csv") == 0) {
+          options->format = LOADGEN_CSV;
+        }
+        else {
+          errx(1, "unknown format '%s'", optarg);
+        }
+        break;
+
+      case 'h':
+        printf("billionaire-loadgen: load a billionaire-server with many playing connections\n");
+        printf("\n");
+        printf("  -H,--host ADDR\tConnect to IPv4 address ADDR (default: 127.0.0.1)\n");
+        printf("  -P,--port N\t\tConnect to port N (default: 5555)\n");
+        printf("  -f,--framing MODE\tDelimit packets by 'newline' or 'length' (default: newline)\n");
+        printf("  -T,--tables N\t\tFill N tables (default: 250)\n");
+        printf("  -p,--players N\tSet players per table, as given to the server (default: 4)\n");
+        printf("  -i,--think N\t\tAct every N ms per connection (default: 100)\n");
+        printf("  -d,--duration N\tRun for N seconds (default: 10)\n");
+        printf("  -s,--seed N\t\tSet the random seed (default: random)\n");
+        printf("  -a,--strategy NAME\tChoose offers with 'random' or 'collector' (default: random)\n");
+        printf("  -o,--output FILE\tWrite results to FILE\n");
+        printf("  -F,--format FMT\tWrite results as 'json' or 'csv' (default: json)\n");
+        printf("  -h,--help\t\tDisplay this help and quit\n");
+        exit(1);
+
+      default:
+        exit(1);
+    }
+  }
+
+  if (options->num_tables*options->num_players > LOADGEN_MAX_CONNS ||
+      options->num_tables == 0) {
+    errx(1, "connection count must be between 1 and %d", LOADGEN_MAX_CONNS);
+  }
+}
+
+/* Raise the open file limit to fit every connection, if it is too low */
+static void
+raise_file_limit(size_t num_conns)
+{
+  struct rlimit limit;
+  rlim_t needed = (rlim_t) num_conns + 64;
+
+  if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur >= needed) {
+    return;
+  }
+
+  limit.rlim_cur = (limit.rlim_max < needed) ? limit.rlim_max : needed;
+
+  if (setrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur < needed) {
+    warnx("open file limit of %ju is too low for %zu connections",
+          (uintmax_t) limit.rlim_cur, num_conns);
+  }
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Default parameters */
+  loadgen_options options = {
+    .host = "127.0.0.1",
+    .port = 5555,
+    .mode = FRAMING_NEWLINE,
+    .num_tables = 250,
+    .num_players = 4,
+    .think_ms = 100,
+    .duration = 10,
+    .seed = mix(clock(), time(NULL), getpid()),
+    .strategy = find_loadgen_strategy("random"),
+    .output = NULL,
+    .format = LOADGEN_JSON
+  };
+
+  parse_loadgen_options(argc, argv, &options);
+
+  FILE* out = NULL;
+
+  /* Fail before the run rather than after it */
+  if (options.output != NULL) {
+    out = fopen(options.output, (options.format == LOADGEN_CSV) ? "a" : "w");
+
+    if (out == NULL) {
+      err(1, "cannot open '%s'", options.output);
+    }
+  }
+
+  /* A broken connection is reported by libevent, not by a signal */
+  signal(SIGPIPE, SIG_IGN);
+
+  loadgen* lg = loadgen_new(&options);
+
+  raise_file_limit(lg->num_conns);
+
+  printf("Opening %zu connections to %s:%d across %zu tables with seed %"
+         PRIu64 "\n", lg->num_conns, options.host, options.port,
+         options.num_tables, options.seed);
+
+  uint64_t start = now_ns();
+
+  run_loadgen(lg);
+
+  double elapsed = (double) (now_ns() - start)*1e-9;
+
+  print_loadgen_stats(lg, elapsed);
+
+  if (out != NULL) {
+    write_loadgen_results(lg, elapsed, out);
+    fclose(out);
+  }
+
+  free_loadgen(lg);
+
+  return 0;
+}
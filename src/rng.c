@@ -0,0 +1,75 @@
+#include "rng.h"
+
+/* Increment of the SplitMix64 generator, 2^64 divided by the golden
+   ratio */
+#define SPLITMIX_GAMMA UINT64_C(0x9e3779b97f4a7c15)
+
+/* Scramble all 64 bits of a value, as SplitMix64 does to its output. */
+static uint64_t
+mix64(uint64_t z)
+{
+  z = (z ^ (z >> 30))*UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27))*UINT64_C(0x94d049bb133111eb);
+
+  return z ^ (z >> 31);
+}
+
+static uint64_t
+rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+void
+rng_init(rng* rng_obj, uint64_t seed, uint64_t stream)
+{
+  /* Fill the state from a SplitMix64 sequence starting at a point that
+     depends on both the seed and the stream. Scrambling the stream
+     first keeps nearby streams from starting at nearby points, which
+     would make their sequences overlap */
+  uint64_t x = mix64(seed) ^ mix64(stream ^ SPLITMIX_GAMMA);
+
+  for (int i = 0; i < 4; ++i) {
+    x += SPLITMIX_GAMMA;
+    rng_obj->state[i] = mix64(x);
+  }
+}
+
+uint64_t
+rng_next(rng* rng_obj)
+{
+  uint64_t* s = rng_obj->state;
+  uint64_t result = rotl(s[1]*5, 7)*9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+uint32_t
+rng_bounded(rng* rng_obj, uint32_t bound)
+{
+  /* The high bits of a xoshiro256** output are the strongest */
+  uint64_t m = (rng_next(rng_obj) >> 32)*bound;
+  uint32_t low = (uint32_t) m;
+
+  /* Only a product whose low half falls below 2^32 mod bound can bias
+     the result, so the division is skipped unless one might */
+  if (low < bound) {
+    uint32_t threshold = (uint32_t) -bound % bound;
+
+    while (low < threshold) {
+      m = (rng_next(rng_obj) >> 32)*bound;
+      low = (uint32_t) m;
+    }
+  }
+
+  return (uint32_t) (m >> 32);
+}
@@ -0,0 +1,175 @@
+#include "room.h"
+
+#include <err.h>
+#include <stdio.h>
+
+room*
+room_new(size_t id, int player_limit, bool has_billionaire, bool has_taxman,
+         uint64_t seed)
+{
+  room* new_room = malloc(sizeof(room));
+
+  if (new_room == NULL) {
+    err(1, "new_room malloc failed");
+  }
+
+  new_room->id = id;
+  new_room->game = game_state_new(player_limit, has_billionaire, has_taxman,
+                                  seed, (uint64_t) id);
+  new_room->hashed_clients = client_hash_table_new(ROOM_HASH_TABLE_SIZE);
+  new_room->owner = NULL;
+
+  TAILQ_INIT(&new_room->clients);
+
+  return new_room;
+}
+
+bool
+room_add_client(room* room_obj, client* client_obj)
+{
+  if (!put_client(room_obj->hashed_clients, client_obj)) {
+    return false;
+  }
+
+  TAILQ_INSERT_TAIL(&room_obj->clients, client_obj, entries);
+
+  client_obj->room = room_obj;
+  room_obj->game->num_players++;
+
+  return true;
+}
+
+void
+room_remove_client(room* room_obj, client* client_obj)
+{
+  TAILQ_REMOVE(&room_obj->clients, client_obj, entries);
+  del_client(room_obj->hashed_clients, client_obj);
+
+  /* The rest of the room is told which offers the client withdraws */
+  if (is_running(room_obj->game)) {
+    room_obj->seats[client_obj->seat] = NULL;
+    engine_withdraw_seat(room_obj->game->table, client_obj->seat);
+  }
+
+  client_obj->room = NULL;
+  room_obj->game->num_players--;
+}
+
+bool
+room_is_empty(const room* room_obj)
+{
+  return TAILQ_EMPTY(&room_obj->clients);
+}
+
+void
+free_room(room* room_obj)
+{
+  client* client_obj = TAILQ_FIRST(&room_obj->clients);
+
+  while (client_obj != NULL) {
+    client* next_client = TAILQ_NEXT(client_obj, entries);
+
+    room_remove_client(room_obj, client_obj);
+    free_client(client_obj);
+
+    client_obj = next_client;
+  }
+
+  free_client_hash_table(room_obj->hashed_clients);
+  game_state_free(room_obj->game);
+  free(room_obj);
+}
+
+lobby*
+lobby_new(int player_limit, bool has_billionaire, bool has_taxman,
+          uint64_t seed)
+{
+  lobby* new_lobby = malloc(sizeof(lobby));
+
+  if (new_lobby == NULL) {
+    err(1, "new_lobby malloc failed");
+  }
+
+  TAILQ_INIT(&new_lobby->rooms);
+  new_lobby->num_rooms = 0;
+  new_lobby->next_room_id = 0;
+
+  new_lobby->player_limit = player_limit;
+  new_lobby->has_billionaire = has_billionaire;
+  new_lobby->has_taxman = has_taxman;
+  new_lobby->seed = seed;
+
+  return new_lobby;
+}
+
+room*
+get_open_room(lobby* lobby_obj)
+{
+  room* room_obj = TAILQ_FIRST(&lobby_obj->rooms);
+
+  if (room_obj != NULL && !is_running(room_obj->game) &&
+      !is_full(room_obj->game)) {
+    return room_obj;
+  }
+
+  room_obj = room_new(lobby_obj->next_room_id++, lobby_obj->player_limit,
+                      lobby_obj->has_billionaire, lobby_obj->has_taxman,
+                      lobby_obj->seed);
+  room_obj->owner = lobby_obj;
+
+  TAILQ_INSERT_HEAD(&lobby_obj->rooms, room_obj, entries);
+  lobby_obj->num_rooms++;
+
+  printf("Opened room %zu (%zu rooms)\n", room_obj->id, lobby_obj->num_rooms);
+
+  return room_obj;
+}
+
+void
+update_room(room* room_obj)
+{
+  lobby* lobby_obj = room_obj->owner;
+
+  TAILQ_REMOVE(&lobby_obj->rooms, room_obj, entries);
+
+  if (is_running(room_obj->game)) {
+    TAILQ_INSERT_TAIL(&lobby_obj->rooms, room_obj, entries);
+  }
+  else {
+    TAILQ_INSERT_HEAD(&lobby_obj->rooms, room_obj, entries);
+  }
+}
+
+void
+close_room(room* room_obj)
+{
+  lobby* lobby_obj = room_obj->owner;
+
+  TAILQ_REMOVE(&lobby_obj->rooms, room_obj, entries);
+  lobby_obj->num_rooms--;
+
+  const slab_stats* offer_stats =
+    get_slab_stats(room_obj->game->table->current_trades->offer_pool);
+
+  printf("Closed room %zu (%zu rooms) after %zu offers\n", room_obj->id,
+         lobby_obj->num_rooms, offer_stats->num_allocs);
+
+  free_room(room_obj);
+}
+
+void
+free_lobby(lobby* lobby_obj)
+{
+  room* room_obj = TAILQ_FIRST(&lobby_obj->rooms);
+
+  while (room_obj != NULL) {
+    room* next_room = TAILQ_NEXT(room_obj, entries);
+
+    TAILQ_REMOVE(&lobby_obj->rooms, room_obj, entries);
+    free_room(room_obj);
+
+    room_obj = next_room;
+  }
+
+  free(lobby_obj);
+}
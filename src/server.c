@@ -30,6 +30,9 @@
  * @todo IPv6 support - using libevent socket helpers, if any.
  */
 
+/* For SO_REUSEPORT */
+#define _DEFAULT_SOURCE
+
 #include "server.h"
 
 #include <sys/types.h>
@@ -45,19 +48,24 @@
 #include <err.h>
 
 #include <getopt.h>
+#include <pthread.h>
 #include <signal.h>
 #include <time.h> /* clock(), time() */
 #include <unistd.h> /* getpid() */
 
+#include <event2/thread.h>
+
 #include "billionaire.h"
 #include "client.h"
 #include "client_hash_table.h"
 #include "command.h"
+#include "command_error.h"
+#include "frame.h"
 #include "game_state.h"
+#include "room.h"
+#include "slab.h"
 #include "utils.h"
 
-#define READ_BYTES_AMOUNT 8192
-
 int
 setnonblock(int fd)
 {
@@ -73,85 +81,220 @@ setnonblock(int fd)
   return 0;
 }
 
+int
+open_listener(bool reuse_port)
+{
+  int listen_fd;
+  struct sockaddr_in listen_addr;
+
+  /* Create our listening socket. */
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    err(1, "listen failed");
+
+  /* Allow socket address to be reused in case of crash/hard exit */
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &(int){ 1 }, sizeof(int));
+
+  /* Allow each worker to listen on the same port */
+  if (reuse_port &&
+      setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &(int){ 1 },
+                 sizeof(int)) < 0) {
+    printf("\n");
+    err(1, "failed to set SO_REUSEPORT");
+  }
+
+  memset(&listen_addr, 0, sizeof(struct sockaddr_in));
+  listen_addr.sin_family = AF_INET;
+  listen_addr.sin_addr.s_addr = INADDR_ANY;
+  listen_addr.sin_port = htons(SERVER_PORT);
+  if (bind(listen_fd, (struct sockaddr*) &listen_addr,
+           sizeof(struct sockaddr_in)) < 0) {
+    printf("\n");
+    err(1, "bind failed");
+  }
+  if (listen(listen_fd, SOMAXCONN) < 0) {
+    printf("\n");
+    err(1, "listen failed");
+  }
+  /* Set the socket to non-blocking, this is essential in event
+   * based programming with libevent. */
+  if (setnonblock(listen_fd) < 0)
+    err(1, "failed to set server socket to non-blocking");
+
+  return listen_fd;
+}
+
+void*
+run_worker(void* arg)
+{
+  server_ctx* ctx = (server_ctx*) arg;
+
+  event_base_dispatch(ctx->evbase);
+
+  close_worker(ctx);
+
+  return NULL;
+}
+
 void
-buffered_on_read(struct bufferevent* bev, void* arg)
+close_worker(server_ctx* ctx)
 {
-  client* this_client = (client*) arg;
-  uint8_t data[READ_BYTES_AMOUNT];
+  /* Free every room along with the clients still seated in them */
+  free_lobby(ctx->rooms);
+  ctx->rooms = NULL;
+
+  const slab_stats* cmd_stats = get_command_pool_stats();
+
+  printf("Worker %zu: made %zu commands (at most %zu live)\n", ctx->id,
+         cmd_stats->num_allocs, cmd_stats->peak_live);
+
+  free_command_pool();
+}
+
+bool
+drop_client(room* this_room, client* this_client)
+{
+  /* Remove the client from its room */
+  room_remove_client(this_room, this_client);
 
-  size_t n = 1;
-  size_t total_bytes = 0;
-  char json_str[READ_BYTES_AMOUNT];
+  free_client(this_client);
 
-  /* Read 8k at a time. */
-  while (n != 0) {
-    total_bytes += n;
-    n = bufferevent_read(bev, data, sizeof(data));
+  if (room_is_empty(this_room)) {
+    close_room(this_room);
+    return true;
   }
 
-  snprintf(json_str, total_bytes, "%s", data);
+  if (is_running(this_room->game) && !is_full(this_room->game)) {
+    stop_billionaire_game(this_room);
+  }
 
-  if (is_running(billionaire_game)) {
-    process_client_command(this_client, json_str, total_bytes);
+  /* The room can take the place of the client once its game is over,
+     whether it was stopped just now or ended on its own */
+  if (!is_running(this_room->game)) {
+    update_room(this_room);
   }
-  /* This can eventually be removed */
-  else {
-    printf("Received from %s: %s\n", this_client->id, json_str);
+
+  return false;
+}
+
+void
+flush_room(room* this_room)
+{
+  send_commands_to_clients(&this_room->clients);
+
+  /* Dropping a client can queue more commands for those remaining, so
+     keep flushing until no client has overflowed */
+  while (true) {
+    client* client_obj = NULL;
+    client* slow_client = NULL;
+
+    TAILQ_FOREACH(client_obj, &this_room->clients, entries) {
+      if (client_obj->overflowed) {
+        slow_client = client_obj;
+        break;
+      }
+    }
+
+    if (slow_client == NULL) {
+      break;
+    }
+
+    printf("Client '" CLIENT_ID_FMT "' cannot keep up, disconnecting.\n",
+           slow_client->id);
+
+    if (drop_client(this_room, slow_client)) {
+      return;
+    }
+
+    send_commands_to_clients(&this_room->clients);
   }
 }
 
+void
+buffered_on_read(struct bufferevent* bev, void* arg)
+{
+  client* this_client = (client*) arg;
+  room* this_room = this_client->room;
+  struct evbuffer* input = bufferevent_get_input(bev);
+
+  size_t frame_len = 0;
+  frame_status status;
+
+  /* Process every complete frame that has arrived so far, leaving any
+   * partial frame in the input buffer until the rest of it arrives. */
+  while ((status = next_frame(&this_client->reader, input, &frame_len)) !=
+         FRAME_INCOMPLETE) {
+    cmd_result res = CMD_RESULT_INIT;
+
+    if (status == FRAME_TOO_LARGE) {
+      res.err = (int) EFRAMESIZE;
+      enqueue_command(this_client, command_error(&res));
+      continue;
+    }
+
+    json_object* packet = parse_frame(&this_client->reader, input, frame_len,
+                                      &res);
+
+    if (is_running(this_room->game)) {
+      process_client_command(this_room, this_client, packet, &res);
+    }
+    /* This can eventually be removed */
+    else {
+      size_t str_len = 0;
+      printf("Received from " CLIENT_ID_FMT ": %s\n", this_client->id,
+             (packet != NULL) ? JSON_to_str(packet, &str_len) : "");
+      json_object_put(packet);
+    }
+  }
+
+  /* Send any outstanding commands to clients */
+  flush_room(this_room);
+}
+
 void
 buffered_on_error(struct bufferevent* bev, short what, void* arg)
 {
   client* this_client = (client*) arg;
+  room* this_room = this_client->room;
 
   if (what & BEV_EVENT_EOF) {
     /* Client disconnected, remove the read event and then
      * free the client structure. */
-    printf("Client '%s' disconnected.\n", this_client->id);
+    printf("Client '" CLIENT_ID_FMT "' disconnected.\n", this_client->id);
   }
   else if (what & BEV_EVENT_TIMEOUT) {
-    printf("Client '%s' timed out.\n", this_client->id);
+    printf("Client '" CLIENT_ID_FMT "' timed out.\n", this_client->id);
   }
   else if (what & BEV_EVENT_ERROR) {
-    printf("Client '%s' socket error '%s', disconnecting.\n", this_client->id,
+    printf("Client '" CLIENT_ID_FMT "' socket error '%s', disconnecting.\n",
+           this_client->id,
            evutil_socket_error_to_string(EVUTIL_SOCKET_ERROR()));
   }
   else {
-    warn("Client '%s' socket error, disconnecting.\n", this_client->id);
+    warn("Client '" CLIENT_ID_FMT "' socket error, disconnecting.\n",
+         this_client->id);
   }
 
-  /* Remove the client from the tailq. */
-  TAILQ_REMOVE(&client_tailq_head, this_client, entries);
-  billionaire_game->num_players--;
-
-  /* Remove the client from the hash table */
-  del_client(hashed_clients, this_client);
-
-  free_client(this_client);
-
-  if (is_running(billionaire_game) && !is_full(billionaire_game)) {
-    stop_billionaire_game();
+  if (drop_client(this_room, this_client)) {
+    return;
   }
 
-  send_commands_to_clients(&client_tailq_head);
+  flush_room(this_room);
 }
 
 void
 on_accept(int fd, short ev, void* arg)
 {
+  server_ctx* ctx = (server_ctx*) arg;
+  room* open_room;
   int client_fd;
   struct sockaddr_in client_addr;
   socklen_t client_len = sizeof(struct sockaddr_in);
   client* new_client;
 
   char client_addr_str[ADDR_STR_SIZE];
-  json_object* join;
-
-  /* If game is running, deny connection (TODO) */
-  if (is_running(billionaire_game)) {
-    return;
-  }
+  char client_ip_str[INET_ADDRSTRLEN];
+  command* join;
 
   client_fd = accept(fd, (struct sockaddr*) &client_addr, &client_len);
   if (client_fd < 0) {
@@ -163,61 +306,73 @@ on_accept(int fd, short ev, void* arg)
   if (setnonblock(client_fd) < 0)
     warn("failed to set client socket non-blocking");
 
-  /* We've accepted a new client, create a client object. */
-  new_client = client_new(evbase, client_fd,
+  /* We've accepted a new client, create a client object. Its framing is
+   * picked by the first byte it sends. */
+  new_client = client_new(ctx->evbase, client_fd, FRAMING_UNKNOWN,
                           buffered_on_read, buffered_on_error);
 
-  billionaire_game->num_players++;
-
   /* Get client address:port as a string */
+  inet_ntop(AF_INET, &client_addr.sin_addr, client_ip_str, INET_ADDRSTRLEN);
   snprintf(client_addr_str, ADDR_STR_SIZE, "%s:%d",
-           inet_ntoa(client_addr.sin_addr), client_addr.sin_port);
+           client_ip_str, client_addr.sin_port);
 
   /* Create unique id from address:port */
   new_client->id = hash_addr(client_addr_str);
 
-  /* Add client to client hash table */
-  put_client(hashed_clients, new_client);
+  /* Seat client in a room waiting for players */
+  open_room = get_open_room(ctx->rooms);
 
-  printf("Accepted connection from %s (%s)\n", client_addr_str, new_client->id);
+  if (!room_add_client(open_room, new_client)) {
+    warnx("Client ID " CLIENT_ID_FMT " of %s is already in room %zu, "
+          "disconnecting",
+          new_client->id, client_addr_str, open_room->id);
+    free_client(new_client);
+    return;
+  }
+
+  printf("Accepted connection from %s (" CLIENT_ID_FMT ") into room %zu of "
+         "worker %zu\n", client_addr_str, new_client->id, open_room->id,
+         ctx->id);
 
   /* Queue a JOIN command for the client. */
   join = command_join(new_client->id);
   enqueue_command(new_client, join);
 
   /* Start game if max number of players has joined */
-  if (is_full(billionaire_game)) {
-    start_billionaire_game();
+  if (is_full(open_room->game)) {
+    start_billionaire_game(open_room);
+    update_room(open_room);
   }
 
-  /* Flush all client command queues to the corresponding client */
-  send_commands_to_clients(&client_tailq_head);
+  /* Flush all client command queues in the room to the corresponding client */
+  flush_room(open_room);
 }
 
 void
-on_exit(int sig, short ev, void *arg)
+on_signal(int sig, short ev, void *arg)
 {
   printf("\n");
   printf("Exiting cleanly...\n");
-  event_base_loopbreak(evbase);
+  event_base_loopbreak((struct event_base*) arg);
 }
 
 void
 parse_command_line_options(int argc, char** argv, int* player_limit,
                            bool* has_billionaire, bool* has_taxman,
-                           uint32_t* seed) {
+                           uint32_t* seed, int* num_threads) {
   while (true) {
     static struct option long_options[] = {
       {"players",        required_argument, 0, 'p'},
       {"no-billionaire", no_argument,       0, 'b'},
       {"no-taxman",      no_argument,       0, 't'},
       {"seed",           required_argument, 0, 's'},
+      {"threads",        required_argument, 0, 'n'},
       {"help",           no_argument,       0, 'h'}
     };
 
     int option_index = 0;
 
-    int c = getopt_long(argc, argv, "p:bts:h", long_options, &option_index);
+    int c = getopt_long(argc, argv, "p:bts:n:h", long_options, &option_index);
 
     /* End of options has been reached */
     if (c == -1)
@@ -236,8 +391,8 @@ parse_command_line_options(int argc, char** argv, int* player_limit,
 
       case 'p':
         *player_limit = (int) strtol(optarg, NULL, 10);
-        if (*player_limit > MAX_PLAYERS) {
-          err(1, "player limit greater than %d", MAX_PLAYERS);
+        if (*player_limit < 2 || *player_limit > MAX_PLAYERS) {
+          errx(1, "player limit must be between 2 and %d", MAX_PLAYERS);
         }
         break;
 
@@ -253,6 +408,13 @@ parse_command_line_options(int argc, char** argv, int* player_limit,
         *seed = (uint32_t) strtol(optarg, NULL, 10);
         break;
 
+      case 'n':
+        *num_threads = (int) strtol(optarg, NULL, 10);
+        if (*num_threads < 1 || *num_threads > MAX_THREADS) {
+          errx(1, "thread count must be between 1 and %d", MAX_THREADS);
+        }
+        break;
+
       case 'h':
         printf("billionaire-server: a low-level TCP server for the Billionaire game\n");
         printf("\n");
@@ -260,6 +422,7 @@ parse_command_line_options(int argc, char** argv, int* player_limit,
         printf("  -b,--no-billionaire\tRemove billionaire from play\n");
         printf("  -t,--no-taxman\tRemove taxman from play\n");
         printf("  -s,--seed N\t\tSet the random seed (default: random)\n");
+        printf("  -n,--threads N\tRun N worker event loops (default: 1)\n");
         printf("  -h,--help\t\tDisplay this help and quit\n");
         exit(1);
 
@@ -276,100 +439,97 @@ main(int argc, char** argv)
   int player_limit = 4;
   bool has_billionaire = true, has_taxman = true;
   uint32_t seed = mix(clock(), time(NULL), getpid());
+  int num_threads = 1;
 
-  int listen_fd;
-  struct sockaddr_in listen_addr;
-  struct event ev_accept, ev_sigint, ev_sigterm;
+  struct event ev_sigint, ev_sigterm;
+  server_ctx* workers;
 
   /* Parse external options */
   parse_command_line_options(argc, argv,
                              &player_limit,
                              &has_billionaire, &has_taxman,
-                             &seed);
-
-  srand(seed);
+                             &seed, &num_threads);
 
   // event_enable_debug_logging(EVENT_DBG_ALL);
   printf("Initialising server... ");
 
-  /* Initialise libevent. */
-  evbase = event_base_new();
+  /* Allow the main thread to break each worker's event loop */
+  if (num_threads > 1 && evthread_use_pthreads() < 0) {
+    printf("\n");
+    errx(1, "failed to enable libevent threading");
+  }
 
-  /* Initialise Billionaire game state */
-  billionaire_game = game_state_new(player_limit,
-                                    has_billionaire, has_taxman);
+  workers = calloc((size_t) num_threads, sizeof(server_ctx));
 
-  /* Initialise client hash table */
-  hashed_clients = client_hash_table_new(CLIENT_HASH_TABLE_SIZE);
+  if (workers == NULL) {
+    err(1, "workers malloc failed");
+  }
 
-  /* Initialise the tailq. */
-  TAILQ_INIT(&client_tailq_head);
+  /* Give each worker its own event loop, rooms and listening socket */
+  for (int i = 0; i < num_threads; ++i) {
+    server_ctx* ctx = &workers[i];
 
-  /* Create our listening socket. */
-  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-  if (listen_fd < 0)
-    err(1, "listen failed");
+    ctx->id = (size_t) i;
 
-  /* Allow socket address to be reused in case of crash/hard exit */
-  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &(int){ 1 }, sizeof(int));
+    /* Initialise libevent. */
+    ctx->evbase = event_base_new();
 
-  memset(&listen_addr, 0, sizeof(struct sockaddr_in));
-  listen_addr.sin_family = AF_INET;
-  listen_addr.sin_addr.s_addr = INADDR_ANY;
-  listen_addr.sin_port = htons(SERVER_PORT);
-  if (bind(listen_fd, (struct sockaddr*) &listen_addr,
-           sizeof(struct sockaddr_in)) < 0) {
-    printf("\n");
-    err(1, "bind failed");
-  }
-  if (listen(listen_fd, 5) < 0) {
-    printf("\n");
-    err(1, "listen failed");
+    /* Initialise the rooms Billionaire games are played in. Each worker
+     * gets its own half of the seed space, so a game's shuffles depend
+     * only on the seed, the worker and the room number */
+    ctx->rooms = lobby_new(player_limit, has_billionaire, has_taxman,
+                           ((uint64_t) seed << 32) | (uint64_t) i);
+
+    ctx->listen_fd = open_listener(num_threads > 1);
+
+    /* We now have a listening socket, we create a read event to
+     * be notified when a client connects. */
+    ctx->ev_accept = event_new(ctx->evbase, ctx->listen_fd,
+                               EV_READ|EV_PERSIST, on_accept, ctx);
+    event_add(ctx->ev_accept, NULL);
   }
-  /* Set the socket to non-blocking, this is essential in event
-   * based programming with libevent. */
-  if (setnonblock(listen_fd) < 0)
-    err(1, "failed to set server socket to non-blocking");
 
   printf("done\n");
+  printf("Shuffling with seed %" PRIu32 "\n", seed);
 
-  /* We now have a listening socket, we create a read event to
-   * be notified when a client connects. */
-  event_assign(&ev_accept, evbase, listen_fd, EV_READ|EV_PERSIST, on_accept, NULL);
-  event_add(&ev_accept, NULL);
-
-  /* Add SIGINT and SIGTERM handling */
-  evsignal_assign(&ev_sigint, evbase, SIGINT, on_exit, NULL);
-  evsignal_assign(&ev_sigterm, evbase, SIGTERM, on_exit, NULL);
+  /* Add SIGINT and SIGTERM handling to the main thread's event loop */
+  evsignal_assign(&ev_sigint, workers[0].evbase, SIGINT, on_signal,
+                  workers[0].evbase);
+  evsignal_assign(&ev_sigterm, workers[0].evbase, SIGTERM, on_signal,
+                  workers[0].evbase);
   event_add(&ev_sigint, NULL);
   event_add(&ev_sigterm, NULL);
 
+  /* The main thread runs the first worker itself */
+  for (int i = 1; i < num_threads; ++i) {
+    if (pthread_create(&workers[i].thread, NULL, run_worker,
+                       &workers[i]) != 0) {
+      errx(1, "failed to start worker %d", i);
+    }
+  }
+
   /* Start the main event loop */
-  event_base_dispatch(evbase);
+  event_base_dispatch(workers[0].evbase);
 
   /* Called whenever the main event loop finishes */
-  game_state_free(billionaire_game);
-
-  /* Assumes that if client queue is empty, so is client hash table */
-  if (!TAILQ_EMPTY(&client_tailq_head)) {
-    struct client* client_struct;
-    struct client* next_client_struct;
+  for (int i = 1; i < num_threads; ++i) {
+    event_base_loopbreak(workers[i].evbase);
+    pthread_join(workers[i].thread, NULL);
+  }
 
-    client_struct = TAILQ_FIRST(&client_tailq_head);
+  /* The other workers closed themselves before their threads ended */
+  close_worker(&workers[0]);
 
-    while (client_struct != NULL) {
-      next_client_struct = TAILQ_NEXT(client_struct, entries);
+  for (int i = 0; i < num_threads; ++i) {
+    server_ctx* ctx = &workers[i];
 
-      TAILQ_REMOVE(&client_tailq_head, client_struct, entries);
-      del_client(hashed_clients, client_struct);
-      free_client(client_struct);
+    event_free(ctx->ev_accept);
+    close(ctx->listen_fd);
 
-      client_struct = next_client_struct;
-    }
+    event_base_free(ctx->evbase);
   }
 
-  free_client_hash_table(hashed_clients);
-  event_base_free(evbase);
+  free(workers);
 
   return 0;
 }
@@ -0,0 +1,717 @@
+/*
+ * A Monte Carlo tournament runner, playing many independent games of
+ * Billionaire between built-in strategies across a pool of threads.
+ */
+
+/* For getopt_long(), strtok_r() and clock_gettime() */
+#define _DEFAULT_SOURCE
+
+#include "sim.h"
+
+#include <err.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h> /* clock(), time() */
+#include <unistd.h> /* getpid(), sysconf() */
+
+#include "book.h"
+#include "card_location.h"
+#include "utils.h"
+
+/* Return the size of a seat's offer on the book, or 0 if it has none */
+static size_t
+resting_offer_size(const engine* engine_obj, size_t seat)
+{
+  const book* current_trades = engine_obj->current_trades;
+
+  for (size_t i = 0; i < current_trades->num_owners; ++i) {
+    if (current_trades->owners[i].owner_id == seat) {
+      return (size_t) __builtin_ctz(current_trades->owners[i].levels) +
+        OFFER_INDEX_OFFSET;
+    }
+  }
+
+  return 0;
+}
+
+/* Offer some of a commodity chosen at random from those held at least
+   OFFER_MIN_CARDS times, other than keep. Passes if there is none */
+static void
+offer_random_commodity(const card_location* hand, rng* rng_obj, card_id keep,
+                       bool with_taxman, engine_action* action)
+{
+  card_id choices[TOTAL_COMMODITY_AMOUNT];
+  size_t num_choices = 0;
+
+  for (card_id card = DIAMONDS; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (card != keep && get_card_amount(hand, card) >= OFFER_MIN_CARDS) {
+      choices[num_choices++] = card;
+    }
+  }
+
+  if (num_choices == 0) {
+    return;
+  }
+
+  card_id card = choices[rng_bounded(rng_obj, (uint32_t) num_choices)];
+  size_t max_amt = get_card_amount(hand, card);
+
+  with_taxman &= (get_card_amount(hand, TAX_COLLECTOR) > 0);
+
+  /* The tax collector takes up a card of the offer */
+  if (with_taxman && max_amt == OFFER_MAX_CARDS) {
+    max_amt--;
+  }
+
+  action->type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&action->cards, card, OFFER_MIN_CARDS +
+                        rng_bounded(rng_obj,
+                                    (uint32_t) (max_amt - OFFER_MIN_CARDS + 1)));
+
+  if (with_taxman) {
+    add_cards_to_location(&action->cards, TAX_COLLECTOR, 1);
+  }
+}
+
+/* Shared by the collecting strategies. Now and then takes back the offer
+   on the book, so the same seats do not keep trading the same cards back
+   and forth, and otherwise offers anything but the commodity held most,
+   which is only rarely given up to break up hands of singles */
+static void
+collect(const engine* engine_obj, size_t seat, rng* rng_obj, bool with_taxman,
+        engine_action* action)
+{
+  const card_location* hand = get_engine_hand(engine_obj, seat);
+  size_t resting_amt = resting_offer_size(engine_obj, seat);
+  card_id most = DIAMONDS;
+
+  if (resting_amt > 0) {
+    if (rng_bounded(rng_obj, 4) == 0) {
+      action->type = ENGINE_CANCEL_OFFER;
+      action->card_amt = resting_amt;
+    }
+
+    return;
+  }
+
+  for (card_id card = GOLD; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (get_card_amount(hand, card) > get_card_amount(hand, most)) {
+      most = card;
+    }
+  }
+
+  if (rng_bounded(rng_obj, 8) == 0) {
+    most = TOTAL_COMMODITY_AMOUNT;
+  }
+
+  offer_random_commodity(hand, rng_obj, most, with_taxman, action);
+}
+
+/* Offer any commodity, keeping at most one offer on the book */
+static void
+random_act(const engine* engine_obj, size_t seat, engine_action* action,
+           void* data)
+{
+  rng* rng_obj = ((sim_seat*) data)->rng_obj;
+  size_t resting_amt = resting_offer_size(engine_obj, seat);
+
+  if (resting_amt > 0) {
+    if (rng_bounded(rng_obj, 4) == 0) {
+      action->type = ENGINE_CANCEL_OFFER;
+      action->card_amt = resting_amt;
+    }
+
+    return;
+  }
+
+  offer_random_commodity(get_engine_hand(engine_obj, seat), rng_obj,
+                         TOTAL_COMMODITY_AMOUNT, false, action);
+}
+
+/* Work towards a set of the commodity held most */
+static void
+collector_act(const engine* engine_obj, size_t seat, engine_action* action,
+              void* data)
+{
+  collect(engine_obj, seat, ((sim_seat*) data)->rng_obj, false, action);
+}
+
+/* Collect as collector_act does, slipping the tax collector into every
+   offer to pass its penalty on */
+static void
+dumper_act(const engine* engine_obj, size_t seat, engine_action* action,
+           void* data)
+{
+  collect(engine_obj, seat, ((sim_seat*) data)->rng_obj, true, action);
+}
+
+/* Count the rounds a seat wins */
+static void
+count_billionaires(const engine* engine_obj, size_t seat,
+                   const engine_event* event, void* data)
+{
+  (void) engine_obj;
+
+  if (event->type == ENGINE_BILLIONAIRE && event->seat == seat) {
+    ((sim_seat*) data)->stats->billionaires++;
+  }
+}
+
+static const sim_strategy strategies[] = {
+  {"random", random_act},
+  {"collector", collector_act},
+  {"dumper", dumper_act}
+};
+
+const sim_strategy*
+find_strategy(const char* name)
+{
+  for (size_t i = 0; i < sizeof(strategies)/sizeof(sim_strategy); ++i) {
+    if (strcmp(strategies[i].name, name) == 0) {
+      return &strategies[i];
+    }
+  }
+
+  return NULL;
+}
+
+/* Reset stats to hold no games */
+static void
+init_sim_stats(sim_stats* stats)
+{
+  memset(stats, 0, sizeof(sim_stats));
+
+  for (size_t slot = 0; slot < ENGINE_MAX_SEATS; ++slot) {
+    stats->slots[slot].min_score = INT_MAX;
+    stats->slots[slot].max_score = INT_MIN;
+  }
+}
+
+void
+play_sim_game(engine* engine_obj, const sim_options* options, size_t game,
+              sim_stats* stats)
+{
+  size_t num_seats = options->num_seats;
+  sim_seat seats[ENGINE_MAX_SEATS];
+  size_t seat_slots[ENGINE_MAX_SEATS];
+  rng agent_rng;
+
+  seed_engine(engine_obj, options->seed, 2*(uint64_t) game);
+  rng_init(&agent_rng, options->seed, 2*(uint64_t) game + 1);
+
+  /* Rotate the lineup around the table, so no slot always plays first */
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    size_t slot = (seat + game) % num_seats;
+
+    seat_slots[seat] = slot;
+    seats[seat].rng_obj = &agent_rng;
+    seats[seat].stats = &stats->slots[slot];
+
+    engine_agent agent = {
+      options->lineup[slot]->act, count_billionaires, &seats[seat]
+    };
+
+    set_engine_agent(engine_obj, seat, &agent);
+  }
+
+  size_t start_turns = engine_obj->num_turns;
+  size_t start_trades = engine_obj->num_trades;
+  size_t start_rounds = engine_obj->num_rounds;
+
+  stats->num_games++;
+
+  if (!engine_play_game(engine_obj, options->max_turns)) {
+    stats->num_unfinished++;
+    return;
+  }
+
+  size_t turns = engine_obj->num_turns - start_turns;
+  size_t rounds = engine_obj->num_rounds - start_rounds;
+
+  stats->total_turns += turns;
+  stats->total_trades += engine_obj->num_trades - start_trades;
+  stats->total_rounds += rounds;
+  stats->round_hist[rounds < SIM_MAX_ROUNDS ? rounds : SIM_MAX_ROUNDS]++;
+
+  if (turns > stats->max_game_turns) {
+    stats->max_game_turns = turns;
+  }
+
+  int best_score = INT_MIN;
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    if (get_engine_score(engine_obj, seat) > best_score) {
+      best_score = get_engine_score(engine_obj, seat);
+    }
+  }
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    sim_slot_stats* slot_stats = &stats->slots[seat_slots[seat]];
+    int score = get_engine_score(engine_obj, seat);
+    int bucket = (score - SIM_SCORE_MIN)/SIM_SCORE_STEP;
+
+    if (score < SIM_SCORE_MIN) {
+      bucket = 0;
+    }
+    else if (bucket >= SIM_SCORE_BUCKETS) {
+      bucket = SIM_SCORE_BUCKETS - 1;
+    }
+
+    slot_stats->wins += (score == best_score);
+    slot_stats->score_sum += score;
+    slot_stats->score_sq_sum += (double) score*score;
+    slot_stats->score_hist[bucket]++;
+
+    if (score < slot_stats->min_score) {
+      slot_stats->min_score = score;
+    }
+
+    if (score > slot_stats->max_score) {
+      slot_stats->max_score = score;
+    }
+  }
+}
+
+/* Claim the next batch of games of a queue, returning false if it has
+   none left */
+static bool
+claim_games(sim_queue* queue, size_t* first, size_t* last)
+{
+  /* Checking first keeps thieves from pushing on the counter of a queue
+     that is already empty */
+  if (atomic_load_explicit(&queue->next, memory_order_relaxed) >= queue->end) {
+    return false;
+  }
+
+  size_t start = atomic_fetch_add_explicit(&queue->next, SIM_BATCH_GAMES,
+                                           memory_order_relaxed);
+
+  if (start >= queue->end) {
+    return false;
+  }
+
+  *first = start;
+  *last = (start + SIM_BATCH_GAMES < queue->end) ?
+    start + SIM_BATCH_GAMES : queue->end;
+
+  return true;
+}
+
+void*
+run_sim_worker(void* arg)
+{
+  sim_worker* worker = arg;
+  const sim_options* options = worker->options;
+  size_t first, last;
+
+  /* The engine is made by the thread that plays it, so its memory is
+     local to the thread */
+  engine* engine_obj = engine_new(options->num_seats,
+                                  options->has_billionaire,
+                                  options->has_taxman, options->seed, 0);
+
+  init_sim_stats(&worker->stats);
+
+  while (claim_games(&worker->queues[worker->id], &first, &last)) {
+    for (size_t game = first; game < last; ++game) {
+      play_sim_game(engine_obj, options, game, &worker->stats);
+    }
+  }
+
+  /* Steal from the other queues in turn, starting after our own so that
+     thieves spread out over their victims */
+  bool stole = true;
+
+  while (stole) {
+    stole = false;
+
+    for (size_t i = 1; i < worker->num_workers; ++i) {
+      size_t victim = (worker->id + i) % worker->num_workers;
+
+      while (claim_games(&worker->queues[victim], &first, &last)) {
+        for (size_t game = first; game < last; ++game) {
+          play_sim_game(engine_obj, options, game, &worker->stats);
+        }
+
+        worker->num_stolen += last - first;
+        stole = true;
+      }
+    }
+  }
+
+  free_engine(engine_obj);
+
+  return NULL;
+}
+
+void
+merge_sim_stats(sim_stats* total, const sim_stats* stats)
+{
+  total->num_games += stats->num_games;
+  total->num_unfinished += stats->num_unfinished;
+  total->total_turns += stats->total_turns;
+  total->total_trades += stats->total_trades;
+  total->total_rounds += stats->total_rounds;
+
+  if (stats->max_game_turns > total->max_game_turns) {
+    total->max_game_turns = stats->max_game_turns;
+  }
+
+  for (size_t i = 0; i <= SIM_MAX_ROUNDS; ++i) {
+    total->round_hist[i] += stats->round_hist[i];
+  }
+
+  for (size_t slot = 0; slot < ENGINE_MAX_SEATS; ++slot) {
+    sim_slot_stats* total_slot = &total->slots[slot];
+    const sim_slot_stats* slot_stats = &stats->slots[slot];
+
+    total_slot->wins += slot_stats->wins;
+    total_slot->billionaires += slot_stats->billionaires;
+    total_slot->score_sum += slot_stats->score_sum;
+    total_slot->score_sq_sum += slot_stats->score_sq_sum;
+
+    if (slot_stats->min_score < total_slot->min_score) {
+      total_slot->min_score = slot_stats->min_score;
+    }
+
+    if (slot_stats->max_score > total_slot->max_score) {
+      total_slot->max_score = slot_stats->max_score;
+    }
+
+    for (size_t i = 0; i < SIM_SCORE_BUCKETS; ++i) {
+      total_slot->score_hist[i] += slot_stats->score_hist[i];
+    }
+  }
+}
+
+/* Return the fewest rounds that at least a fraction of finished games
+   took */
+static size_t
+round_percentile(const sim_stats* stats, double fraction)
+{
+  size_t num_finished = stats->num_games - stats->num_unfinished;
+  size_t seen = 0;
+
+  for (size_t rounds = 0; rounds < SIM_MAX_ROUNDS; ++rounds) {
+    seen += stats->round_hist[rounds];
+
+    if ((double) seen >= fraction*(double) num_finished) {
+      return rounds;
+    }
+  }
+
+  return SIM_MAX_ROUNDS;
+}
+
+void
+print_sim_stats(const sim_options* options, const sim_stats* stats)
+{
+  size_t num_finished = stats->num_games - stats->num_unfinished;
+
+  printf("Games: %zu finished, %zu stopped after %zu turns\n",
+         num_finished, stats->num_unfinished, options->max_turns);
+
+  if (num_finished == 0) {
+    return;
+  }
+
+  double n = (double) num_finished;
+
+  printf("Length: %.2f rounds (p50 %zu, p90 %zu, p99 %zu%s), "
+         "%.1f turns (longest %zu), %.1f trades\n",
+         (double) stats->total_rounds/n,
+         round_percentile(stats, 0.5), round_percentile(stats, 0.9),
+         round_percentile(stats, 0.99),
+         stats->round_hist[SIM_MAX_ROUNDS] > 0 ? "+" : "",
+         (double) stats->total_turns/n, stats->max_game_turns,
+         (double) stats->total_trades/n);
+
+  printf("\n%-4s %-10s %9s %16s %12s %10s %8s %7s %7s\n", "slot", "strategy",
+         "wins", "win rate", "billionaires", "mean", "sd", "min", "max");
+
+  for (size_t slot = 0; slot < options->num_seats; ++slot) {
+    const sim_slot_stats* slot_stats = &stats->slots[slot];
+    double win_rate = (double) slot_stats->wins/n;
+    double mean = (double) slot_stats->score_sum/n;
+    double var = slot_stats->score_sq_sum/n - mean*mean;
+
+    /* Normal approximation of the 95% confidence interval */
+    double margin = 1.96*sqrt(win_rate*(1.0 - win_rate)/n);
+
+    printf("%-4zu %-10s %9zu %7.2f%% +-%5.2f %12zu %10.1f %8.1f %7d %7d\n",
+           slot, options->lineup[slot]->name, slot_stats->wins,
+           100.0*win_rate, 100.0*margin, slot_stats->billionaires, mean,
+           sqrt(var > 0.0 ? var : 0.0), slot_stats->min_score,
+           slot_stats->max_score);
+  }
+
+  printf("\nFinal scores\n%-14s", "score");
+
+  for (size_t slot = 0; slot < options->num_seats; ++slot) {
+    printf(" %9zu", slot);
+  }
+
+  printf("\n");
+
+  for (size_t i = 0; i < SIM_SCORE_BUCKETS; ++i) {
+    size_t bucket_total = 0;
+
+    for (size_t slot = 0; slot < options->num_seats; ++slot) {
+      bucket_total += stats->slots[slot].score_hist[i];
+    }
+
+    if (bucket_total == 0) {
+      continue;
+    }
+
+    int low = SIM_SCORE_MIN + (int) i*SIM_SCORE_STEP;
+    char label[32];
+
+    if (i == 0) {
+      snprintf(label, sizeof(label), "< %d", low + SIM_SCORE_STEP);
+    }
+    else if (i == SIM_SCORE_BUCKETS - 1) {
+      snprintf(label, sizeof(label), ">= %d", low);
+    }
+    else {
+      snprintf(label, sizeof(label), "%d..%d", low, low + SIM_SCORE_STEP - 1);
+    }
+
+    printf("%-14s", label);
+
+    for (size_t slot = 0; slot < options->num_seats; ++slot) {
+      printf(" %9zu", stats->slots[slot].score_hist[i]);
+    }
+
+    printf("\n");
+  }
+}
+
+void
+parse_sim_options(int argc, char** argv, sim_options* options,
+                  int* num_threads)
+{
+  char* agent_names = NULL;
+
+  while (true) {
+    static struct option long_options[] = {
+      {"players",        required_argument, 0, 'p'},
+      {"no-billionaire", no_argument,       0, 'b'},
+      {"no-taxman",      no_argument,       0, 't'},
+      {"seed",           required_argument, 0, 's'},
+      {"games",          required_argument, 0, 'g'},
+      {"max-turns",      required_argument, 0, 'm'},
+      {"agents",         required_argument, 0, 'a'},
+      {"threads",        required_argument, 0, 'n'},
+      {"help",           no_argument,       0, 'h'},
+      {0,                0,                 0, 0}
+    };
+
+    int option_index = 0;
+
+    int c = getopt_long(argc, argv, "p:bts:g:m:a:n:h", long_options,
+                        &option_index);
+
+    /* End of options has been reached */
+    if (c == -1)
+      break;
+
+    switch (c) {
+      case 'p':
+        options->num_seats = (size_t) strtol(optarg, NULL, 10);
+        if (options->num_seats < 2 || options->num_seats > ENGINE_MAX_SEATS) {
+          errx(1, "player count must be between 2 and %d", ENGINE_MAX_SEATS);
+        }
+        break;
+
+      case 'b':
+        options->has_billionaire = false;
+        break;
+
+      case 't':
+        options->has_taxman = false;
+        break;
+
+      case 's':
+        options->seed = (uint64_t) strtoull(optarg, NULL, 10);
+        break;
+
+      case 'g':
+        options->num_games = (size_t) strtoull(optarg, NULL, 10);
+        break;
+
+      case 'm':
+        options->max_turns = (size_t) strtoull(optarg, NULL, 10);
+        break;
+
+      case 'a':
+        agent_names = optarg;
+        break;
+
+      case 'n':
+        *num_threads = (int) strtol(optarg, NULL, 10);
+        if (*num_threads < 1 || *num_threads > SIM_MAX_THREADS) {
+          errx(1, "thread count must be between 1 and %d", SIM_MAX_THREADS);
+        }
+        break;
+
+      case 'h':
+        printf("billionaire-sim: play many games of Billionaire between built-in strategies\n");
+        printf("\n");
+        printf("  -p,--players N\tSet number of players (default: 4)\n");
+        printf("  -b,--no-billionaire\tRemove billionaire from play\n");
+        printf("  -t,--no-taxman\tRemove taxman from play\n");
+        printf("  -s,--seed N\t\tSet the random seed (default: random)\n");
+        printf("  -g,--games N\t\tPlay N games (default: 10000)\n");
+        printf("  -m,--max-turns N\tStop a game after N turns (default: %d)\n",
+               SIM_MAX_TURNS);
+        printf("  -a,--agents LIST\tComma separated strategies, repeated to fill\n");
+        printf("\t\t\tthe table (default: collector)\n");
+        printf("  -n,--threads N\tRun N threads (default: one per core)\n");
+        printf("  -h,--help\t\tDisplay this help and quit\n");
+        printf("\n");
+        printf("Strategies:");
+
+        for (size_t i = 0; i < sizeof(strategies)/sizeof(sim_strategy); ++i) {
+          printf(" %s", strategies[i].name);
+        }
+
+        printf("\n");
+        exit(1);
+
+      default:
+        exit(1);
+    }
+  }
+
+  /* The lineup is filled once the number of seats is known */
+  const sim_strategy* named[ENGINE_MAX_SEATS];
+  size_t num_named = 0;
+
+  if (agent_names == NULL) {
+    named[num_named++] = find_strategy("collector");
+  }
+  else {
+    char* save_ptr = NULL;
+
+    for (char* name = strtok_r(agent_names, ",", &save_ptr); name != NULL;
+         name = strtok_r(NULL, ",", &save_ptr)) {
+      if (num_named == ENGINE_MAX_SEATS) {
+        errx(1, "more than %d strategies given", ENGINE_MAX_SEATS);
+      }
+
+      named[num_named] = find_strategy(name);
+
+      if (named[num_named] == NULL) {
+        errx(1, "unknown strategy '%s'", name);
+      }
+
+      num_named++;
+    }
+
+    if (num_named == 0) {
+      errx(1, "no strategies given");
+    }
+  }
+
+  for (size_t slot = 0; slot < options->num_seats; ++slot) {
+    options->lineup[slot] = named[slot % num_named];
+  }
+}
+
+/* Return the time in seconds from an arbitrary starting point */
+static double
+now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec*1e-9;
+}
+
+int
+main(int argc, char** argv)
+{
+  /* Default parameters */
+  sim_options options = {
+    .num_seats = 4,
+    .has_billionaire = true,
+    .has_taxman = true,
+    .seed = mix(clock(), time(NULL), getpid()),
+    .num_games = 10000,
+    .max_turns = SIM_MAX_TURNS
+  };
+  long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_threads = (num_cores < 1) ? 1 :
+    (num_cores > SIM_MAX_THREADS) ? SIM_MAX_THREADS : (int) num_cores;
+
+  parse_sim_options(argc, argv, &options, &num_threads);
+
+  size_t num_workers = (size_t) num_threads;
+  sim_worker* workers = aligned_alloc(SIM_CACHE_LINE,
+                                      num_workers*sizeof(sim_worker));
+  sim_queue* queues = aligned_alloc(SIM_CACHE_LINE,
+                                    num_workers*sizeof(sim_queue));
+
+  if (workers == NULL || queues == NULL) {
+    err(1, "workers malloc failed");
+  }
+
+  memset(workers, 0, num_workers*sizeof(sim_worker));
+
+  /* Each worker starts with an even share of the games */
+  for (size_t i = 0; i < num_workers; ++i) {
+    atomic_init(&queues[i].next, i*options.num_games/num_workers);
+    queues[i].end = (i + 1)*options.num_games/num_workers;
+
+    workers[i].id = i;
+    workers[i].options = &options;
+    workers[i].queues = queues;
+    workers[i].num_workers = num_workers;
+  }
+
+  printf("Playing %zu games of %zu players on %zu threads with seed %"
+         PRIu64 "\n", options.num_games, options.num_seats, num_workers,
+         options.seed);
+
+  double start = now_seconds();
+
+  /* The main thread runs the first worker itself */
+  for (size_t i = 1; i < num_workers; ++i) {
+    if (pthread_create(&workers[i].thread, NULL, run_sim_worker,
+                       &workers[i]) != 0) {
+      errx(1, "failed to start worker %zu", i);
+    }
+  }
+
+  run_sim_worker(&workers[0]);
+
+  for (size_t i = 1; i < num_workers; ++i) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  double elapsed = now_seconds() - start;
+
+  sim_stats total;
+  size_t num_stolen = 0;
+
+  init_sim_stats(&total);
+
+  for (size_t i = 0; i < num_workers; ++i) {
+    merge_sim_stats(&total, &workers[i].stats);
+    num_stolen += workers[i].num_stolen;
+  }
+
+  printf("Played in %.3f s, %.0f games/s, %zu games stolen\n", elapsed,
+         (double) total.num_games/elapsed, num_stolen);
+
+  print_sim_stats(&options, &total);
+
+  free(queues);
+  free(workers);
+
+  return 0;
+}
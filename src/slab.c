@@ -0,0 +1,193 @@
+#include "slab.h"
+
+#include <err.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Alignment of every object, suitable for any type */
+#define SLAB_ALIGN _Alignof(max_align_t)
+
+/* Round a size up to a whole number of SLAB_ALIGN */
+#define SLAB_ROUND(size) (((size) + SLAB_ALIGN - 1)/SLAB_ALIGN*SLAB_ALIGN)
+
+/**
+ * A block of objects, preceded by a link to the next chunk.
+ */
+struct slab_chunk {
+  slab_chunk* next;
+};
+
+/* Return the address of an object within a chunk. */
+static void*
+chunk_obj(const slab* slab_obj, slab_chunk* chunk, size_t index)
+{
+  return (char*) chunk + SLAB_ROUND(sizeof(slab_chunk)) +
+         index*slab_obj->obj_size;
+}
+
+/* Request a chunk from the system and link it after the last chunk,
+   or first if there is no chunk yet. */
+static slab_chunk*
+append_chunk(slab* slab_obj, slab_chunk* last)
+{
+  slab_chunk* chunk = malloc(SLAB_ROUND(sizeof(slab_chunk)) +
+                             slab_obj->chunk_objs*slab_obj->obj_size);
+
+  if (chunk == NULL) {
+    err(1, "chunk malloc failed");
+  }
+
+  chunk->next = NULL;
+
+  if (last != NULL) {
+    last->next = chunk;
+  }
+  else {
+    slab_obj->chunks = chunk;
+  }
+
+  slab_obj->stats.num_chunks++;
+
+  return chunk;
+}
+
+/* Move on to the next chunk to carve objects from, requesting one from
+   the system if every chunk has been used. */
+static void
+next_chunk(slab* slab_obj)
+{
+  slab_chunk* chunk = (slab_obj->current != NULL) ? slab_obj->current->next
+                                                  : slab_obj->chunks;
+
+  if (chunk == NULL) {
+    chunk = append_chunk(slab_obj, slab_obj->current);
+  }
+
+  slab_obj->current = chunk;
+  slab_obj->current_used = 0;
+}
+
+slab*
+slab_new(size_t obj_size, size_t chunk_objs)
+{
+  slab* new_slab = malloc(sizeof(slab));
+
+  if (new_slab == NULL) {
+    err(1, "new_slab malloc failed");
+  }
+
+  /* Freed objects must be able to hold the free list link */
+  if (obj_size < sizeof(void*)) {
+    obj_size = sizeof(void*);
+  }
+
+  new_slab->obj_size = SLAB_ROUND(obj_size);
+  new_slab->chunk_objs = (chunk_objs > 0) ? chunk_objs : 1;
+  new_slab->free_list = NULL;
+  new_slab->chunks = NULL;
+  new_slab->current = NULL;
+  new_slab->current_used = 0;
+
+  memset(&new_slab->stats, 0, sizeof(slab_stats));
+
+  return new_slab;
+}
+
+void
+slab_reserve(slab* slab_obj, size_t num_objs)
+{
+  slab_chunk* last = NULL;
+  size_t capacity = 0;
+
+  for (slab_chunk* chunk = slab_obj->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    last = chunk;
+    capacity += slab_obj->chunk_objs;
+  }
+
+  while (capacity < num_objs) {
+    last = append_chunk(slab_obj, last);
+    capacity += slab_obj->chunk_objs;
+  }
+}
+
+void*
+slab_alloc(slab* slab_obj)
+{
+  void* obj = slab_obj->free_list;
+
+  if (obj != NULL) {
+    memcpy(&slab_obj->free_list, obj, sizeof(void*));
+  }
+
+  else {
+    if (slab_obj->current == NULL ||
+        slab_obj->current_used == slab_obj->chunk_objs) {
+      next_chunk(slab_obj);
+    }
+
+    obj = chunk_obj(slab_obj, slab_obj->current, slab_obj->current_used++);
+  }
+
+  slab_obj->stats.num_allocs++;
+  slab_obj->stats.num_live++;
+
+  if (slab_obj->stats.num_live > slab_obj->stats.peak_live) {
+    slab_obj->stats.peak_live = slab_obj->stats.num_live;
+  }
+
+  return obj;
+}
+
+void
+slab_free(slab* slab_obj, void* obj)
+{
+  if (obj == NULL) {
+    return;
+  }
+
+  memcpy(obj, &slab_obj->free_list, sizeof(void*));
+  slab_obj->free_list = obj;
+
+  slab_obj->stats.num_frees++;
+  slab_obj->stats.num_live--;
+}
+
+void
+slab_reset(slab* slab_obj)
+{
+  slab_obj->free_list = NULL;
+  slab_obj->current = NULL;
+  slab_obj->current_used = 0;
+
+  /* Carve from the first chunk again, if there is one */
+  if (slab_obj->chunks != NULL) {
+    slab_obj->current = slab_obj->chunks;
+  }
+
+  slab_obj->stats.num_frees += slab_obj->stats.num_live;
+  slab_obj->stats.num_live = 0;
+  slab_obj->stats.num_resets++;
+}
+
+const slab_stats*
+get_slab_stats(const slab* slab_obj)
+{
+  return &slab_obj->stats;
+}
+
+void
+free_slab(slab* slab_obj)
+{
+  slab_chunk* chunk = slab_obj->chunks;
+
+  while (chunk != NULL) {
+    slab_chunk* next = chunk->next;
+
+    free(chunk);
+
+    chunk = next;
+  }
+
+  free(slab_obj);
+}
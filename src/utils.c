@@ -34,20 +34,22 @@ mix(uint32_t a, uint32_t b, uint32_t c)
   return c;
 }
 
-char*
+uint32_t
 hash_addr(const char* addr)
 {
-  uint32_t hash = hash_xxhash(addr);
+  return hash_xxhash(addr);
+}
 
-  char* hash_str = calloc(HASH_LENGTH, sizeof(char));
+size_t
+encode_client_id(char* dest, uint32_t id)
+{
+  static const char hex_digits[] = "0123456789abcdef";
 
-  if (hash_str == NULL) {
-    err(1, "hash_str malloc failed");
+  for (size_t i = 0; i < CLIENT_ID_DIGITS; ++i) {
+    dest[i] = hex_digits[(id >> (4*(CLIENT_ID_DIGITS - 1 - i))) & 0xf];
   }
 
-  snprintf(hash_str, HASH_LENGTH, "%08x", hash);
-
-  return hash_str;
+  return CLIENT_ID_DIGITS;
 }
 
 const char*
@@ -58,8 +60,35 @@ JSON_to_str(json_object* json_obj, size_t* str_len)
                                            str_len);
 }
 
+size_t
+encode_JSON_string(char* dest, const char* str, size_t str_len)
+{
+  size_t len = 0;
+
+  dest[len++] = '"';
+
+  for (size_t i = 0; i < str_len; ++i) {
+    unsigned char c = (unsigned char) str[i];
+
+    if (c == '"' || c == '\\') {
+      dest[len++] = '\\';
+      dest[len++] = (char) c;
+    }
+    else if (c < 0x20) {
+      len += (size_t) snprintf(dest + len, 7, "\\u%04x", c);
+    }
+    else {
+      dest[len++] = (char) c;
+    }
+  }
+
+  dest[len++] = '"';
+
+  return len;
+}
+
 json_object*
-str_to_JSON(const char* json_str, size_t json_str_len)
+str_to_JSON(const char* json_str, size_t json_str_len, cmd_result* res)
 {
   enum json_tokener_error jerr;
 
@@ -74,7 +103,7 @@ str_to_JSON(const char* json_str, size_t json_str_len)
 
   /* Malformed JSON */
   if (jerr != json_tokener_success) {
-    cmd_errno = (int) jerr;
+    res->err = (int) jerr;
     return NULL;
   }
 
@@ -82,7 +111,7 @@ str_to_JSON(const char* json_str, size_t json_str_len)
 }
 
 json_object*
-get_JSON_value(json_object* json_obj, const char* key)
+get_JSON_value(json_object* json_obj, const char* key, cmd_result* res)
 {
   json_bool has_field;
   json_object* json_value = NULL;
@@ -92,7 +121,7 @@ get_JSON_value(json_object* json_obj, const char* key)
                                         &json_value);
 
   if (!has_field || json_value == NULL) {
-    cmd_errno = (int) EJSONVAL;
+    res->err = (int) EJSONVAL;
     return NULL;
   }
 
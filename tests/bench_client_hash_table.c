@@ -0,0 +1,114 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "client.h"
+#include "client_hash_table.h"
+#include "utils.h"
+
+/* Lookups per measurement */
+#define NUM_LOOKUPS 4000000
+
+/* Largest number of clients a table is filled with */
+#define MAX_CLIENTS 65536
+
+static client clients[MAX_CLIENTS];
+static char ids[MAX_CLIENTS][CLIENT_ID_DIGITS + 1];
+static uint32_t missing_keys[MAX_CLIENTS];
+
+/* Results are accumulated here so no loop can be optimised away */
+static volatile uintptr_t sink;
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec*1e9 + (double) ts.tv_nsec;
+}
+
+static void
+report(size_t num_clients, const char* name, double start_ns)
+{
+  double ns = (now_ns() - start_ns)/NUM_LOOKUPS;
+
+  printf("%8zu clients  %-22s %8.3f ns/lookup\n", num_clients, name, ns);
+}
+
+static uint32_t
+random_key()
+{
+  return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+int
+main()
+{
+  static const size_t sizes[] = {8, 256, 4096, MAX_CLIENTS};
+
+  srand(1);
+
+  for (size_t i = 0; i < MAX_CLIENTS; ++i) {
+    clients[i].id = random_key();
+    encode_client_id(ids[i], clients[i].id);
+    missing_keys[i] = random_key();
+  }
+
+  for (size_t s = 0; s < sizeof(sizes)/sizeof(size_t); ++s) {
+    size_t num_clients = sizes[s];
+    client_hash_table* table_obj = client_hash_table_new(0);
+    size_t total_dist = 0;
+
+    for (size_t i = 0; i < num_clients; ++i) {
+      put_client(table_obj, &clients[i]);
+    }
+
+    /* Finish moving into the final array before measuring */
+    for (size_t i = 0; i < num_clients; ++i) {
+      del_client(table_obj, &clients[i]);
+      put_client(table_obj, &clients[i]);
+    }
+
+    for (size_t i = 0; i < table_obj->capacity; ++i) {
+      total_dist += table_obj->slots[i].dist;
+    }
+
+    printf("%8zu clients  %zu slots, %.3f mean probe length\n", num_clients,
+           table_obj->capacity, (double) total_dist/num_clients);
+
+    double start_ns = now_ns();
+
+    for (size_t n = 0; n < NUM_LOOKUPS; ++n) {
+      sink += (uintptr_t) get_client(table_obj,
+                                     clients[n & (num_clients - 1)].id);
+    }
+
+    report(num_clients, "hit", start_ns);
+
+    start_ns = now_ns();
+
+    for (size_t n = 0; n < NUM_LOOKUPS; ++n) {
+      sink += (uintptr_t) get_client(table_obj,
+                                     missing_keys[n & (MAX_CLIENTS - 1)]);
+    }
+
+    report(num_clients, "miss", start_ns);
+
+    /* Hashing an ID string on every lookup, as the chained table did */
+    start_ns = now_ns();
+
+    for (size_t n = 0; n < NUM_LOOKUPS; ++n) {
+      sink += hash_xxhash(ids[n & (num_clients - 1)]);
+    }
+
+    report(num_clients, "xxHash of ID only", start_ns);
+
+    free_client_hash_table(table_obj);
+  }
+
+  return 0;
+}
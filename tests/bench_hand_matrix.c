@@ -0,0 +1,91 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "card_location.h"
+#include "hand_matrix.h"
+#include "hand_reference.h"
+
+/* Seats scored per pass, as in a batch of simulated tables */
+#define NUM_SEATS 4096
+
+/* Passes over the seats per measurement */
+#define NUM_PASSES 2000
+
+static card_location hands[NUM_SEATS];
+static bool won[NUM_SEATS];
+static int scores[NUM_SEATS];
+
+/* Results are accumulated here so no loop can be optimised away */
+static volatile long sink;
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec*1e9 + (double) ts.tv_nsec;
+}
+
+static void
+report(const char* name, double start_ns)
+{
+  double ns = (now_ns() - start_ns)/((double) NUM_SEATS*NUM_PASSES);
+
+  printf("%-28s %8.3f ns/seat\n", name, ns);
+}
+
+int
+main()
+{
+  static const char* kernel_names[] = {"auto", "scalar", "sse2", "avx2"};
+  uint8_t counts[TOTAL_UNIQUE_CARDS];
+  hand_matrix* matrix = hand_matrix_new(NUM_SEATS);
+
+  srand(1);
+
+  for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+    ref_random_hand(counts, &hands[seat], CARD_MAX_AMOUNT);
+    set_hand_matrix_seat(matrix, seat, &hands[seat]);
+  }
+
+  /* One card_location at a time, as update_score used to */
+  double start_ns = now_ns();
+
+  for (size_t pass = 0; pass < NUM_PASSES; ++pass) {
+    for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+      won[seat] = has_won(&hands[seat]);
+      scores[seat] = evaluate_hand_score(&hands[seat]);
+    }
+
+    sink += scores[pass % NUM_SEATS];
+  }
+
+  report("card_location", start_ns);
+
+  for (hand_kernel kernel = HAND_KERNEL_SCALAR; kernel <= HAND_KERNEL_AVX2;
+       ++kernel) {
+    if (!hand_kernel_supported(kernel)) {
+      printf("%-28s unsupported\n", kernel_names[kernel]);
+      continue;
+    }
+
+    start_ns = now_ns();
+
+    for (size_t pass = 0; pass < NUM_PASSES; ++pass) {
+      evaluate_hand_matrix_with(matrix, kernel, won, scores);
+      sink += scores[pass % NUM_SEATS];
+    }
+
+    report(kernel_names[kernel], start_ns);
+  }
+
+  free_hand_matrix(matrix);
+
+  return 0;
+}
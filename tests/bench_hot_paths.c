@@ -0,0 +1,575 @@
+/* For syscall(), dup() and socketpair() */
+#define _DEFAULT_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <event2/buffer.h>
+#include <event2/event.h>
+
+#include "book.h"
+#include "card_array.h"
+#include "card_location.h"
+#include "client.h"
+#include "client_hash_table.h"
+#include "command.h"
+#include "command_error.h"
+#include "hand_reference.h"
+#include "rng.h"
+
+/* Operations per measurement, unless a benchmark sets its own */
+#define NUM_OPS (1 << 20)
+
+/* Measurements of each benchmark, of which the median is reported */
+#define NUM_REPEATS 5
+
+/* Distinct hands cycled through, small enough to stay in cache */
+#define NUM_HANDS 4096
+
+/* Clients in the hash table, and seated at the table sent commands */
+#define NUM_CLIENTS 4096
+#define NUM_SEATS 4
+
+typedef struct bench bench;
+typedef struct bench_result bench_result;
+
+/**
+ * A benchmark of one hot path, run over freshly set up state.
+ */
+struct bench {
+  const char* name;
+
+  /* Operations per measurement, or 0 for NUM_OPS */
+  size_t num_ops;
+
+  /* Whether the path logs to stdout, which is sent to /dev/null while
+     it is measured */
+  bool noisy;
+
+  void (*run)(size_t num_ops);
+};
+
+/**
+ * What one measurement of a benchmark cost per operation.
+ */
+struct bench_result {
+  double ns;
+  double allocs;
+  double cycles;
+};
+
+/* Results are accumulated here so no loop can be optimised away */
+static volatile long sink;
+
+/* Allocations are counted by wrapping glibc's allocator, which also
+   sees those made inside libevent and json-c */
+#ifdef __GLIBC__
+static size_t num_allocs;
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+void*
+malloc(size_t size)
+{
+  num_allocs++;
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t num, size_t size)
+{
+  num_allocs++;
+  return __libc_calloc(num, size);
+}
+
+void*
+realloc(void* ptr, size_t size)
+{
+  num_allocs++;
+  return __libc_realloc(ptr, size);
+}
+
+void*
+aligned_alloc(size_t alignment, size_t size)
+{
+  num_allocs++;
+  return __libc_memalign(alignment, size);
+}
+
+static size_t
+count_allocs(void)
+{
+  return num_allocs;
+}
+#else
+static size_t
+count_allocs(void)
+{
+  return 0;
+}
+#endif /* __GLIBC__ */
+
+/* Core cycles spent in user space are counted where perf events are
+   allowed, otherwise cycles of the timestamp counter */
+static int cycles_fd = -1;
+static const char* cycle_source = "none";
+
+static void
+open_cycle_counter(void)
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  cycles_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+  if (cycles_fd >= 0) {
+    cycle_source = "cpu";
+    return;
+  }
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+  cycle_source = "tsc";
+#endif
+}
+
+static uint64_t
+read_cycles(void)
+{
+  uint64_t count = 0;
+
+  if (cycles_fd >= 0) {
+    if (read(cycles_fd, &count, sizeof(count)) != sizeof(count)) {
+      count = 0;
+    }
+
+    return count;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  count = __rdtsc();
+#endif
+
+  return count;
+}
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec*1e9 + (double) ts.tv_nsec;
+}
+
+/* Hand operations */
+
+static card_location hands[NUM_HANDS];
+static card_location offers[NUM_HANDS];
+
+static void
+run_validate_offer(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    cmd_result res = CMD_RESULT_INIT;
+    validate_offer(&offers[n % NUM_HANDS], &hands[n % NUM_HANDS], &res);
+    sink += res.err;
+  }
+}
+
+/* Subtract then merge back, so the hands are the same every pass */
+static void
+run_subtract_merge(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    cmd_result res = CMD_RESULT_INIT;
+    subtract_card_location(&hands[n % NUM_HANDS], &offers[n % NUM_HANDS],
+                           &res);
+
+    if (!cmd_failed(&res)) {
+      merge_card_location(&hands[n % NUM_HANDS], &offers[n % NUM_HANDS]);
+    }
+  }
+}
+
+static void
+run_has_won(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    sink += has_won(&hands[n % NUM_HANDS]);
+  }
+}
+
+static void
+run_evaluate_hand_score(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    sink += evaluate_hand_score(&hands[n % NUM_HANDS]);
+  }
+}
+
+/* Book operations */
+
+static book* trades;
+
+/* An offer rests on the book, then another owner's offer trades with
+   it */
+static void
+run_fill_offer(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    card_id card = (card_id) (n % TOTAL_COMMODITY_AMOUNT);
+    size_t amount = OFFER_MIN_CARDS + n % (OFFER_MAX_CARDS - 1);
+
+    offer* resting = offer_init_cards(trades, card, amount, 1);
+    offer* taker = offer_init_cards(trades, card, amount, 2);
+
+    sink += (fill_offer(trades, resting) == NULL);
+
+    offer* traded = fill_offer(trades, taker);
+
+    free_offer(trades, traded);
+    free_offer(trades, taker);
+  }
+}
+
+/* An offer rests on the book and is taken back */
+static void
+run_cancel_offer(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    card_id card = (card_id) (n % TOTAL_COMMODITY_AMOUNT);
+    size_t amount = OFFER_MIN_CARDS + n % (OFFER_MAX_CARDS - 1);
+    cmd_result res = CMD_RESULT_INIT;
+
+    fill_offer(trades, offer_init_cards(trades, card, amount, 1));
+    free_offer(trades, cancel_offer(trades, amount, 1, &res));
+  }
+}
+
+/* Dealing */
+
+static card_array* deck;
+static card_location dealt[NUM_SEATS];
+static rng shuffler;
+
+static void
+run_deal_cards_to_hands(size_t num_ops)
+{
+  card_location* player_hands[NUM_SEATS];
+
+  for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+    player_hands[seat] = &dealt[seat];
+  }
+
+  for (size_t n = 0; n < num_ops; ++n) {
+    shuffle_card_array(deck, &shuffler);
+    deal_cards_to_hands(NUM_SEATS, deck, player_hands);
+    sink += (long) dealt[0].card_counts;
+  }
+}
+
+/* The allocating deal_cards(), for comparison */
+static void
+run_deal_cards(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    shuffle_card_array(deck, &shuffler);
+    card_location** player_hands = deal_cards(NUM_SEATS, deck);
+
+    sink += (long) player_hands[0]->card_counts;
+
+    for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+      free_card_location(player_hands[seat]);
+    }
+
+    free(player_hands);
+  }
+}
+
+/* Clients */
+
+static client clients[NUM_CLIENTS];
+static client_hash_table* hashed_clients;
+
+static void
+run_get_client(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    sink += (long) (uintptr_t)
+      get_client(hashed_clients, clients[n % NUM_CLIENTS].id);
+  }
+}
+
+/* A client leaves and joins again */
+static void
+run_del_put_client(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    del_client(hashed_clients, &clients[n % NUM_CLIENTS]);
+    put_client(hashed_clients, &clients[n % NUM_CLIENTS]);
+  }
+}
+
+/* Protocol */
+
+static const char offer_packet[] =
+  "{\"commands\":[{\"command\":\"NEW_OFFER\",\"cards\":"
+  "[{\"id\":2,\"amt\":3},{\"id\":10,\"amt\":1}]}]}";
+
+static void
+run_parse_command_list_string(size_t num_ops)
+{
+  for (size_t n = 0; n < num_ops; ++n) {
+    cmd_result res = CMD_RESULT_INIT;
+    json_object* cmd_array =
+      parse_command_list_string(offer_packet, sizeof(offer_packet) - 1, &res);
+
+    sink += res.err;
+    json_object_put(cmd_array);
+  }
+}
+
+static struct event_base* evbase;
+static client_head table;
+static client* seated[NUM_SEATS];
+
+/* A BOOK_EVENT is queued for a table and sent, as after every offer,
+   and what the clients were sent is thrown away */
+static void
+run_send_commands(size_t num_ops)
+{
+  uint32_t participants[MAX_PARTICIPANTS] = {seated[0]->id};
+
+  for (size_t n = 0; n < num_ops; ++n) {
+    command* book_event = command_book_event(Command.NEW_OFFER, 3,
+                                             participants, 1);
+
+    broadcast_command(&table, book_event, NULL);
+    send_commands_to_clients(&table);
+
+    for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+      struct evbuffer* output = bufferevent_get_output(seated[seat]->buf_ev);
+      evbuffer_drain(output, evbuffer_get_length(output));
+    }
+  }
+}
+
+static void
+setup(void)
+{
+  uint8_t counts[TOTAL_UNIQUE_CARDS];
+
+  srand(1);
+
+  for (size_t i = 0; i < NUM_HANDS; ++i) {
+    ref_random_hand(counts, &hands[i], CARD_MAX_AMOUNT);
+    ref_random_hand(counts, &offers[i], OFFER_MAX_CARDS/2);
+  }
+
+  trades = book_new();
+
+  card_location* unordered_deck = generate_deck(NUM_SEATS, true, true);
+  deck = flatten_card_location(unordered_deck);
+  free_card_location(unordered_deck);
+
+  rng_init(&shuffler, 1, 0);
+
+  hashed_clients = client_hash_table_new(0);
+
+  for (size_t i = 0; i < NUM_CLIENTS; ++i) {
+    clients[i].id = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    put_client(hashed_clients, &clients[i]);
+  }
+
+  /* Clients of the table write into sockets that are never read, as
+     nothing is sent until the event loop runs */
+  evbase = event_base_new();
+  TAILQ_INIT(&table);
+
+  for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+      perror("socketpair");
+      exit(1);
+    }
+
+    seated[seat] = client_new(evbase, fds[0], FRAMING_NEWLINE, NULL, NULL);
+    seated[seat]->id = (uint32_t) seat + 1;
+
+    TAILQ_INSERT_TAIL(&table, seated[seat], entries);
+  }
+}
+
+static void
+teardown(void)
+{
+  for (size_t seat = 0; seat < NUM_SEATS; ++seat) {
+    free_client(seated[seat]);
+  }
+
+  event_base_free(evbase);
+  free_client_hash_table(hashed_clients);
+  free_card_array(deck);
+  free_book(trades);
+  free_command_pool();
+}
+
+static const bench benches[] = {
+  {"validate_offer", 0, false, run_validate_offer},
+  {"subtract+merge_card_location", 0, false, run_subtract_merge},
+  {"has_won", 0, false, run_has_won},
+  {"evaluate_hand_score", 0, false, run_evaluate_hand_score},
+  {"fill_offer", 0, false, run_fill_offer},
+  {"cancel_offer", 0, false, run_cancel_offer},
+  {"shuffle+deal_cards_to_hands", 1 << 16, false, run_deal_cards_to_hands},
+  {"shuffle+deal_cards", 1 << 16, false, run_deal_cards},
+  {"get_client", 0, false, run_get_client},
+  {"del+put_client", 0, false, run_del_put_client},
+  {"parse_command_list_string", 1 << 17, false,
+   run_parse_command_list_string},
+  {"send_commands_to_clients", 1 << 16, true, run_send_commands}
+};
+
+#define NUM_BENCHES (sizeof(benches)/sizeof(bench))
+
+static int
+compare_results(const void* a, const void* b)
+{
+  double ns_a = ((const bench_result*) a)->ns;
+  double ns_b = ((const bench_result*) b)->ns;
+
+  return (ns_a > ns_b) - (ns_a < ns_b);
+}
+
+/* Run a benchmark once to warm up, then NUM_REPEATS times, returning
+   the measurement with the median time */
+static bench_result
+measure(const bench* bench_obj)
+{
+  size_t num_ops = (bench_obj->num_ops > 0) ? bench_obj->num_ops : NUM_OPS;
+  bench_result results[NUM_REPEATS];
+  int saved_stdout = -1;
+
+  if (bench_obj->noisy) {
+    int null_fd = open("/dev/null", O_WRONLY);
+
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+  }
+
+  bench_obj->run(num_ops/8);
+
+  for (size_t rep = 0; rep < NUM_REPEATS; ++rep) {
+    size_t start_allocs = count_allocs();
+    uint64_t start_cycles = read_cycles();
+    double start_ns = now_ns();
+
+    bench_obj->run(num_ops);
+
+    double end_ns = now_ns();
+    uint64_t end_cycles = read_cycles();
+    size_t end_allocs = count_allocs();
+
+    results[rep].ns = (end_ns - start_ns)/(double) num_ops;
+    results[rep].cycles = (double) (end_cycles - start_cycles)/(double) num_ops;
+    results[rep].allocs = (double) (end_allocs - start_allocs)/(double) num_ops;
+  }
+
+  if (bench_obj->noisy) {
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+  }
+
+  qsort(results, NUM_REPEATS, sizeof(bench_result), compare_results);
+
+  return results[NUM_REPEATS/2];
+}
+
+/* Results are printed as a table, or as CSV or JSON given as the only
+   argument */
+int
+main(int argc, char** argv)
+{
+  const char* format = (argc > 1) ? argv[1] : "text";
+
+  if (strcmp(format, "text") != 0 && strcmp(format, "csv") != 0 &&
+      strcmp(format, "json") != 0) {
+    fprintf(stderr, "usage: %s [text|csv|json]\n", argv[0]);
+    return 1;
+  }
+
+  open_cycle_counter();
+  setup();
+
+  if (strcmp(format, "csv") == 0) {
+    printf("name,ns_per_op,allocs_per_op,cycles_per_op,cycle_source\n");
+  }
+  else if (strcmp(format, "json") == 0) {
+    printf("{\"cycle_source\":\"%s\",\"results\":[", cycle_source);
+  }
+  else {
+    printf("%-30s %10s %10s %10s (%s)\n", "benchmark", "ns/op", "allocs/op",
+           "cycles/op", cycle_source);
+  }
+
+  for (size_t i = 0; i < NUM_BENCHES; ++i) {
+    bench_result result = measure(&benches[i]);
+
+    if (strcmp(format, "csv") == 0) {
+      printf("%s,%.3f,%.3f,%.1f,%s\n", benches[i].name, result.ns,
+             result.allocs, result.cycles, cycle_source);
+    }
+    else if (strcmp(format, "json") == 0) {
+      printf("%s{\"name\":\"%s\",\"ns_per_op\":%.3f,\"allocs_per_op\":%.3f,"
+             "\"cycles_per_op\":%.1f}", (i > 0) ? "," : "", benches[i].name,
+             result.ns, result.allocs, result.cycles);
+    }
+    else {
+      printf("%-30s %10.2f %10.3f %10.1f\n", benches[i].name, result.ns,
+             result.allocs, result.cycles);
+    }
+
+    fflush(stdout);
+  }
+
+  if (strcmp(format, "json") == 0) {
+    printf("]}\n");
+  }
+
+  teardown();
+
+  return 0;
+}
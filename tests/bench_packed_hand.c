@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "card_location.h"
+#include "command_error.h"
+#include "hand_reference.h"
+#include "packed_hand.h"
+
+/* Distinct hands cycled through, small enough to stay in cache */
+#define NUM_HANDS 4096
+
+/* Passes over the hands per measurement */
+#define NUM_PASSES 2000
+
+static uint8_t hand_counts[NUM_HANDS][TOTAL_UNIQUE_CARDS];
+static uint8_t offer_counts[NUM_HANDS][TOTAL_UNIQUE_CARDS];
+static card_location hands[NUM_HANDS];
+static card_location offers[NUM_HANDS];
+
+/* Results are accumulated here so no loop can be optimised away */
+static volatile long sink;
+
+static double
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec*1e9 + (double) ts.tv_nsec;
+}
+
+/* Time body over every hand, NUM_PASSES times, storing ns/op in ns */
+#define BENCH(ns, name, body)                                     \
+  do {                                                            \
+    long acc = 0;                                                 \
+    double start_ns = now_ns();                                   \
+    for (size_t pass = 0; pass < NUM_PASSES; ++pass) {            \
+      for (size_t i = 0; i < NUM_HANDS; ++i) {                    \
+        body;                                                     \
+      }                                                           \
+    }                                                             \
+    ns = (now_ns() - start_ns)/((double) NUM_HANDS*NUM_PASSES);   \
+    sink += acc;                                                  \
+    printf("%-28s %8.2f ns/op\n", name, ns);                      \
+  } while (0)
+
+static void
+report_speedup(double scalar_ns, double packed_ns)
+{
+  printf("%-28s %8.2fx\n", "  speedup", scalar_ns/packed_ns);
+}
+
+int
+main()
+{
+  srand(1);
+
+  for (size_t i = 0; i < NUM_HANDS; ++i) {
+    ref_random_hand(hand_counts[i], &hands[i], CARD_MAX_AMOUNT);
+    ref_random_hand(offer_counts[i], &offers[i], OFFER_MAX_CARDS/2);
+  }
+
+  double scalar_ns, packed_ns;
+
+  BENCH(scalar_ns, "validate_offer scalar",
+        acc += ref_validate_offer(offer_counts[i], hand_counts[i]));
+  BENCH(packed_ns, "validate_offer packed",
+        cmd_result res = CMD_RESULT_INIT;
+        validate_offer(&offers[i], &hands[i], &res);
+        acc += res.err);
+  report_speedup(scalar_ns, packed_ns);
+
+  BENCH(scalar_ns, "has_won scalar", acc += ref_has_won(hand_counts[i]));
+  BENCH(packed_ns, "has_won packed", acc += has_won(&hands[i]));
+  report_speedup(scalar_ns, packed_ns);
+
+  BENCH(scalar_ns, "evaluate_hand_score scalar",
+        acc += ref_evaluate_hand_score(hand_counts[i]));
+  BENCH(packed_ns, "evaluate_hand_score packed",
+        acc += evaluate_hand_score(&hands[i]));
+  report_speedup(scalar_ns, packed_ns);
+
+  /* Subtract then merge back, so the hands are the same every pass */
+  BENCH(scalar_ns, "subtract+merge scalar",
+        if (ref_subtract(hand_counts[i], offer_counts[i])) {
+          ref_merge(hand_counts[i], offer_counts[i]);
+          acc++;
+        });
+  BENCH(packed_ns, "subtract+merge packed",
+        cmd_result res = CMD_RESULT_INIT;
+        subtract_card_location(&hands[i], &offers[i], &res);
+        if (!cmd_failed(&res)) {
+          merge_card_location(&hands[i], &offers[i]);
+          acc++;
+        });
+  report_speedup(scalar_ns, packed_ns);
+
+  return 0;
+}
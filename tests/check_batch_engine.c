@@ -0,0 +1,406 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch_engine.h"
+
+/* Steps the whole game tests are allowed to take */
+#define MAX_BATCH_STEPS 1000000
+
+/* Choose an action for the seat whose turn it is in a game, the way the
+   collecting agent of check_engine does */
+static void
+collect_most(const batch_engine* batch, const batch_obs* obs, size_t game,
+             rng* rng_obj, engine_action* action)
+{
+  const card_location* hand = get_batch_hand(batch, game, obs->seats[game]);
+  card_id most = DIAMONDS;
+  card_id choices[TOTAL_COMMODITY_AMOUNT];
+  size_t num_choices = 0;
+
+  action->type = ENGINE_PASS;
+  clear_card_location(&action->cards);
+
+  if (obs->own_levels[game] != 0) {
+    if (rng_bounded(rng_obj, 4) == 0) {
+      action->type = ENGINE_CANCEL_OFFER;
+      action->card_amt = (size_t) __builtin_ctz(obs->own_levels[game]) +
+        OFFER_INDEX_OFFSET;
+    }
+
+    return;
+  }
+
+  for (card_id card = GOLD; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (get_card_amount(hand, card) > get_card_amount(hand, most)) {
+      most = card;
+    }
+  }
+
+  bool give_up_most = (rng_bounded(rng_obj, 8) == 0);
+
+  for (card_id card = DIAMONDS; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if ((card != most || give_up_most) &&
+        get_card_amount(hand, card) >= OFFER_MIN_CARDS) {
+      choices[num_choices++] = card;
+    }
+  }
+
+  if (num_choices == 0) {
+    return;
+  }
+
+  card_id card = choices[rng_bounded(rng_obj, (uint32_t) num_choices)];
+  size_t amt = get_card_amount(hand, card);
+
+  action->type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&action->cards, card, OFFER_MIN_CARDS +
+                        rng_bounded(rng_obj,
+                                    (uint32_t) (amt - OFFER_MIN_CARDS + 1)));
+}
+
+/* Fill every action of a batch with a pass */
+static void
+pass_all(engine_action actions[], size_t num_games)
+{
+  for (size_t game = 0; game < num_games; ++game) {
+    actions[game].type = ENGINE_PASS;
+    actions[game].card_amt = 0;
+    clear_card_location(&actions[game].cards);
+  }
+}
+
+/* Assert no card of a game has been lost or made up */
+static void
+assert_cards_kept(const batch_engine* batch, size_t game)
+{
+  const book* current_trades = &batch->books[game];
+  card_location all_cards;
+  size_t total_cards = 0;
+
+  clear_card_location(&all_cards);
+
+  for (size_t seat = 0; seat < batch->num_seats; ++seat) {
+    merge_card_location(&all_cards, get_batch_hand(batch, game, seat));
+  }
+
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
+    for (offer* offer_obj = current_trades->levels[i].head;
+         offer_obj != NULL; offer_obj = offer_obj->next) {
+      merge_card_location(&all_cards, &offer_obj->cards);
+    }
+  }
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    total_cards += get_card_amount(&all_cards, card);
+  }
+
+  ck_assert_uint_eq(total_cards, batch->deck->num_cards);
+}
+
+
+/* Core tests */
+
+START_TEST(test_batch_engine_new)
+{
+  batch_engine* batch = batch_engine_new(16, 4, true, true, 1);
+  bool games_differ = false;
+
+  for (size_t game = 0; game < 16; ++game) {
+    assert_cards_kept(batch, game);
+
+    /* Assert the first seat is shown its own hand */
+    ck_assert_uint_eq(batch->obs.seats[game], 0);
+    ck_assert_uint_eq(batch->obs.hands[game],
+                      get_batch_hand(batch, game, 0)->card_counts);
+    ck_assert_uint_eq(batch->obs.offer_levels[game], 0);
+    ck_assert_int_eq(batch->obs.errors[game], 0);
+    ck_assert(!batch->obs.dones[game]);
+
+    for (size_t seat = 0; seat < 4; ++seat) {
+      ck_assert_int_eq(get_batch_score(batch, game, seat), INITIAL_SCORE);
+    }
+
+    games_differ |= (get_batch_hand(batch, game, 0)->card_counts !=
+                     get_batch_hand(batch, 0, 0)->card_counts);
+  }
+
+  /* Assert every game is shuffled separately */
+  ck_assert(games_differ);
+
+  free_batch_engine(batch);
+}
+END_TEST
+
+START_TEST(test_batch_engine_trade)
+{
+  batch_engine* batch = batch_engine_new(3, 2, true, true, 1);
+  card_location* hands = batch->hands;
+  engine_action actions[3];
+
+  /* Game 1 is played by hand, seat 0 of game 2 offers what it lacks */
+  clear_card_location(&hands[2]);
+  clear_card_location(&hands[3]);
+  clear_card_location(&hands[4]);
+  add_cards_to_location(&hands[2], GOLD, 3);
+  add_cards_to_location(&hands[3], OIL, 3);
+
+  pass_all(actions, 3);
+
+  actions[1].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[1].cards, GOLD, 2);
+  actions[2].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[2].cards, GOLD, 2);
+
+  const batch_obs* obs = batch_engine_step(batch, actions);
+
+  /* Assert the next seat sees the offer and the failed offer is refused */
+  ck_assert_uint_eq(obs->seats[1], 1);
+  ck_assert_uint_eq(obs->offer_levels[1], 1 << (2 - OFFER_INDEX_OFFSET));
+  ck_assert_uint_eq(obs->own_levels[1], 0);
+  ck_assert_uint_eq(get_card_amount(&hands[2], GOLD), 1);
+
+  ck_assert_int_eq(obs->errors[1], 0);
+  ck_assert_int_eq(obs->errors[2], EHANDSUBSET);
+  ck_assert_uint_eq(obs->offer_levels[2], 0);
+
+  /* Assert a matching offer trades the cards */
+  pass_all(actions, 3);
+
+  actions[1].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[1].cards, OIL, 2);
+
+  obs = batch_engine_step(batch, actions);
+
+  ck_assert_uint_eq(get_card_amount(&hands[2], OIL), 2);
+  ck_assert_uint_eq(get_card_amount(&hands[3], GOLD), 2);
+  ck_assert_uint_eq(obs->offer_levels[1], 0);
+  ck_assert_uint_eq(obs->hands[1], hands[2].card_counts);
+
+  /* Assert only the owner can take an offer back */
+  pass_all(actions, 3);
+
+  actions[1].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[1].cards, OIL, 2);
+  batch_engine_step(batch, actions);
+
+  pass_all(actions, 3);
+
+  actions[1].type = ENGINE_CANCEL_OFFER;
+  actions[1].card_amt = 2;
+  obs = batch_engine_step(batch, actions);
+
+  ck_assert_int_eq(obs->errors[1], ECANPERM);
+  ck_assert_uint_eq(obs->own_levels[1], 1 << (2 - OFFER_INDEX_OFFSET));
+
+  obs = batch_engine_step(batch, actions);
+
+  ck_assert_int_eq(obs->errors[1], 0);
+  ck_assert_uint_eq(get_card_amount(&hands[2], OIL), 2);
+
+  free_batch_engine(batch);
+}
+END_TEST
+
+START_TEST(test_batch_engine_end_round)
+{
+  batch_engine* batch = batch_engine_new(2, 2, true, true, 1);
+  card_location* hands = batch->hands;
+  engine_action actions[2];
+
+  /* Seat 0 of game 0 is two diamonds short of a winning hand */
+  clear_card_location(&hands[0]);
+  clear_card_location(&hands[1]);
+  add_cards_to_location(&hands[0], DIAMONDS, TOTAL_COMMODITY_AMOUNT - 1);
+  add_cards_to_location(&hands[0], SPORT, 2);
+  add_cards_to_location(&hands[1], DIAMONDS, 2);
+
+  pass_all(actions, 2);
+
+  actions[0].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[0].cards, SPORT, 2);
+  batch_engine_step(batch, actions);
+
+  pass_all(actions, 2);
+
+  actions[0].type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&actions[0].cards, DIAMONDS, 2);
+
+  const batch_obs* obs = batch_engine_step(batch, actions);
+
+  /* Assert the round was scored and a new one dealt */
+  ck_assert_int_eq(obs->rewards[0], card_values[DIAMONDS]);
+  ck_assert_int_eq(get_batch_score(batch, 0, 0), card_values[DIAMONDS]);
+  ck_assert_int_eq(get_batch_score(batch, 0, 1), obs->rewards[1]);
+  ck_assert(!obs->dones[0]);
+
+  assert_cards_kept(batch, 0);
+
+  /* Both seats of the other game passed, so its round ended as well */
+  ck_assert_uint_eq(batch->num_rounds, 2);
+
+  free_batch_engine(batch);
+}
+END_TEST
+
+START_TEST(test_batch_engine_stalled_round)
+{
+  batch_engine* batch = batch_engine_new(4, 3, true, true, 1);
+  engine_action actions[4];
+  int hand_scores[4*3];
+
+  pass_all(actions, 4);
+
+  for (size_t i = 0; i < 4*3; ++i) {
+    hand_scores[i] = evaluate_hand_score(&batch->hands[i]);
+  }
+
+  /* Assert a round nobody plays in ends once every seat has passed */
+  for (size_t i = 0; i < 3; ++i) {
+    ck_assert_uint_eq(batch->num_rounds, 0);
+    batch_engine_step(batch, actions);
+  }
+
+  ck_assert_uint_eq(batch->num_rounds, 4);
+
+  for (size_t i = 0; i < 4*3; ++i) {
+    ck_assert_int_eq(batch->obs.rewards[i], hand_scores[i]);
+    ck_assert_int_eq(batch->scores[i], hand_scores[i]);
+  }
+
+  free_batch_engine(batch);
+}
+END_TEST
+
+
+/* Whole game tests */
+
+START_TEST(test_batch_engine_play)
+{
+  batch_engine* batch = batch_engine_new(64, 4, true, true, 5);
+  engine_action actions[64];
+  size_t num_dones = 0;
+  rng agent_rng;
+
+  rng_init(&agent_rng, 5, 1);
+
+  const batch_obs* obs = &batch->obs;
+
+  /* Assert every game can be played to the end, and started again */
+  for (size_t step = 0; step < MAX_BATCH_STEPS && num_dones < 128; ++step) {
+    for (size_t game = 0; game < 64; ++game) {
+      collect_most(batch, obs, game, &agent_rng, &actions[game]);
+    }
+
+    obs = batch_engine_step(batch, actions);
+
+    for (size_t game = 0; game < 64; ++game) {
+      /* Every action chosen is legal */
+      ck_assert_int_eq(obs->errors[game], 0);
+
+      if (obs->dones[game]) {
+        num_dones++;
+
+        /* Assert a game is started again once it has been won */
+        for (size_t seat = 0; seat < 4; ++seat) {
+          ck_assert_int_eq(get_batch_score(batch, game, seat),
+                           INITIAL_SCORE);
+        }
+      }
+    }
+
+    if (step % 997 == 0) {
+      for (size_t game = 0; game < 64; ++game) {
+        assert_cards_kept(batch, game);
+      }
+    }
+  }
+
+  ck_assert_uint_ge(num_dones, 128);
+  ck_assert_uint_eq(num_dones, batch->num_games_won);
+
+  free_batch_engine(batch);
+}
+END_TEST
+
+START_TEST(test_batch_engine_independent)
+{
+  batch_engine* single = batch_engine_new(1, 3, true, true, 9);
+  batch_engine* many = batch_engine_new(8, 3, true, true, 9);
+  engine_action actions[8];
+  rng agent_rngs[2];
+
+  rng_init(&agent_rngs[0], 9, 1);
+  rng_init(&agent_rngs[1], 9, 1);
+
+  pass_all(actions, 8);
+
+  /* Assert a game plays out the same whatever else is in its batch */
+  for (size_t step = 0; step < 5000; ++step) {
+    collect_most(single, &single->obs, 0, &agent_rngs[0], &actions[0]);
+    batch_engine_step(single, actions);
+
+    collect_most(many, &many->obs, 0, &agent_rngs[1], &actions[0]);
+    batch_engine_step(many, actions);
+
+    for (size_t seat = 0; seat < 3; ++seat) {
+      ck_assert_uint_eq(get_batch_hand(single, 0, seat)->card_counts,
+                        get_batch_hand(many, 0, seat)->card_counts);
+      ck_assert_int_eq(get_batch_score(single, 0, seat),
+                       get_batch_score(many, 0, seat));
+    }
+  }
+
+  ck_assert_uint_gt(single->num_rounds, 0);
+
+  free_batch_engine(single);
+  free_batch_engine(many);
+}
+END_TEST
+
+
+Suite*
+batch_engine_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_game;
+
+  s = suite_create("Batch Engine");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_batch_engine_new);
+  tcase_add_test(tc_core, test_batch_engine_trade);
+  tcase_add_test(tc_core, test_batch_engine_end_round);
+  tcase_add_test(tc_core, test_batch_engine_stalled_round);
+
+  tc_game = tcase_create("Game");
+
+  tcase_add_test(tc_game, test_batch_engine_play);
+  tcase_add_test(tc_game, test_batch_engine_independent);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_game);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = batch_engine_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 #include <check.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "book.h"
 #include "utils.h"
@@ -13,7 +14,7 @@ START_TEST(test_book_new)
 
   book_obj = book_new();
 
-  for (int i = 0; i < (TOTAL_COMMODITY_AMOUNT + 1) - OFFER_INDEX_OFFSET; ++i) {
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
     ck_assert(no_offer_at(book_obj, i));
   }
 
@@ -27,16 +28,19 @@ START_TEST(test_book_set_offer)
   book* book_obj;
   size_t card_amt = 3;
 
-  offer_obj = offer_init_cards(DIAMONDS, card_amt, "test_id");
-
   book_obj = book_new();
+
+  offer_obj = offer_init_cards(book_obj, DIAMONDS, card_amt, 0x7e57);
+
   int offer_ind = offset_index(card_amt);
 
   ck_assert(no_offer_at(book_obj, offer_ind));
 
-  set_offer_at(book_obj, offer_ind, offer_obj);
+  push_offer_at(book_obj, offer_ind, offer_obj);
 
   ck_assert(offer_at(book_obj, offer_ind));
+  ck_assert_uint_eq(get_num_offers_at(book_obj, offer_ind), 1);
+  ck_assert_ptr_eq(get_offer_at(book_obj, offer_ind), offer_obj);
 
   free_book(book_obj);
 }
@@ -51,22 +55,22 @@ START_TEST(test_book_fill_offer)
 
   book_obj = book_new();
 
-  first_offer = offer_init_cards(GOLD, 5, "aaaaaaa");
+  first_offer = offer_init_cards(book_obj, GOLD, 5, 0xaaaaaaaa);
 
   return_offer = fill_offer(book_obj, first_offer);
 
   ck_assert(return_offer == NULL);
 
-  second_offer = offer_init_cards(DIAMONDS, 5, "bbbbbbb");
+  second_offer = offer_init_cards(book_obj, DIAMONDS, 5, 0xbbbbbbbb);
 
   return_offer = fill_offer(book_obj, second_offer);
   ck_assert(no_offer_at(book_obj, 3));
 
   ck_assert(is_owner(return_offer, first_offer->owner_id));
 
+  free_offer(book_obj, first_offer);
+  free_offer(book_obj, second_offer);
   free_book(book_obj);
-  free_offer(first_offer);
-  free_offer(second_offer);
 }
 END_TEST
 
@@ -75,27 +79,215 @@ START_TEST(test_book_cancel_offer)
   offer* first_offer;
   offer* test_offer;
   book* book_obj;
+  cmd_result res = CMD_RESULT_INIT;
 
   size_t card_amt = 3;
   int offer_ind = offset_index(card_amt);
 
   book_obj = book_new();
 
-  first_offer = offer_init_cards(OIL, card_amt, "aaaaaaa");
+  first_offer = offer_init_cards(book_obj, OIL, card_amt, 0xaaaaaaaa);
 
   fill_offer(book_obj, first_offer);
 
-  test_offer = cancel_offer(book_obj, card_amt, "bbbbbbb");
+  test_offer = cancel_offer(book_obj, card_amt, 0xbbbbbbbb, &res);
   ck_assert(offer_at(book_obj, offer_ind));
   ck_assert(test_offer == NULL);
+  ck_assert_int_eq(res.err, ECANPERM);
 
-  test_offer = cancel_offer(book_obj, card_amt-1, "aaaaaaa");
+  res.err = CMD_SUCCESS;
+  test_offer = cancel_offer(book_obj, card_amt-1, 0xaaaaaaaa, &res);
   ck_assert(offer_at(book_obj, offer_ind));
   ck_assert(test_offer == NULL);
+  ck_assert_int_eq(res.err, ECANEMPTY);
 
-  test_offer = cancel_offer(book_obj, card_amt, "aaaaaaa");
+  /* Amounts that cannot be in the book are never cancelled */
+  res.err = CMD_SUCCESS;
+  test_offer = cancel_offer(book_obj, OFFER_MAX_CARDS + 1, 0xaaaaaaaa, &res);
+  ck_assert(test_offer == NULL);
+  ck_assert_int_eq(res.err, ECANEMPTY);
+
+  res.err = CMD_SUCCESS;
+  test_offer = cancel_offer(book_obj, card_amt, 0xaaaaaaaa, &res);
+  ck_assert(!cmd_failed(&res));
   ck_assert(no_offer_at(book_obj, offer_ind));
   ck_assert(is_owner(test_offer, first_offer->owner_id));
+
+  free_offer(book_obj, test_offer);
+  free_book(book_obj);
+}
+END_TEST
+
+START_TEST(test_book_queue_offers)
+{
+  offer* offers[3];
+  offer* other_offer;
+  book* book_obj;
+
+  size_t card_amt = 4;
+  int offer_ind = offset_index(card_amt);
+
+  book_obj = book_new();
+
+  /* Assert offers of the same size and owner queue up behind each other */
+  for (size_t i = 0; i < 3; ++i) {
+    offers[i] = offer_init_cards(book_obj, OIL, card_amt, 0xaaaaaaaa);
+
+    ck_assert_ptr_null(fill_offer(book_obj, offers[i]));
+    ck_assert_uint_eq(get_num_offers_at(book_obj, offer_ind), i + 1);
+  }
+
+  ck_assert_ptr_eq(get_offer_at(book_obj, offer_ind), offers[0]);
+
+  /* Assert another owner trades with the oldest offer first */
+  other_offer = offer_init_cards(book_obj, GOLD, card_amt, 0xbbbbbbbb);
+
+  ck_assert_ptr_eq(fill_offer(book_obj, other_offer), offers[0]);
+  ck_assert_uint_eq(get_num_offers_at(book_obj, offer_ind), 2);
+
+  free_offer(book_obj, other_offer);
+  free_offer(book_obj, offers[0]);
+
+  /* Assert cancelling also takes the oldest offer */
+  cmd_result res = CMD_RESULT_INIT;
+
+  ck_assert_ptr_eq(cancel_offer(book_obj, card_amt, 0xaaaaaaaa, &res),
+                   offers[1]);
+  ck_assert(!cmd_failed(&res));
+  ck_assert_ptr_eq(get_offer_at(book_obj, offer_ind), offers[2]);
+  ck_assert_uint_eq(get_num_offers_at(book_obj, offer_ind), 1);
+
+  free_book(book_obj);
+}
+END_TEST
+
+START_TEST(test_book_withdraw_offer)
+{
+  offer* offers[4];
+  book* book_obj;
+
+  size_t card_amt = 2;
+  int offer_ind = offset_index(card_amt);
+
+  book_obj = book_new();
+
+  for (size_t i = 0; i < 4; ++i) {
+    offers[i] = offer_init_cards(book_obj, PROPERTY, card_amt, 0xaaaaaaaa);
+    fill_offer(book_obj, offers[i]);
+  }
+
+  /* Assert offers can be withdrawn from the middle, head and tail */
+  withdraw_offer(book_obj, offers[2]);
+
+  ck_assert_uint_eq(get_num_offers_at(book_obj, offer_ind), 3);
+  ck_assert_ptr_eq(offers[1]->next, offers[3]);
+  ck_assert_ptr_eq(offers[3]->prev, offers[1]);
+
+  withdraw_offer(book_obj, offers[0]);
+
+  ck_assert_ptr_eq(get_offer_at(book_obj, offer_ind), offers[1]);
+  ck_assert_ptr_null(offers[1]->prev);
+
+  withdraw_offer(book_obj, offers[3]);
+
+  ck_assert_ptr_eq(book_obj->levels[offer_ind].tail, offers[1]);
+  ck_assert_ptr_null(offers[1]->next);
+
+  ck_assert_ptr_eq(remove_offer_at(book_obj, offer_ind), offers[1]);
+  ck_assert(no_offer_at(book_obj, offer_ind));
+  ck_assert_ptr_null(book_obj->levels[offer_ind].tail);
+  ck_assert_ptr_null(remove_offer_at(book_obj, offer_ind));
+
+  free_book(book_obj);
+}
+END_TEST
+
+START_TEST(test_book_cancel_owner_offers)
+{
+  book* book_obj;
+  card_location hand;
+
+  book_obj = book_new();
+  clear_card_location(&hand);
+
+  /* Two offers of one size and one of another from the first owner */
+  fill_offer(book_obj, offer_init_cards(book_obj, GOLD, 2, 0xaaaaaaaa));
+  fill_offer(book_obj, offer_init_cards(book_obj, GOLD, 2, 0xaaaaaaaa));
+  fill_offer(book_obj, offer_init_cards(book_obj, OIL, 5, 0xaaaaaaaa));
+
+  /* One offer of another size from the second owner */
+  offer* other_offer = offer_init_cards(book_obj, DIAMONDS, 3, 0xbbbbbbbb);
+  fill_offer(book_obj, other_offer);
+
+  ck_assert_uint_eq(book_obj->num_owners, 2);
+  ck_assert_uint_eq(get_owner_levels(book_obj, 0xaaaaaaaa),
+                    (UINT32_C(1) << offset_index(2)) |
+                    (UINT32_C(1) << offset_index(5)));
+
+  /* Assert only the first owner's offers are removed, cards and all */
+  ck_assert_uint_eq(cancel_owner_offers(book_obj, 0xaaaaaaaa, &hand), 3);
+
+  ck_assert_uint_eq(get_card_amount(&hand, GOLD), 4);
+  ck_assert_uint_eq(get_card_amount(&hand, OIL), 5);
+  ck_assert_uint_eq(get_total_cards(&hand), 9);
+
+  ck_assert(no_offer_at(book_obj, offset_index(2)));
+  ck_assert(no_offer_at(book_obj, offset_index(5)));
+  ck_assert_ptr_eq(get_offer_at(book_obj, offset_index(3)), other_offer);
+  ck_assert_uint_eq(book_obj->num_owners, 1);
+  ck_assert_uint_eq(get_owner_levels(book_obj, 0xaaaaaaaa), 0);
+  ck_assert_uint_eq(get_slab_stats(book_obj->offer_pool)->num_live, 1);
+
+  /* Assert an owner without offers has nothing to cancel */
+  ck_assert_uint_eq(cancel_owner_offers(book_obj, 0xaaaaaaaa, &hand), 0);
+
+  /* Assert the owner is forgotten once its last offer trades */
+  offer* taker = offer_init_cards(book_obj, OIL, 3, 0xaaaaaaaa);
+
+  ck_assert_ptr_eq(fill_offer(book_obj, taker), other_offer);
+  ck_assert_uint_eq(book_obj->num_owners, 0);
+  ck_assert_uint_eq(cancel_owner_offers(book_obj, 0xbbbbbbbb, NULL), 0);
+
+  free_book(book_obj);
+}
+END_TEST
+
+START_TEST(test_book_clear)
+{
+  book* book_obj;
+
+  book_obj = book_new();
+
+  for (size_t card_amt = OFFER_MIN_CARDS; card_amt <= OFFER_MAX_CARDS; ++card_amt) {
+    fill_offer(book_obj, offer_init_cards(book_obj, GOLD, card_amt, 0xaaaaaaaa));
+  }
+
+  /* An offer that was never put in the book */
+  offer_init_cards(book_obj, OIL, 2, 0xbbbbbbbb);
+
+  const slab_stats* stats = get_slab_stats(book_obj->offer_pool);
+  size_t num_chunks = stats->num_chunks;
+
+  ck_assert_uint_eq(stats->num_live, OFFER_MAX_CARDS - OFFER_MIN_CARDS + 2);
+
+  clear_book(book_obj);
+
+  /* Assert every offer was released at once */
+  ck_assert_uint_eq(stats->num_live, 0);
+  ck_assert_uint_eq(stats->num_resets, 1);
+
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
+    ck_assert(no_offer_at(book_obj, i));
+  }
+
+  /* Assert the released memory is reused */
+  for (size_t i = 0; i < OFFER_SLAB_CHUNK; ++i) {
+    offer_init_cards(book_obj, GOLD, 2, 0xaaaaaaaa);
+  }
+
+  ck_assert_uint_eq(stats->num_chunks, num_chunks);
+
+  free_book(book_obj);
 }
 END_TEST
 
@@ -103,37 +295,46 @@ END_TEST
 START_TEST(test_offer_init)
 {
   offer* offer_obj;
-  const char id[HASH_LENGTH] = "test_id";
+  const uint32_t id = 0x7e57;
   size_t card_amt = 4;
 
-  offer_obj = offer_init_cards(DIAMONDS, card_amt, id);
+  book* book_obj = book_new();
+
+  offer_obj = offer_init_cards(book_obj, DIAMONDS, card_amt, id);
 
   ck_assert(is_owner(offer_obj, id));
+  ck_assert(!is_owner(offer_obj, id ^ 0x80000000));
   ck_assert_int_eq(get_offer_index(offer_obj), 2);
 
-  free_offer(offer_obj);
+  free_offer(book_obj, offer_obj);
+  free_book(book_obj);
 }
 END_TEST
 
 START_TEST(test_offer_index)
 {
+  book* book_obj = book_new();
+
   for (size_t card_amt = 2; card_amt < TOTAL_COMMODITY_AMOUNT; ++card_amt) {
     offer* offer_obj;
 
-    offer_obj = offer_init_cards(DIAMONDS, card_amt, "test_id");
+    offer_obj = offer_init_cards(book_obj, DIAMONDS, card_amt, 0x7e57);
 
     ck_assert_int_eq(get_offer_index(offer_obj), (int) card_amt - 2);
 
-    free_offer(offer_obj);
+    free_offer(book_obj, offer_obj);
   }
+
+  free_book(book_obj);
 }
 END_TEST
 
 START_TEST(test_offer_json)
 {
   offer* offer_obj;
+  book* book_obj = book_new();
 
-  offer_obj = offer_init_cards(PROPERTY, 5, "test_id");
+  offer_obj = offer_init_cards(book_obj, PROPERTY, 5, 0x7e57);
 
   json_object* offer_json;
   offer_json = JSON_from_offer(offer_obj);
@@ -143,9 +344,10 @@ START_TEST(test_offer_json)
   offer_json_str = JSON_to_str(offer_json, &str_len);
 
   ck_assert_str_eq(offer_json_str,
-                   "{\"cards\":[{\"id\":3,\"amt\":5}]}");
+                   "{\"cards\":[{\"id\":3,\"amt\":5,\"val\":200}]}");
 
-  free_offer(offer_obj);
+  free_offer(book_obj, offer_obj);
+  free_book(book_obj);
   json_object_put(offer_json);
 }
 END_TEST
@@ -166,6 +368,10 @@ book_suite(void)
   tcase_add_test(tc_core, test_book_set_offer);
   tcase_add_test(tc_core, test_book_fill_offer);
   tcase_add_test(tc_core, test_book_cancel_offer);
+  tcase_add_test(tc_core, test_book_queue_offers);
+  tcase_add_test(tc_core, test_book_withdraw_offer);
+  tcase_add_test(tc_core, test_book_cancel_owner_offers);
+  tcase_add_test(tc_core, test_book_clear);
 
   tc_json = tcase_create("JSON");
 
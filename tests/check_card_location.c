@@ -1,8 +1,10 @@
 #include <check.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "card_location.h"
 #include "card_array.h"
+#include "command_error.h"
 #include "utils.h"
 
 
@@ -104,17 +106,21 @@ START_TEST(test_card_location_add_remove)
 
   ck_assert_uint_eq(get_card_amount(card_loc, DIAMONDS), 6);
 
-  remove_cards_from_location(card_loc, DIAMONDS, 3);
+  cmd_result res = CMD_RESULT_INIT;
+
+  remove_cards_from_location(card_loc, DIAMONDS, 3, &res);
 
   ck_assert_uint_eq(get_card_amount(card_loc, DIAMONDS), 3);
 
-  remove_cards_from_location(card_loc, OIL, 3);
+  remove_cards_from_location(card_loc, OIL, 3, &res);
 
   ck_assert_uint_eq(get_card_amount(card_loc, OIL), 0);
+  ck_assert(!cmd_failed(&res));
 
-  remove_cards_from_location(card_loc, OIL, 9);
+  remove_cards_from_location(card_loc, OIL, 9, &res);
 
   ck_assert_uint_eq(get_card_amount(card_loc, OIL), 0);
+  ck_assert_int_eq(res.err, ECARDRM);
 
   ck_assert(has_enough_cards(card_loc, OIL, 5) == false);
 
@@ -122,6 +128,51 @@ START_TEST(test_card_location_add_remove)
 }
 END_TEST
 
+START_TEST(test_card_location_value)
+{
+  card_location hand;
+  card_location copy;
+
+  clear_card_location(&hand);
+
+  /* Assert a cleared card_location on the stack is empty */
+  ck_assert_uint_eq(get_total_cards(&hand), 0);
+
+  add_cards_to_location(&hand, GOLD, 4);
+  add_card_to_location(&hand, TAX_COLLECTOR);
+
+  copy = hand;
+  add_card_to_location(&copy, GOLD);
+
+  /* Assert copies made by assignment are independent */
+  ck_assert_uint_eq(get_card_amount(&hand, GOLD), 4);
+  ck_assert_uint_eq(get_card_amount(&copy, GOLD), 5);
+  ck_assert_uint_eq(get_total_cards(&hand), 5);
+  ck_assert_uint_eq(get_total_cards(&copy), 6);
+}
+END_TEST
+
+START_TEST(test_card_location_validate_large)
+{
+  card_location* hand = card_location_init(TOTAL_COMMODITY_AMOUNT + 1,
+                                           DIAMONDS, DIAMONDS, DIAMONDS,
+                                           DIAMONDS, DIAMONDS, DIAMONDS,
+                                           DIAMONDS, DIAMONDS, DIAMONDS);
+  card_location* offer = card_location_new();
+  cmd_result res = CMD_RESULT_INIT;
+
+  merge_card_location(offer, hand);
+
+  validate_offer(offer, hand, &res);
+
+  /* Assert an offer too large for the book is rejected */
+  ck_assert_int_eq(res.err, ELARGEOFFER);
+
+  free_card_location(offer);
+  free_card_location(hand);
+}
+END_TEST
+
 START_TEST(test_card_location_generate_deck)
 {
   size_t num_players = (size_t) _i;
@@ -163,8 +214,43 @@ START_TEST(test_card_location_json)
   card_loc_json_str = JSON_to_str(card_loc_json, &str_len);
 
   ck_assert_str_eq(card_loc_json_str,
-                   "[{\"id\":0,\"amt\":1},{\"id\":1,\"amt\":2},\
-{\"id\":2,\"amt\":2},{\"id\":8,\"amt\":1}]");
+                   "[{\"id\":0,\"amt\":1,\"val\":700},\
+{\"id\":1,\"amt\":2,\"val\":500},{\"id\":2,\"amt\":2,\"val\":800},\
+{\"id\":8,\"amt\":1,\"val\":0}]");
+
+  free_card_location(card_loc);
+  json_object_put(card_loc_json);
+}
+END_TEST
+
+START_TEST(test_card_location_encode)
+{
+  card_location* card_loc;
+  json_object* card_loc_json;
+
+  char encoded[CARD_LOCATION_JSON_MAX_LEN];
+  size_t encoded_len;
+
+  card_loc = card_location_init(7,
+                                TAX_COLLECTOR,
+                                SPORT,
+                                SPORT,
+                                MINING,
+                                GOLD,
+                                GOLD,
+                                BILLIONAIRE);
+
+  card_loc_json = JSON_from_card_location(card_loc);
+  encoded_len = encode_card_location(encoded, card_loc);
+
+  const char* card_loc_json_str;
+  size_t str_len;
+
+  card_loc_json_str = JSON_to_str(card_loc_json, &str_len);
+
+  /* Assert the direct encoding matches the encoding from json-c */
+  ck_assert_uint_eq(encoded_len, str_len);
+  ck_assert(memcmp(encoded, card_loc_json_str, str_len) == 0);
 
   free_card_location(card_loc);
   json_object_put(card_loc_json);
@@ -189,7 +275,11 @@ START_TEST(test_card_location_json_roundtrip)
 
   card_loc_json = JSON_from_card_location(card_loc);
 
-  card_loc_after = card_location_from_JSON(card_loc_json);
+  cmd_result res = CMD_RESULT_INIT;
+
+  card_loc_after = card_location_from_JSON(card_loc_json, &res);
+
+  ck_assert(!cmd_failed(&res));
 
   ck_assert_uint_eq(get_total_cards(card_loc),
                     get_total_cards(card_loc_after));
@@ -206,6 +296,34 @@ START_TEST(test_card_location_json_roundtrip)
 END_TEST
 
 
+START_TEST(test_card_location_json_bad_cards)
+{
+  const char* bad_cards[] = {
+    "[{\"id\":-1,\"amt\":2}]",
+    "[{\"id\":10,\"amt\":2}]",
+    "[{\"id\":0,\"amt\":-2}]",
+    "[{\"id\":0,\"amt\":10}]",
+    "[{\"id\":0,\"amt\":5},{\"id\":0,\"amt\":5}]"
+  };
+
+  const char* json_str = bad_cards[_i];
+  cmd_result res = CMD_RESULT_INIT;
+  card_location card_loc;
+
+  json_object* card_loc_json = str_to_JSON(json_str, strlen(json_str), &res);
+
+  ck_assert(!cmd_failed(&res));
+
+  read_card_location_JSON(&card_loc, card_loc_json, &res);
+
+  /* Assert cards that cannot exist are rejected */
+  ck_assert_int_eq(res.err, EBADCARD);
+
+  json_object_put(card_loc_json);
+}
+END_TEST
+
+
 /* Card array tests */
 
 START_TEST(test_card_location_flatten)
@@ -297,6 +415,61 @@ START_TEST(test_card_location_dealing)
 }
 END_TEST
 
+START_TEST(test_card_location_redealing)
+{
+  const size_t num_players = 4;
+
+  card_location* deck;
+  card_array* ordered_deck;
+  card_location hands[4];
+  card_location* player_hands[4];
+
+  deck = generate_deck(num_players, true, true);
+  ordered_deck = flatten_card_location(deck);
+
+  for (size_t i = 0; i < num_players; ++i) {
+    /* Leave cards from an earlier round in every hand */
+    clear_card_location(&hands[i]);
+    add_cards_to_location(&hands[i], GOLD, i + 1);
+    player_hands[i] = &hands[i];
+  }
+
+  rng shuffler;
+  rng_init(&shuffler, 7, 0);
+
+  for (size_t round = 0; round < 3; ++round) {
+    shuffle_card_array(ordered_deck, &shuffler);
+    deal_cards_to_hands(num_players, ordered_deck, player_hands);
+
+    card_location dealt;
+    clear_card_location(&dealt);
+
+    for (size_t i = 0; i < num_players; ++i) {
+      /* Assert each hand holds exactly its share of the deck */
+      card_location expected;
+      clear_card_location(&expected);
+
+      for (size_t j = i; j < ordered_deck->num_cards; j += num_players) {
+        add_card_to_location(&expected, ordered_deck->cards[j]);
+      }
+
+      ck_assert_uint_eq(hands[i].card_counts, expected.card_counts);
+      ck_assert_uint_eq(get_total_cards(&hands[i]),
+                        get_total_cards(&expected));
+
+      merge_card_location(&dealt, &hands[i]);
+    }
+
+    /* Assert reshuffling in place neither loses nor adds cards */
+    ck_assert_uint_eq(dealt.card_counts, deck->card_counts);
+    ck_assert_uint_eq(get_total_cards(&dealt), get_total_cards(deck));
+  }
+
+  free_card_location(deck);
+  free_card_array(ordered_deck);
+}
+END_TEST
+
 
 Suite*
 card_location_suite(void)
@@ -314,17 +487,22 @@ card_location_suite(void)
   tcase_add_test(tc_core, test_card_location_add_unique);
   tcase_add_test(tc_core, test_card_location_clear);
   tcase_add_test(tc_core, test_card_location_add_remove);
+  tcase_add_test(tc_core, test_card_location_value);
+  tcase_add_test(tc_core, test_card_location_validate_large);
   tcase_add_loop_test(tc_core, test_card_location_generate_deck, 1, 8);
 
   tc_json = tcase_create("JSON");
 
   tcase_add_test(tc_json, test_card_location_json);
+  tcase_add_test(tc_json, test_card_location_encode);
   tcase_add_test(tc_json, test_card_location_json_roundtrip);
+  tcase_add_loop_test(tc_json, test_card_location_json_bad_cards, 0, 5);
 
   tc_array = tcase_create("Card Arrays");
 
   tcase_add_test(tc_array, test_card_location_flatten);
   tcase_add_test(tc_array, test_card_location_dealing);
+  tcase_add_test(tc_array, test_card_location_redealing);
   // tcase_add_test(tc_array, );
   // tcase_add_test(tc_array, );
   // tcase_add_test(tc_array, );
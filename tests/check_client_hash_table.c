@@ -0,0 +1,284 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "client.h"
+#include "client_hash_table.h"
+
+/* Clients inserted and removed by the random tests */
+#define NUM_RANDOM_CLIENTS 2000
+
+static client clients[NUM_RANDOM_CLIENTS];
+
+/* Return a random 32-bit key */
+static uint32_t
+random_key()
+{
+  return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+/* Assert every client in the table holds the slot of its own key */
+static void
+assert_slots_valid(const client_slot* slots, size_t capacity)
+{
+  for (size_t i = 0; i < capacity; ++i) {
+    if (slots[i].dist == 0) {
+      continue;
+    }
+
+    size_t home = slots[i].key & (capacity - 1);
+
+    ck_assert_uint_eq((home + slots[i].dist - 1) & (capacity - 1), i);
+    ck_assert_uint_eq(slots[i].client_obj->id, slots[i].key);
+  }
+}
+
+
+/* Core tests */
+
+START_TEST(test_client_hash_table_new)
+{
+  client_hash_table* table_obj = client_hash_table_new(16);
+
+  /* Assert there is room for 16 clients without growing */
+  ck_assert_uint_ge(table_obj->capacity*CLIENT_TABLE_LOAD_NUM,
+                    16*CLIENT_TABLE_LOAD_DEN);
+  ck_assert_uint_eq(table_obj->capacity & (table_obj->capacity - 1), 0);
+  ck_assert_uint_eq(table_obj->num_clients, 0);
+
+  ck_assert_ptr_null(get_client(table_obj, 0x1234abcd));
+
+  free_client_hash_table(table_obj);
+
+  table_obj = client_hash_table_new(0);
+
+  ck_assert_uint_eq(table_obj->capacity, CLIENT_TABLE_MIN_CAPACITY);
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+START_TEST(test_client_hash_table_put)
+{
+  client_hash_table* table_obj = client_hash_table_new(4);
+  client first_client = {.id = 0x0badf00d};
+  client second_client = {.id = 0xdeadbeef};
+  client same_key = {.id = 0x0badf00d};
+
+  ck_assert(put_client(table_obj, &first_client));
+  ck_assert(put_client(table_obj, &second_client));
+
+  ck_assert_ptr_eq(get_client(table_obj, 0x0badf00d), &first_client);
+  ck_assert_ptr_eq(get_client(table_obj, 0xdeadbeef), &second_client);
+
+  /* Assert a duplicate key is refused rather than ignored */
+  ck_assert(!put_client(table_obj, &same_key));
+  ck_assert(!put_client(table_obj, &first_client));
+
+  ck_assert_ptr_eq(get_client(table_obj, 0x0badf00d), &first_client);
+  ck_assert_uint_eq(table_obj->num_clients, 2);
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+START_TEST(test_client_hash_table_del)
+{
+  client_hash_table* table_obj = client_hash_table_new(4);
+  client first_client = {.id = 0x0badf00d};
+  client same_key = {.id = 0x0badf00d};
+
+  put_client(table_obj, &first_client);
+
+  /* Assert only the very client in the table is removed */
+  del_client(table_obj, &same_key);
+
+  ck_assert_ptr_eq(get_client(table_obj, 0x0badf00d), &first_client);
+
+  del_client(table_obj, &first_client);
+
+  ck_assert_ptr_null(get_client(table_obj, 0x0badf00d));
+  ck_assert_uint_eq(table_obj->num_clients, 0);
+
+  /* Assert removing a missing client does nothing */
+  del_client(table_obj, &first_client);
+
+  ck_assert_uint_eq(table_obj->num_clients, 0);
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+START_TEST(test_client_hash_table_collisions)
+{
+  client_hash_table* table_obj = client_hash_table_new(4);
+  size_t capacity = table_obj->capacity;
+  client colliding[5];
+
+  /* Every client has the same home slot, the last one of the array, so
+     the probe sequence wraps around to the start */
+  for (size_t i = 0; i < 5; ++i) {
+    colliding[i].id = (uint32_t) ((i + 1)*capacity + capacity - 1);
+    ck_assert(put_client(table_obj, &colliding[i]));
+  }
+
+  ck_assert_uint_eq(table_obj->capacity, capacity);
+  assert_slots_valid(table_obj->slots, capacity);
+
+  /* Assert removing from the middle of a run keeps the rest reachable */
+  del_client(table_obj, &colliding[1]);
+
+  assert_slots_valid(table_obj->slots, capacity);
+  ck_assert_ptr_null(get_client(table_obj, colliding[1].id));
+
+  for (size_t i = 0; i < 5; ++i) {
+    if (i != 1) {
+      ck_assert_ptr_eq(get_client(table_obj, colliding[i].id),
+                       &colliding[i]);
+    }
+  }
+
+  /* Assert no tombstone is left behind */
+  size_t num_used = 0;
+
+  for (size_t i = 0; i < capacity; ++i) {
+    num_used += (table_obj->slots[i].dist != 0);
+  }
+
+  ck_assert_uint_eq(num_used, 4);
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+
+/* Resizing tests */
+
+START_TEST(test_client_hash_table_grow)
+{
+  client_hash_table* table_obj = client_hash_table_new(0);
+  bool saw_migration = false;
+
+  srand(3);
+
+  for (size_t i = 0; i < NUM_RANDOM_CLIENTS; ++i) {
+    clients[i].id = random_key();
+
+    ck_assert(put_client(table_obj, &clients[i]));
+
+    saw_migration |= (table_obj->old_slots != NULL);
+
+    /* Assert the load stays bounded as the table grows */
+    ck_assert_uint_le(table_obj->num_clients*CLIENT_TABLE_LOAD_DEN,
+                      table_obj->capacity*CLIENT_TABLE_LOAD_NUM);
+
+    /* Assert every client is found, wherever it currently lives */
+    if (i % 97 == 0) {
+      for (size_t j = 0; j <= i; ++j) {
+        ck_assert_ptr_eq(get_client(table_obj, clients[j].id), &clients[j]);
+      }
+    }
+  }
+
+  ck_assert(saw_migration);
+  ck_assert_uint_eq(table_obj->num_clients, NUM_RANDOM_CLIENTS);
+
+  assert_slots_valid(table_obj->slots, table_obj->capacity);
+
+  if (table_obj->old_slots != NULL) {
+    assert_slots_valid(table_obj->old_slots, table_obj->old_capacity);
+  }
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+START_TEST(test_client_hash_table_churn)
+{
+  client_hash_table* table_obj = client_hash_table_new(0);
+  bool in_table[NUM_RANDOM_CLIENTS] = {false};
+
+  srand(11);
+
+  for (size_t i = 0; i < NUM_RANDOM_CLIENTS; ++i) {
+    clients[i].id = random_key();
+  }
+
+  /* Insert and remove at random, including while the table is part way
+     through moving into a larger array */
+  for (size_t step = 0; step < 20*NUM_RANDOM_CLIENTS; ++step) {
+    size_t i = (size_t) rand() % NUM_RANDOM_CLIENTS;
+
+    if (in_table[i]) {
+      del_client(table_obj, &clients[i]);
+    }
+    else {
+      ck_assert(put_client(table_obj, &clients[i]));
+    }
+
+    in_table[i] = !in_table[i];
+
+    if (step % 1009 == 0) {
+      size_t num_clients = 0;
+
+      for (size_t j = 0; j < NUM_RANDOM_CLIENTS; ++j) {
+        ck_assert_ptr_eq(get_client(table_obj, clients[j].id),
+                         in_table[j] ? &clients[j] : NULL);
+        num_clients += in_table[j];
+      }
+
+      ck_assert_uint_eq(table_obj->num_clients, num_clients);
+    }
+  }
+
+  assert_slots_valid(table_obj->slots, table_obj->capacity);
+
+  free_client_hash_table(table_obj);
+}
+END_TEST
+
+
+Suite*
+client_hash_table_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_resize;
+
+  s = suite_create("Client Hash Table");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_client_hash_table_new);
+  tcase_add_test(tc_core, test_client_hash_table_put);
+  tcase_add_test(tc_core, test_client_hash_table_del);
+  tcase_add_test(tc_core, test_client_hash_table_collisions);
+
+  tc_resize = tcase_create("Resize");
+
+  tcase_add_test(tc_resize, test_client_hash_table_grow);
+  tcase_add_test(tc_resize, test_client_hash_table_churn);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_resize);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = client_hash_table_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
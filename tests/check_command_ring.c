@@ -0,0 +1,175 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "command.h"
+#include "command_ring.h"
+
+
+/* Core tests */
+
+START_TEST(test_command_ring_init)
+{
+  command_ring ring;
+
+  command_ring_init(&ring);
+
+  ck_assert(command_ring_is_empty(&ring));
+  ck_assert_uint_eq(ring.capacity, COMMAND_RING_INIT_CAPACITY);
+  ck_assert_ptr_null(command_ring_pop(&ring));
+
+  free_command_ring(&ring);
+}
+END_TEST
+
+START_TEST(test_command_ring_order)
+{
+  command_ring ring;
+  command* cmds[COMMAND_RING_INIT_CAPACITY];
+
+  command_ring_init(&ring);
+
+  for (size_t i = 0; i < COMMAND_RING_INIT_CAPACITY; ++i) {
+    cmds[i] = command_end_game();
+  }
+
+  /* Push and pop unevenly so the commands wrap around the array */
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < COMMAND_RING_INIT_CAPACITY; ++i) {
+      ck_assert(command_ring_push(&ring, ref_command(cmds[i])));
+
+      if (i % 3 == 2) {
+        free_command(command_ring_pop(&ring));
+      }
+    }
+
+    while (!command_ring_is_empty(&ring)) {
+      free_command(command_ring_pop(&ring));
+    }
+  }
+
+  /* Assert commands come out in the order they went in */
+  for (size_t i = 0; i < COMMAND_RING_INIT_CAPACITY; ++i) {
+    ck_assert(command_ring_push(&ring, ref_command(cmds[i])));
+    ck_assert_ptr_eq(get_command_ring_at(&ring, i), cmds[i]);
+  }
+
+  for (size_t i = 0; i < COMMAND_RING_INIT_CAPACITY; ++i) {
+    command* cmd = command_ring_pop(&ring);
+
+    ck_assert_ptr_eq(cmd, cmds[i]);
+    free_command(cmd);
+  }
+
+  /* Assert the ring never had to grow */
+  ck_assert_uint_eq(ring.capacity, COMMAND_RING_INIT_CAPACITY);
+
+  for (size_t i = 0; i < COMMAND_RING_INIT_CAPACITY; ++i) {
+    ck_assert_int_eq(cmds[i]->refcnt, 1);
+    free_command(cmds[i]);
+  }
+
+  free_command_ring(&ring);
+}
+END_TEST
+
+START_TEST(test_command_ring_grow)
+{
+  command_ring ring;
+  command* cmd = command_end_game();
+  command* first_cmd = command_end_game();
+
+  command_ring_init(&ring);
+
+  /* Start part way through the array so growing has to unwrap it */
+  command_ring_push(&ring, ref_command(cmd));
+  free_command(command_ring_pop(&ring));
+
+  command_ring_push(&ring, ref_command(first_cmd));
+
+  for (size_t i = 1; i < 5*COMMAND_RING_INIT_CAPACITY; ++i) {
+    ck_assert(command_ring_push(&ring, ref_command(cmd)));
+  }
+
+  ck_assert_uint_eq(ring.length, 5*COMMAND_RING_INIT_CAPACITY);
+  ck_assert_uint_eq(ring.capacity, 8*COMMAND_RING_INIT_CAPACITY);
+  ck_assert_ptr_eq(get_command_ring_at(&ring, 0), first_cmd);
+
+  /* Assert clearing releases every command but keeps the array */
+  clear_command_ring(&ring);
+
+  ck_assert(command_ring_is_empty(&ring));
+  ck_assert_uint_eq(ring.capacity, 8*COMMAND_RING_INIT_CAPACITY);
+  ck_assert_int_eq(cmd->refcnt, 1);
+  ck_assert_int_eq(first_cmd->refcnt, 1);
+
+  free_command(cmd);
+  free_command(first_cmd);
+  free_command_ring(&ring);
+}
+END_TEST
+
+START_TEST(test_command_ring_overflow)
+{
+  command_ring ring;
+  command* cmd = command_end_game();
+
+  command_ring_init(&ring);
+
+  for (size_t i = 0; i < COMMAND_RING_MAX_CAPACITY; ++i) {
+    ck_assert(command_ring_push(&ring, ref_command(cmd)));
+  }
+
+  /* Assert a full ring refuses and releases the command */
+  ck_assert(!command_ring_push(&ring, ref_command(cmd)));
+
+  ck_assert_uint_eq(ring.length, COMMAND_RING_MAX_CAPACITY);
+  ck_assert_uint_eq(ring.capacity, COMMAND_RING_MAX_CAPACITY);
+  ck_assert_int_eq(cmd->refcnt, COMMAND_RING_MAX_CAPACITY + 1);
+
+  /* Assert freeing the ring releases what it still holds */
+  free_command_ring(&ring);
+
+  ck_assert_int_eq(cmd->refcnt, 1);
+
+  free_command(cmd);
+}
+END_TEST
+
+
+Suite*
+command_ring_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+
+  s = suite_create("Command Ring");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_command_ring_init);
+  tcase_add_test(tc_core, test_command_ring_order);
+  tcase_add_test(tc_core, test_command_ring_grow);
+  tcase_add_test(tc_core, test_command_ring_overflow);
+
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = command_ring_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,485 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+
+/* Turns a whole game is allowed to take */
+#define MAX_GAME_TURNS 1000000
+
+/* Events of each type seen by a seat, and the last one of each */
+typedef struct event_log event_log;
+
+struct event_log {
+  size_t counts[ENGINE_ERROR + 1];
+  engine_event last[ENGINE_ERROR + 1];
+};
+
+static event_log logs[ENGINE_MAX_SEATS];
+
+static void
+log_event(const engine* engine_obj, size_t seat, const engine_event* event,
+          void* data)
+{
+  (void) engine_obj;
+  (void) data;
+
+  logs[seat].counts[event->type]++;
+  logs[seat].last[event->type] = *event;
+}
+
+/* Offer a random amount of a random commodity, mostly other than the
+   one held most, with at most one offer on the book at a time. */
+static void
+collect_most(const engine* engine_obj, size_t seat, engine_action* action,
+             void* data)
+{
+  const card_location* hand = get_engine_hand(engine_obj, seat);
+  const book* current_trades = engine_obj->current_trades;
+  rng* rng_obj = data;
+  card_id most = DIAMONDS;
+  card_id choices[TOTAL_COMMODITY_AMOUNT];
+  size_t num_choices = 0;
+
+  /* Now and then take back the offer on the book, so the same seats do
+     not keep trading the same cards back and forth */
+  for (size_t i = 0; i < current_trades->num_owners; ++i) {
+    if (current_trades->owners[i].owner_id == seat) {
+      if (rng_bounded(rng_obj, 4) == 0) {
+        action->type = ENGINE_CANCEL_OFFER;
+        action->card_amt = (size_t) __builtin_ctz(
+          current_trades->owners[i].levels) + OFFER_INDEX_OFFSET;
+      }
+
+      return;
+    }
+  }
+
+  for (card_id card = GOLD; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if (get_card_amount(hand, card) > get_card_amount(hand, most)) {
+      most = card;
+    }
+  }
+
+  /* The commodity held most is only rarely given up, which is enough to
+     break up hands whose other cards are all singles */
+  bool give_up_most = (rng_bounded(rng_obj, 8) == 0);
+
+  for (card_id card = DIAMONDS; card < TOTAL_COMMODITY_AMOUNT; ++card) {
+    if ((card != most || give_up_most) &&
+        get_card_amount(hand, card) >= OFFER_MIN_CARDS) {
+      choices[num_choices++] = card;
+    }
+  }
+
+  if (num_choices == 0) {
+    return;
+  }
+
+  card_id card = choices[rng_bounded(rng_obj, (uint32_t) num_choices)];
+  size_t amt = get_card_amount(hand, card);
+
+  action->type = ENGINE_NEW_OFFER;
+  add_cards_to_location(&action->cards, card, OFFER_MIN_CARDS +
+                        rng_bounded(rng_obj,
+                                    (uint32_t) (amt - OFFER_MIN_CARDS + 1)));
+}
+
+static engine*
+logged_engine_new(size_t num_seats)
+{
+  engine* engine_obj = engine_new(num_seats, true, true, 1, 0);
+  engine_agent agent = {NULL, log_event, NULL};
+
+  memset(logs, 0, sizeof(logs));
+
+  for (size_t seat = 0; seat < num_seats; ++seat) {
+    set_engine_agent(engine_obj, seat, &agent);
+  }
+
+  return engine_obj;
+}
+
+/* Assert no card has been lost or made up */
+static void
+assert_cards_kept(const engine* engine_obj)
+{
+  card_location all_cards;
+  size_t total_cards = 0;
+
+  clear_card_location(&all_cards);
+
+  for (size_t seat = 0; seat < engine_obj->num_seats; ++seat) {
+    merge_card_location(&all_cards, get_engine_hand(engine_obj, seat));
+  }
+
+  for (int i = 0; i < BOOK_NUM_LEVELS; ++i) {
+    for (offer* offer_obj = engine_obj->current_trades->levels[i].head;
+         offer_obj != NULL; offer_obj = offer_obj->next) {
+      merge_card_location(&all_cards, &offer_obj->cards);
+    }
+  }
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    total_cards += get_card_amount(&all_cards, card);
+  }
+
+  ck_assert_uint_eq(total_cards, engine_obj->deck->num_cards);
+}
+
+
+/* Core tests */
+
+START_TEST(test_engine_start)
+{
+  engine* engine_obj = logged_engine_new(4);
+
+  engine_start_game(engine_obj);
+
+  ck_assert(engine_obj->running);
+
+  for (size_t seat = 0; seat < 4; ++seat) {
+    /* Assert each seat is told the hand it was dealt */
+    ck_assert_uint_eq(logs[seat].counts[ENGINE_START], 1);
+    ck_assert_uint_eq(logs[seat].last[ENGINE_START].cards.card_counts,
+                      get_engine_hand(engine_obj, seat)->card_counts);
+    ck_assert_int_eq(logs[seat].last[ENGINE_START].score, INITIAL_SCORE);
+  }
+
+  assert_cards_kept(engine_obj);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_trade)
+{
+  engine* engine_obj = logged_engine_new(3);
+  engine_action action = {.type = ENGINE_NEW_OFFER};
+
+  engine_start_game(engine_obj);
+
+  clear_card_location(&engine_obj->hands[0]);
+  clear_card_location(&engine_obj->hands[1]);
+  add_cards_to_location(&engine_obj->hands[0], GOLD, 3);
+  add_cards_to_location(&engine_obj->hands[1], OIL, 3);
+
+  /* Assert a new offer leaves the hand and is announced to the others */
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, GOLD, 2);
+
+  ck_assert(engine_submit(engine_obj, 0, &action));
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[0], GOLD), 1);
+  ck_assert_uint_eq(logs[0].counts[ENGINE_BOOK_EVENT], 0);
+  ck_assert_uint_eq(logs[1].counts[ENGINE_BOOK_EVENT], 1);
+  ck_assert_int_eq(logs[2].last[ENGINE_BOOK_EVENT].book_event,
+                   ENGINE_BOOK_NEW_OFFER);
+
+  /* Assert a matching offer trades the cards */
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, OIL, 2);
+
+  ck_assert(engine_submit(engine_obj, 1, &action));
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[0], OIL), 2);
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[1], GOLD), 2);
+  ck_assert_uint_eq(engine_obj->num_trades, 1);
+
+  ck_assert_uint_eq(logs[0].counts[ENGINE_SUCCESSFUL_TRADE], 1);
+  ck_assert_uint_eq(logs[0].last[ENGINE_SUCCESSFUL_TRADE].seat, 1);
+  ck_assert_uint_eq(logs[1].last[ENGINE_SUCCESSFUL_TRADE].seat, 0);
+  ck_assert_int_eq(logs[2].last[ENGINE_BOOK_EVENT].book_event,
+                   ENGINE_BOOK_SUCCESSFUL_TRADE);
+  ck_assert_uint_eq(logs[2].last[ENGINE_BOOK_EVENT].num_participants, 2);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_errors)
+{
+  engine* engine_obj = logged_engine_new(2);
+  engine_action action = {.type = ENGINE_NEW_OFFER};
+
+  engine_start_game(engine_obj);
+
+  clear_card_location(&engine_obj->hands[0]);
+  add_cards_to_location(&engine_obj->hands[0], GOLD, 2);
+
+  /* Assert cards that are not in the hand cannot be offered */
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, GOLD, 3);
+
+  ck_assert(!engine_submit(engine_obj, 0, &action));
+  ck_assert_int_eq(logs[0].last[ENGINE_ERROR].err, EHANDSUBSET);
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[0], GOLD), 2);
+
+  /* Assert the rejected offer is handed back to the seat */
+  ck_assert_uint_eq(logs[0].counts[ENGINE_CANCELLED_OFFER], 1);
+  ck_assert_uint_eq(get_card_amount(&logs[0].last[ENGINE_CANCELLED_OFFER].cards,
+                                    GOLD), 3);
+
+  /* Assert another seat's offer cannot be cancelled */
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, GOLD, 2);
+
+  ck_assert(engine_submit(engine_obj, 0, &action));
+
+  engine_action cancel = {.type = ENGINE_CANCEL_OFFER, .card_amt = 2};
+
+  ck_assert(!engine_submit(engine_obj, 1, &cancel));
+  ck_assert_int_eq(logs[1].last[ENGINE_ERROR].err, ECANPERM);
+  ck_assert_int_eq(engine_obj->last_err, ECANPERM);
+
+  /* Assert the owner gets its cards back */
+  ck_assert(engine_submit(engine_obj, 0, &cancel));
+  ck_assert_int_eq(engine_obj->last_err, CMD_SUCCESS);
+  ck_assert_uint_eq(logs[0].counts[ENGINE_CANCELLED_OFFER], 2);
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[0], GOLD), 2);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_end_round)
+{
+  engine* engine_obj = logged_engine_new(2);
+  engine_action action = {.type = ENGINE_NEW_OFFER};
+
+  engine_start_game(engine_obj);
+
+  /* Seat 0 is two diamonds short of a winning hand */
+  clear_card_location(&engine_obj->hands[0]);
+  clear_card_location(&engine_obj->hands[1]);
+  add_cards_to_location(&engine_obj->hands[0], DIAMONDS,
+                        TOTAL_COMMODITY_AMOUNT - 1);
+  add_cards_to_location(&engine_obj->hands[0], SPORT, 2);
+  add_cards_to_location(&engine_obj->hands[1], DIAMONDS, 2);
+
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, SPORT, 2);
+  engine_submit(engine_obj, 0, &action);
+
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, DIAMONDS, 2);
+  engine_submit(engine_obj, 1, &action);
+
+  /* Assert the round was won, scored and a new one dealt */
+  for (size_t seat = 0; seat < 2; ++seat) {
+    ck_assert_uint_eq(logs[seat].counts[ENGINE_BILLIONAIRE], 1);
+    ck_assert_uint_eq(logs[seat].last[ENGINE_BILLIONAIRE].seat, 0);
+    ck_assert_uint_eq(logs[seat].counts[ENGINE_END_ROUND], 1);
+    ck_assert_uint_eq(logs[seat].counts[ENGINE_START], 2);
+  }
+
+  ck_assert_int_eq(get_engine_score(engine_obj, 0),
+                   card_values[DIAMONDS]);
+  ck_assert_int_eq(logs[0].last[ENGINE_START].score, card_values[DIAMONDS]);
+  ck_assert_uint_eq(engine_obj->num_rounds, 1);
+  ck_assert(engine_obj->running);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_stalled_round)
+{
+  engine* engine_obj = logged_engine_new(3);
+
+  engine_start_game(engine_obj);
+
+  /* Assert a round nobody plays in ends once every seat has passed */
+  for (size_t i = 0; i < 3; ++i) {
+    ck_assert_uint_eq(logs[0].counts[ENGINE_END_ROUND], 0);
+    engine_step(engine_obj);
+  }
+
+  ck_assert_uint_eq(logs[0].counts[ENGINE_END_ROUND], 1);
+  ck_assert_uint_eq(logs[0].counts[ENGINE_BILLIONAIRE], 0);
+  ck_assert_uint_eq(logs[0].counts[ENGINE_START], 2);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_take_turn)
+{
+  engine* engine_obj = logged_engine_new(2);
+  engine_action action = {.type = ENGINE_NEW_OFFER};
+  engine_action pass = {.type = ENGINE_PASS};
+
+  engine_start_game(engine_obj);
+
+  clear_card_location(&engine_obj->hands[0]);
+  clear_card_location(&engine_obj->hands[1]);
+  add_cards_to_location(&engine_obj->hands[0], GOLD, 2);
+  add_cards_to_location(&engine_obj->hands[1], OIL, 2);
+
+  /* Assert turns pass between seats without asking their agents */
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, GOLD, 2);
+
+  ck_assert(engine_take_turn(engine_obj, &action));
+  ck_assert_uint_eq(engine_obj->next_seat, 1);
+
+  clear_card_location(&action.cards);
+  add_cards_to_location(&action.cards, OIL, 2);
+
+  ck_assert(engine_take_turn(engine_obj, &action));
+  ck_assert_uint_eq(engine_obj->next_seat, 0);
+  ck_assert_uint_eq(engine_obj->num_trades, 1);
+  ck_assert_uint_eq(get_card_amount(&engine_obj->hands[0], OIL), 2);
+
+  /* Assert passes still end the round */
+  engine_take_turn(engine_obj, &pass);
+  engine_take_turn(engine_obj, &pass);
+
+  ck_assert_uint_eq(logs[0].counts[ENGINE_END_ROUND], 1);
+
+  /* Assert nothing happens once the game is over */
+  engine_stop_game(engine_obj);
+
+  ck_assert(!engine_take_turn(engine_obj, &pass));
+  ck_assert_uint_eq(engine_obj->num_turns, 4);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+
+/* Whole game tests */
+
+START_TEST(test_engine_play_game)
+{
+  engine* engine_obj = logged_engine_new(4);
+  rng agent_rng;
+  engine_agent agent = {collect_most, log_event, &agent_rng};
+
+  rng_init(&agent_rng, 1, 1);
+
+  for (size_t seat = 0; seat < 4; ++seat) {
+    set_engine_agent(engine_obj, seat, &agent);
+  }
+
+  /* Assert the engine can be played again once a game is over */
+  for (size_t game = 0; game < 3; ++game) {
+    ck_assert(engine_play_game(engine_obj, MAX_GAME_TURNS));
+    ck_assert(!engine_obj->running);
+
+    int best_score = get_engine_score(engine_obj, 0);
+
+    for (size_t seat = 1; seat < 4; ++seat) {
+      if (get_engine_score(engine_obj, seat) > best_score) {
+        best_score = get_engine_score(engine_obj, seat);
+      }
+    }
+
+    ck_assert_int_ge(best_score, WINNING_SCORE);
+  }
+
+  ck_assert_uint_eq(logs[0].counts[ENGINE_END_GAME], 3);
+  ck_assert_uint_gt(engine_obj->num_trades, 0);
+
+  free_engine(engine_obj);
+}
+END_TEST
+
+START_TEST(test_engine_reproducible)
+{
+  rng agent_rngs[2];
+  engine* engines[2];
+
+  for (size_t i = 0; i < 2; ++i) {
+    engine_agent agent = {collect_most, NULL, &agent_rngs[i]};
+
+    rng_init(&agent_rngs[i], 99, 8);
+    engines[i] = engine_new(3, true, true, 99, 7);
+
+    for (size_t seat = 0; seat < 3; ++seat) {
+      set_engine_agent(engines[i], seat, &agent);
+    }
+
+    engine_play_game(engines[i], MAX_GAME_TURNS);
+  }
+
+  /* Assert the same seed and stream play out the same game */
+  ck_assert_uint_eq(engines[0]->num_turns, engines[1]->num_turns);
+  ck_assert_uint_eq(engines[0]->num_trades, engines[1]->num_trades);
+
+  for (size_t seat = 0; seat < 3; ++seat) {
+    ck_assert_int_eq(get_engine_score(engines[0], seat),
+                     get_engine_score(engines[1], seat));
+  }
+
+  /* Assert a reseeded engine replays the game of a new one */
+  rng_init(&agent_rngs[0], 99, 8);
+  seed_engine(engines[0], 99, 7);
+  engine_play_game(engines[0], MAX_GAME_TURNS);
+
+  for (size_t seat = 0; seat < 3; ++seat) {
+    ck_assert_int_eq(get_engine_score(engines[0], seat),
+                     get_engine_score(engines[1], seat));
+  }
+
+  ck_assert_uint_eq(engines[0]->num_turns, 2*engines[1]->num_turns);
+
+  /* Assert cards are conserved part way through a game */
+  engine_start_game(engines[0]);
+
+  for (size_t i = 0; i < 50; ++i) {
+    engine_step(engines[0]);
+    assert_cards_kept(engines[0]);
+  }
+
+  free_engine(engines[0]);
+  free_engine(engines[1]);
+}
+END_TEST
+
+
+Suite*
+engine_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_game;
+
+  s = suite_create("Engine");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_engine_start);
+  tcase_add_test(tc_core, test_engine_trade);
+  tcase_add_test(tc_core, test_engine_errors);
+  tcase_add_test(tc_core, test_engine_end_round);
+  tcase_add_test(tc_core, test_engine_stalled_round);
+  tcase_add_test(tc_core, test_engine_take_turn);
+
+  tc_game = tcase_create("Game");
+
+  tcase_add_test(tc_game, test_engine_play_game);
+  tcase_add_test(tc_game, test_engine_reproducible);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_game);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = engine_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
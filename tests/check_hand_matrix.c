@@ -0,0 +1,181 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "card_location.h"
+#include "hand_matrix.h"
+#include "hand_reference.h"
+
+/* Random tables compared against card_location per test */
+#define NUM_RANDOM_TABLES 200
+
+/* Seat counts to try, around each kernel's vector width */
+static const size_t seat_counts[] = {1, 8, 15, 16, 17, 31, 32, 33, 100};
+
+static const hand_kernel kernels[] = {
+  HAND_KERNEL_AUTO,
+  HAND_KERNEL_SCALAR,
+  HAND_KERNEL_SSE2,
+  HAND_KERNEL_AVX2
+};
+
+
+/* Core tests */
+
+START_TEST(test_hand_matrix_seats)
+{
+  hand_matrix* matrix = hand_matrix_new(3);
+  card_location hand;
+
+  clear_card_location(&hand);
+  add_cards_to_location(&hand, OIL, 4);
+  add_card_to_location(&hand, BILLIONAIRE);
+
+  set_hand_matrix_seat(matrix, 1, &hand);
+
+  /* Assert a seat's column holds its hand and nothing else does */
+  ck_assert_uint_eq(get_hand_matrix_count(matrix, 1, OIL), 4);
+  ck_assert_uint_eq(get_hand_matrix_count(matrix, 1, BILLIONAIRE), 1);
+  ck_assert_uint_eq(get_hand_matrix_count(matrix, 0, OIL), 0);
+  ck_assert_uint_eq(get_hand_matrix_count(matrix, 2, OIL), 0);
+
+  /* Assert rows are padded to a whole vector */
+  ck_assert_uint_eq(matrix->stride % HAND_MATRIX_ALIGN, 0);
+
+  clear_hand_matrix(matrix);
+
+  ck_assert_uint_eq(get_hand_matrix_count(matrix, 1, OIL), 0);
+
+  free_hand_matrix(matrix);
+}
+END_TEST
+
+
+/* Kernel tests */
+
+START_TEST(test_hand_matrix_kernel)
+{
+  hand_kernel kernel = kernels[_i];
+  uint8_t counts[TOTAL_UNIQUE_CARDS];
+  card_location hands[100];
+  bool won[100];
+  int scores[100];
+  size_t num_won = 0;
+
+  if (!hand_kernel_supported(kernel)) {
+    return;
+  }
+
+  srand(5);
+
+  for (size_t t = 0; t < NUM_RANDOM_TABLES; ++t) {
+    size_t num_seats = seat_counts[t % (sizeof(seat_counts)/sizeof(size_t))];
+    hand_matrix* matrix = hand_matrix_new(num_seats);
+
+    for (size_t seat = 0; seat < num_seats; ++seat) {
+      ref_random_hand(counts, &hands[seat], CARD_MAX_AMOUNT);
+      set_hand_matrix_seat(matrix, seat, &hands[seat]);
+    }
+
+    evaluate_hand_matrix_with(matrix, kernel, won, scores);
+
+    /* Assert every seat agrees with its card_location */
+    for (size_t seat = 0; seat < num_seats; ++seat) {
+      ck_assert_int_eq(won[seat], has_won(&hands[seat]));
+      ck_assert_int_eq(scores[seat], evaluate_hand_score(&hands[seat]));
+
+      num_won += won[seat];
+    }
+
+    /* Assert either output can be left out */
+    evaluate_hand_matrix_with(matrix, kernel, NULL, scores);
+    evaluate_hand_matrix_with(matrix, kernel, won, NULL);
+
+    ck_assert_int_eq(won[num_seats - 1], has_won(&hands[num_seats - 1]));
+
+    free_hand_matrix(matrix);
+  }
+
+  /* Assert winning hands were actually covered */
+  ck_assert_uint_gt(num_won, 0);
+}
+END_TEST
+
+START_TEST(test_hand_matrix_extremes)
+{
+  hand_kernel kernel = kernels[_i];
+  hand_matrix* matrix = hand_matrix_new(HAND_MATRIX_ALIGN);
+  card_location hands[HAND_MATRIX_ALIGN];
+  bool won[HAND_MATRIX_ALIGN];
+  int scores[HAND_MATRIX_ALIGN];
+
+  if (!hand_kernel_supported(kernel)) {
+    free_hand_matrix(matrix);
+    return;
+  }
+
+  /* Every commodity can win at once, giving the largest scores */
+  for (size_t seat = 0; seat < HAND_MATRIX_ALIGN; ++seat) {
+    clear_card_location(&hands[seat]);
+
+    for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+      add_cards_to_location(&hands[seat], card,
+                            (seat & (1u << (card % 5))) ? PACKED_CARD_MAX : 0);
+    }
+
+    set_hand_matrix_seat(matrix, seat, &hands[seat]);
+  }
+
+  evaluate_hand_matrix_with(matrix, kernel, won, scores);
+
+  for (size_t seat = 0; seat < HAND_MATRIX_ALIGN; ++seat) {
+    ck_assert_int_eq(won[seat], has_won(&hands[seat]));
+    ck_assert_int_eq(scores[seat], evaluate_hand_score(&hands[seat]));
+  }
+
+  free_hand_matrix(matrix);
+}
+END_TEST
+
+
+Suite*
+hand_matrix_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_kernel;
+
+  s = suite_create("Hand Matrix");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_hand_matrix_seats);
+
+  tc_kernel = tcase_create("Kernels");
+
+  tcase_add_loop_test(tc_kernel, test_hand_matrix_kernel, 0, 4);
+  tcase_add_loop_test(tc_kernel, test_hand_matrix_extremes, 0, 4);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_kernel);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = hand_matrix_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,208 @@
+#include <check.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "card_location.h"
+#include "command_error.h"
+#include "hand_reference.h"
+#include "packed_hand.h"
+
+/* Random hands compared against the scalar implementations per test */
+#define NUM_RANDOM_HANDS 100000
+
+/* Largest commodity count of hands that are merged, so sums still fit */
+#define MERGE_MAX_COMM (PACKED_CARD_MAX/2)
+
+
+/* Core tests */
+
+START_TEST(test_packed_hand_counts)
+{
+  card_location card_loc;
+  clear_card_location(&card_loc);
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    add_cards_to_location(&card_loc, card, (size_t) card + 1);
+  }
+
+  /* Assert every count sits in its own bits */
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    ck_assert_uint_eq(packed_get(card_loc.card_counts, card), card + 1);
+    ck_assert_uint_eq(get_card_amount(&card_loc, card), card + 1);
+  }
+
+  /* Assert the horizontal sum matches the running total */
+  ck_assert_uint_eq(packed_total(card_loc.card_counts),
+                    get_total_cards(&card_loc));
+  ck_assert_int_eq(packed_count_commodities(card_loc.card_counts),
+                   TOTAL_COMMODITY_AMOUNT);
+  ck_assert_int_eq(packed_count_wildcards(card_loc.card_counts), 2);
+}
+END_TEST
+
+START_TEST(test_packed_hand_borrow)
+{
+  /* The borrow out of a lower count must not hide a higher one */
+  packed_hand hand = packed_card(GOLD, 3) | packed_card(SPORT, 1);
+  packed_hand cards = packed_card(DIAMONDS, 1) | packed_card(SPORT, 2);
+
+  ck_assert(!packed_is_subset(cards, hand));
+  ck_assert(!packed_subtract(&hand, cards));
+
+  /* Assert a failed subtraction leaves the hand unchanged */
+  ck_assert_uint_eq(packed_get(hand, GOLD), 3);
+  ck_assert_uint_eq(packed_get(hand, SPORT), 1);
+
+  /* Counts of PACKED_CARD_MAX must not be mistaken for borrows */
+  hand = packed_card(TAX_COLLECTOR, PACKED_CARD_MAX);
+  cards = packed_card(TAX_COLLECTOR, PACKED_CARD_MAX);
+
+  ck_assert(packed_subtract(&hand, cards));
+  ck_assert_uint_eq(hand, 0);
+}
+END_TEST
+
+
+/* Equivalence tests */
+
+START_TEST(test_packed_hand_merge)
+{
+  uint8_t dest_counts[TOTAL_UNIQUE_CARDS], src_counts[TOTAL_UNIQUE_CARDS];
+  card_location dest_loc, src_loc;
+
+  srand(1);
+
+  for (size_t i = 0; i < NUM_RANDOM_HANDS; ++i) {
+    ref_random_hand(dest_counts, &dest_loc, MERGE_MAX_COMM);
+    ref_random_hand(src_counts, &src_loc, MERGE_MAX_COMM);
+
+    ref_merge(dest_counts, src_counts);
+    merge_card_location(&dest_loc, &src_loc);
+
+    for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+      ck_assert_uint_eq(get_card_amount(&dest_loc, card), dest_counts[card]);
+    }
+
+    ck_assert_uint_eq(get_total_cards(&dest_loc), ref_total(dest_counts));
+  }
+}
+END_TEST
+
+START_TEST(test_packed_hand_subtract)
+{
+  uint8_t dest_counts[TOTAL_UNIQUE_CARDS], src_counts[TOTAL_UNIQUE_CARDS];
+  card_location dest_loc, src_loc;
+
+  srand(2);
+
+  for (size_t i = 0; i < NUM_RANDOM_HANDS; ++i) {
+    cmd_result res = CMD_RESULT_INIT;
+
+    ref_random_hand(dest_counts, &dest_loc, CARD_MAX_AMOUNT);
+    ref_random_hand(src_counts, &src_loc, CARD_MAX_AMOUNT);
+
+    bool ref_ok = ref_subtract(dest_counts, src_counts);
+    subtract_card_location(&dest_loc, &src_loc, &res);
+
+    ck_assert_int_eq(cmd_failed(&res), !ref_ok);
+
+    for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+      ck_assert_uint_eq(get_card_amount(&dest_loc, card), dest_counts[card]);
+    }
+
+    ck_assert_uint_eq(get_total_cards(&dest_loc), ref_total(dest_counts));
+  }
+}
+END_TEST
+
+START_TEST(test_packed_hand_validate_offer)
+{
+  uint8_t offer_counts[TOTAL_UNIQUE_CARDS], hand_counts[TOTAL_UNIQUE_CARDS];
+  card_location offer_loc, hand_loc;
+
+  srand(3);
+
+  for (size_t i = 0; i < NUM_RANDOM_HANDS; ++i) {
+    cmd_result res = CMD_RESULT_INIT;
+
+    ref_random_hand(offer_counts, &offer_loc, OFFER_MAX_CARDS/2);
+    ref_random_hand(hand_counts, &hand_loc, CARD_MAX_AMOUNT);
+
+    validate_offer(&offer_loc, &hand_loc, &res);
+
+    /* Assert the same error is found first */
+    ck_assert_int_eq(res.err, ref_validate_offer(offer_counts, hand_counts));
+  }
+}
+END_TEST
+
+START_TEST(test_packed_hand_has_won)
+{
+  uint8_t hand_counts[TOTAL_UNIQUE_CARDS];
+  card_location hand_loc;
+  size_t num_won = 0;
+
+  srand(4);
+
+  for (size_t i = 0; i < NUM_RANDOM_HANDS; ++i) {
+    ref_random_hand(hand_counts, &hand_loc, CARD_MAX_AMOUNT);
+
+    bool ref_won = ref_has_won(hand_counts);
+
+    ck_assert_int_eq(has_won(&hand_loc), ref_won);
+    ck_assert_int_eq(evaluate_hand_score(&hand_loc),
+                     ref_evaluate_hand_score(hand_counts));
+
+    num_won += ref_won;
+  }
+
+  /* Assert winning hands were actually covered */
+  ck_assert_uint_gt(num_won, 0);
+}
+END_TEST
+
+
+Suite*
+packed_hand_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_equiv;
+
+  s = suite_create("Packed Hand");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_packed_hand_counts);
+  tcase_add_test(tc_core, test_packed_hand_borrow);
+
+  tc_equiv = tcase_create("Equivalence");
+
+  tcase_add_test(tc_equiv, test_packed_hand_merge);
+  tcase_add_test(tc_equiv, test_packed_hand_subtract);
+  tcase_add_test(tc_equiv, test_packed_hand_validate_offer);
+  tcase_add_test(tc_equiv, test_packed_hand_has_won);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_equiv);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = packed_hand_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
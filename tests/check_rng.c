@@ -0,0 +1,159 @@
+#include <check.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "rng.h"
+
+/* Samples drawn by the distribution tests */
+#define NUM_SAMPLES 600000
+
+
+/* Core tests */
+
+START_TEST(test_rng_reference)
+{
+  rng rng_obj = {{1, 2, 3, 4}};
+
+  /* Assert the output matches the xoshiro256** reference */
+  ck_assert_uint_eq(rng_next(&rng_obj), UINT64_C(11520));
+  ck_assert_uint_eq(rng_next(&rng_obj), UINT64_C(0));
+  ck_assert_uint_eq(rng_next(&rng_obj), UINT64_C(1509978240));
+}
+END_TEST
+
+START_TEST(test_rng_reproducible)
+{
+  rng first_rng;
+  rng second_rng;
+
+  rng_init(&first_rng, 1234, 5);
+  rng_init(&second_rng, 1234, 5);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    ck_assert_uint_eq(rng_next(&first_rng), rng_next(&second_rng));
+  }
+}
+END_TEST
+
+START_TEST(test_rng_streams)
+{
+  uint64_t firsts[128];
+
+  /* Neighbouring streams of a seed, and the same streams of the next
+     seed */
+  for (size_t i = 0; i < 128; ++i) {
+    rng rng_obj;
+
+    rng_init(&rng_obj, 1234 + i/64, i % 64);
+    firsts[i] = rng_next(&rng_obj);
+  }
+
+  /* Assert every stream starts somewhere different */
+  for (size_t i = 0; i < 128; ++i) {
+    for (size_t j = i + 1; j < 128; ++j) {
+      ck_assert_uint_ne(firsts[i], firsts[j]);
+    }
+  }
+}
+END_TEST
+
+
+/* Bounded sampling tests */
+
+START_TEST(test_rng_bounded_range)
+{
+  static const uint32_t bounds[] = {1, 2, 3, 7, 52, 1000, UINT32_MAX};
+  rng rng_obj;
+
+  rng_init(&rng_obj, 42, 0);
+
+  for (size_t b = 0; b < sizeof(bounds)/sizeof(uint32_t); ++b) {
+    for (size_t i = 0; i < 10000; ++i) {
+      ck_assert_uint_lt(rng_bounded(&rng_obj, bounds[b]), bounds[b]);
+    }
+  }
+}
+END_TEST
+
+START_TEST(test_rng_bounded_uniform)
+{
+  size_t counts[6] = {0};
+  rng rng_obj;
+
+  rng_init(&rng_obj, 42, 1);
+
+  for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+    counts[rng_bounded(&rng_obj, 6)]++;
+  }
+
+  /* Assert each value is within 2% of its expected count */
+  for (size_t i = 0; i < 6; ++i) {
+    ck_assert_uint_gt(counts[i], NUM_SAMPLES/6*98/100);
+    ck_assert_uint_lt(counts[i], NUM_SAMPLES/6*102/100);
+  }
+}
+END_TEST
+
+START_TEST(test_rng_bounded_unbiased)
+{
+  const uint32_t bound = UINT32_C(3) << 30;
+  size_t num_low = 0;
+  rng rng_obj;
+
+  rng_init(&rng_obj, 42, 2);
+
+  /* Reducing 32 random bits modulo this bound would land in its first
+     third half of the time, rather than a third of the time */
+  for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+    num_low += (rng_bounded(&rng_obj, bound) < (UINT32_C(1) << 30));
+  }
+
+  ck_assert_uint_gt(num_low, NUM_SAMPLES/3*98/100);
+  ck_assert_uint_lt(num_low, NUM_SAMPLES/3*102/100);
+}
+END_TEST
+
+
+Suite*
+rng_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+  TCase* tc_bounded;
+
+  s = suite_create("RNG");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_rng_reference);
+  tcase_add_test(tc_core, test_rng_reproducible);
+  tcase_add_test(tc_core, test_rng_streams);
+
+  tc_bounded = tcase_create("Bounded");
+
+  tcase_add_test(tc_bounded, test_rng_bounded_range);
+  tcase_add_test(tc_bounded, test_rng_bounded_uniform);
+  tcase_add_test(tc_bounded, test_rng_bounded_unbiased);
+
+  suite_add_tcase(s, tc_core);
+  suite_add_tcase(s, tc_bounded);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = rng_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,197 @@
+#include <check.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+
+/* Objects in each chunk of the test slabs */
+#define TEST_CHUNK_OBJS 4
+
+
+/* Core tests */
+
+START_TEST(test_slab_new)
+{
+  slab* slab_obj = slab_new(1, TEST_CHUNK_OBJS);
+  const slab_stats* stats = get_slab_stats(slab_obj);
+
+  /* Assert objects can always hold the free list link */
+  ck_assert_uint_ge(slab_obj->obj_size, sizeof(void*));
+  ck_assert_uint_eq(slab_obj->obj_size % _Alignof(max_align_t), 0);
+
+  /* Assert no memory is requested until it is needed */
+  ck_assert_uint_eq(stats->num_chunks, 0);
+  ck_assert_uint_eq(stats->num_allocs, 0);
+
+  free_slab(slab_obj);
+}
+END_TEST
+
+START_TEST(test_slab_alloc)
+{
+  slab* slab_obj = slab_new(24, TEST_CHUNK_OBJS);
+  const slab_stats* stats = get_slab_stats(slab_obj);
+  char* objs[3*TEST_CHUNK_OBJS];
+
+  for (size_t i = 0; i < 3*TEST_CHUNK_OBJS; ++i) {
+    objs[i] = slab_alloc(slab_obj);
+
+    /* Assert every object is aligned and usable */
+    ck_assert_uint_eq((uintptr_t) objs[i] % _Alignof(max_align_t), 0);
+    memset(objs[i], (int) i, 24);
+  }
+
+  /* Assert no object overlaps another */
+  for (size_t i = 0; i < 3*TEST_CHUNK_OBJS; ++i) {
+    for (size_t j = 0; j < 24; ++j) {
+      ck_assert_int_eq(objs[i][j], (char) i);
+    }
+  }
+
+  ck_assert_uint_eq(stats->num_chunks, 3);
+  ck_assert_uint_eq(stats->num_allocs, 3*TEST_CHUNK_OBJS);
+  ck_assert_uint_eq(stats->num_live, 3*TEST_CHUNK_OBJS);
+
+  free_slab(slab_obj);
+}
+END_TEST
+
+START_TEST(test_slab_free)
+{
+  slab* slab_obj = slab_new(sizeof(double), TEST_CHUNK_OBJS);
+  const slab_stats* stats = get_slab_stats(slab_obj);
+  void* first_obj;
+  void* second_obj;
+
+  first_obj = slab_alloc(slab_obj);
+  second_obj = slab_alloc(slab_obj);
+
+  slab_free(slab_obj, first_obj);
+  slab_free(slab_obj, NULL);
+
+  ck_assert_uint_eq(stats->num_frees, 1);
+  ck_assert_uint_eq(stats->num_live, 1);
+  ck_assert_uint_eq(stats->peak_live, 2);
+
+  /* Assert the freed object is handed out again first */
+  ck_assert_ptr_eq(slab_alloc(slab_obj), first_obj);
+  ck_assert_ptr_ne(slab_alloc(slab_obj), second_obj);
+
+  ck_assert_uint_eq(stats->num_chunks, 1);
+  ck_assert_uint_eq(stats->peak_live, 3);
+
+  free_slab(slab_obj);
+}
+END_TEST
+
+START_TEST(test_slab_reserve)
+{
+  slab* slab_obj = slab_new(sizeof(double), TEST_CHUNK_OBJS);
+  const slab_stats* stats = get_slab_stats(slab_obj);
+
+  slab_reserve(slab_obj, TEST_CHUNK_OBJS + 1);
+
+  ck_assert_uint_eq(stats->num_chunks, 2);
+  ck_assert_uint_eq(stats->num_allocs, 0);
+
+  /* Assert reserving less than is already held does nothing */
+  slab_reserve(slab_obj, TEST_CHUNK_OBJS);
+
+  ck_assert_uint_eq(stats->num_chunks, 2);
+
+  /* Assert the reserved chunks are used before any more are requested */
+  for (size_t i = 0; i < 2*TEST_CHUNK_OBJS; ++i) {
+    slab_alloc(slab_obj);
+  }
+
+  ck_assert_uint_eq(stats->num_chunks, 2);
+
+  /* Assert reserving while in use only adds the difference */
+  slab_reserve(slab_obj, 3*TEST_CHUNK_OBJS);
+
+  ck_assert_uint_eq(stats->num_chunks, 3);
+
+  slab_alloc(slab_obj);
+
+  ck_assert_uint_eq(stats->num_chunks, 3);
+
+  free_slab(slab_obj);
+}
+END_TEST
+
+START_TEST(test_slab_reset)
+{
+  slab* slab_obj = slab_new(sizeof(double), TEST_CHUNK_OBJS);
+  const slab_stats* stats = get_slab_stats(slab_obj);
+  void* first_obj;
+
+  first_obj = slab_alloc(slab_obj);
+
+  for (size_t i = 1; i < 2*TEST_CHUNK_OBJS; ++i) {
+    slab_alloc(slab_obj);
+  }
+
+  slab_free(slab_obj, first_obj);
+  slab_reset(slab_obj);
+
+  ck_assert_uint_eq(stats->num_live, 0);
+  ck_assert_uint_eq(stats->num_frees, 2*TEST_CHUNK_OBJS);
+  ck_assert_uint_eq(stats->num_resets, 1);
+
+  /* Assert objects are carved from the existing chunks again */
+  ck_assert_ptr_eq(slab_alloc(slab_obj), first_obj);
+
+  for (size_t i = 1; i < 2*TEST_CHUNK_OBJS; ++i) {
+    slab_alloc(slab_obj);
+  }
+
+  ck_assert_uint_eq(stats->num_chunks, 2);
+
+  slab_alloc(slab_obj);
+
+  ck_assert_uint_eq(stats->num_chunks, 3);
+
+  free_slab(slab_obj);
+}
+END_TEST
+
+
+Suite*
+slab_suite(void)
+{
+  Suite* s;
+  TCase* tc_core;
+
+  s = suite_create("Slab");
+
+  tc_core = tcase_create("Core");
+
+  tcase_add_test(tc_core, test_slab_new);
+  tcase_add_test(tc_core, test_slab_alloc);
+  tcase_add_test(tc_core, test_slab_free);
+  tcase_add_test(tc_core, test_slab_reserve);
+  tcase_add_test(tc_core, test_slab_reset);
+
+  suite_add_tcase(s, tc_core);
+
+  return s;
+}
+
+int
+main()
+{
+  int num_failed;
+  Suite* s;
+  SRunner* sr;
+
+  s = slab_suite();
+  sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  num_failed = srunner_ntests_failed(sr);
+  srunner_free(sr);
+
+  return (num_failed == 0) ? 0 : EXIT_FAILURE;
+}
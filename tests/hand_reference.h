@@ -0,0 +1,151 @@
+#ifndef _HAND_REFERENCE_H_
+#define _HAND_REFERENCE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "card_location.h"
+#include "command_error.h"
+
+/**
+ * Scalar hand operations, one card type at a time, on plain count
+ * arrays. These are the original card_location implementations, kept
+ * to check and measure the packed versions against.
+ */
+
+static inline void
+ref_merge(uint8_t* dest, const uint8_t* src)
+{
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    dest[card] += src[card];
+  }
+}
+
+static inline bool
+ref_subtract(uint8_t* dest, const uint8_t* src)
+{
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    if (src[card] > dest[card]) {
+      return false;
+    }
+  }
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    dest[card] -= src[card];
+  }
+
+  return true;
+}
+
+static inline size_t
+ref_total(const uint8_t* counts)
+{
+  size_t total = 0;
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    total += counts[card];
+  }
+
+  return total;
+}
+
+static inline int
+ref_validate_offer(const uint8_t* offer, const uint8_t* hand)
+{
+  size_t total_offer_size = ref_total(offer);
+
+  if (total_offer_size == 0) {
+    return ENOOFFER;
+  }
+  else if (total_offer_size < OFFER_MIN_CARDS) {
+    return ESMALLOFFER;
+  }
+  else if (total_offer_size > OFFER_MAX_CARDS) {
+    return ELARGEOFFER;
+  }
+
+  size_t num_commodities = 0, num_wildcards = 0;
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    size_t card_amt = offer[card];
+
+    if (card_amt > 0) {
+      if (hand[card] < card_amt) {
+        return EHANDSUBSET;
+      }
+
+      if (card < TOTAL_COMMODITY_AMOUNT) {
+        if (++num_commodities > OFFER_MAX_UNIQ_COMMS) {
+          return EUNIQCOMMS;
+        }
+      }
+      else {
+        if (++num_wildcards > OFFER_MAX_UNIQ_WILDS) {
+          return EUNIQWILDS;
+        }
+      }
+    }
+  }
+
+  return CMD_SUCCESS;
+}
+
+static inline bool
+ref_has_won(const uint8_t* hand)
+{
+  size_t num_wildcards = hand[BILLIONAIRE] + hand[TAX_COLLECTOR];
+
+  for (card_id comm_card = DIAMONDS; comm_card < TOTAL_COMMODITY_AMOUNT; ++comm_card) {
+    if ((hand[comm_card] + num_wildcards) >= (TOTAL_COMMODITY_AMOUNT + 1)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static inline int
+ref_evaluate_hand_score(const uint8_t* hand)
+{
+  int score = 0;
+  size_t num_wildcards = hand[BILLIONAIRE] + hand[TAX_COLLECTOR];
+
+  if (hand[TAX_COLLECTOR] > 0) {
+    score += card_values[TAX_COLLECTOR];
+  }
+
+  for (card_id comm_card = DIAMONDS; comm_card < TOTAL_COMMODITY_AMOUNT; ++comm_card) {
+    if ((hand[comm_card] + num_wildcards) >= (TOTAL_COMMODITY_AMOUNT + 1)) {
+      score += card_values[comm_card];
+    }
+  }
+
+  if (hand[BILLIONAIRE] > 0) {
+    score *= 2;
+  }
+
+  return score;
+}
+
+/**
+ * Fill a count array and a card_location with the same random hand.
+ *
+ * Commodity counts are at most max_comm, and wildcard counts at most one.
+ */
+static inline void
+ref_random_hand(uint8_t* counts, card_location* card_loc, int max_comm)
+{
+  clear_card_location(card_loc);
+
+  for (card_id card = DIAMONDS; card < TOTAL_UNIQUE_CARDS; ++card) {
+    int max_amt = (card < TOTAL_COMMODITY_AMOUNT) ? max_comm : 1;
+
+    /* Leave most card types out, as in a real hand or offer */
+    counts[card] = (rand() % 3 == 0) ? (uint8_t) (rand() % (max_amt + 1)) : 0;
+
+    add_cards_to_location(card_loc, card, counts[card]);
+  }
+}
+
+#endif
@@ -75,8 +75,9 @@ mem_check_command_parse()
 {
   char* json_str = "{\"commands\":[{\"command\":\"FINISH\"}]}";
   size_t str_len = 36;
+  cmd_result res = CMD_RESULT_INIT;
 
-  json_object* cmd_array = parse_command_list_string(json_str, str_len);
+  json_object* cmd_array = parse_command_list_string(json_str, str_len, &res);
 
   JSON_ARRAY_FOREACH(cmd, cmd_array) {
     assert(command_is(cmd, Command.FINISH));